@@ -0,0 +1,74 @@
+argparser.o: modules/argparser.c modules/argparser.h \
+ modules/locale_macros.h modules/rtprofile.h modules/ledmap.h \
+ modules/rgbmodes.h modules/governor.h modules/dimmer.h modules/modereg.h
+devio.o: modules/devio.c modules/locale_macros.h modules/devio.h \
+ modules/rgbmodes.h modules/argparser.h modules/rtprofile.h \
+ modules/ledmap.h modules/governor.h modules/capture.h modules/dimmer.h \
+ modules/mutewatch.h modules/scene.h modules/usbfind.h modules/service.h \
+ modules/frameclock.h modules/framestream.h modules/reporter.h
+rgbmodes.o: modules/rgbmodes.c modules/devio.h modules/rgbmodes.h \
+ modules/argparser.h modules/locale_macros.h modules/rtprofile.h \
+ modules/ledmap.h modules/governor.h modules/capture.h modules/dimmer.h \
+ modules/mutewatch.h modules/timeline.h modules/colorpipe.h \
+ modules/prng.h modules/effects.h modules/workpool.h modules/modereg.h
+scene.o: modules/scene.c modules/locale_macros.h modules/scene.h \
+ modules/devio.h modules/rgbmodes.h modules/argparser.h \
+ modules/rtprofile.h modules/ledmap.h modules/governor.h \
+ modules/capture.h modules/dimmer.h modules/mutewatch.h
+timeline.o: modules/timeline.c modules/colorpipe.h modules/prng.h \
+ modules/timeline.h
+colorpipe.o: modules/colorpipe.c modules/colorpipe.h
+ledmap.o: modules/ledmap.c modules/devio.h modules/rgbmodes.h \
+ modules/argparser.h modules/locale_macros.h modules/rtprofile.h \
+ modules/ledmap.h modules/governor.h modules/capture.h modules/dimmer.h \
+ modules/mutewatch.h modules/colorpipe.h
+usbfind.o: modules/usbfind.c modules/devio.h modules/rgbmodes.h \
+ modules/argparser.h modules/locale_macros.h modules/rtprofile.h \
+ modules/ledmap.h modules/governor.h modules/capture.h modules/dimmer.h \
+ modules/mutewatch.h modules/usbfind.h
+service.o: modules/service.c modules/dimmer.h modules/rgbmodes.h \
+ modules/argparser.h modules/locale_macros.h modules/rtprofile.h \
+ modules/service.h
+workpool.o: modules/workpool.c modules/workpool.h
+prng.o: modules/prng.c modules/prng.h
+effects.o: modules/effects.c modules/prng.h modules/rgbmodes.h \
+ modules/argparser.h modules/locale_macros.h modules/rtprofile.h \
+ modules/modereg.h modules/effects.h
+frameclock.o: modules/frameclock.c modules/locale_macros.h \
+ modules/frameclock.h modules/reporter.h
+framestream.o: modules/framestream.c modules/locale_macros.h \
+ modules/service.h modules/frameclock.h modules/ledmap.h \
+ modules/rgbmodes.h modules/argparser.h modules/rtprofile.h \
+ modules/framestream.h modules/devio.h modules/governor.h \
+ modules/capture.h modules/dimmer.h modules/mutewatch.h \
+ modules/reporter.h
+batch.o: modules/batch.c modules/locale_macros.h modules/argparser.h \
+ modules/rtprofile.h modules/rgbmodes.h modules/devio.h modules/ledmap.h \
+ modules/governor.h modules/capture.h modules/dimmer.h \
+ modules/mutewatch.h modules/frameclock.h modules/batch.h
+governor.o: modules/governor.c modules/locale_macros.h modules/devio.h \
+ modules/rgbmodes.h modules/argparser.h modules/rtprofile.h \
+ modules/ledmap.h modules/governor.h modules/capture.h modules/dimmer.h \
+ modules/mutewatch.h modules/frameclock.h modules/reporter.h
+rtprofile.o: modules/rtprofile.c modules/locale_macros.h \
+ modules/frameclock.h modules/rtprofile.h modules/reporter.h
+capture.o: modules/capture.c modules/locale_macros.h modules/devio.h \
+ modules/rgbmodes.h modules/argparser.h modules/rtprofile.h \
+ modules/ledmap.h modules/governor.h modules/capture.h modules/dimmer.h \
+ modules/mutewatch.h
+dimmer.o: modules/dimmer.c modules/devio.h modules/rgbmodes.h \
+ modules/argparser.h modules/locale_macros.h modules/rtprofile.h \
+ modules/ledmap.h modules/governor.h modules/capture.h modules/dimmer.h \
+ modules/mutewatch.h modules/frameclock.h modules/colorpipe.h
+modereg.o: modules/modereg.c modules/locale_macros.h modules/argparser.h \
+ modules/rtprofile.h modules/modereg.h
+mutewatch.o: modules/mutewatch.c modules/locale_macros.h modules/devio.h \
+ modules/rgbmodes.h modules/argparser.h modules/rtprofile.h \
+ modules/ledmap.h modules/governor.h modules/capture.h modules/dimmer.h \
+ modules/mutewatch.h modules/scene.h
+reporter.o: modules/reporter.c modules/service.h modules/locale_macros.h \
+ modules/reporter.h
+libquadcastrgb.o: modules/libquadcastrgb.c modules/locale_macros.h \
+ modules/argparser.h modules/rtprofile.h modules/rgbmodes.h \
+ modules/devio.h modules/ledmap.h modules/governor.h modules/capture.h \
+ modules/dimmer.h modules/mutewatch.h modules/libquadcastrgb.h
@@ -24,10 +24,16 @@
  * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
  */
 #include <stdio.h>
+#include <string.h> /* for strcspn */
 #include "modules/locale_macros.h"
 #include "modules/argparser.h"
 #include "modules/rgbmodes.h"
 #include "modules/devio.h"
+#include "modules/scene.h"
+#include "modules/service.h"
+#include "modules/batch.h"
+#include "modules/capture.h"
+#include "modules/reporter.h"
 
 #define LOCALESETUP() \
     setlocale(LC_CTYPE, ""); \
@@ -40,9 +46,7 @@
         puts(MSG)
 
 #define LIBUSB_FREE_EVERYTHING() \
-    libusb_release_interface(handle, 0); \
-    libusb_release_interface(handle, 1); \
-    libusb_close(handle); \
+    close_mic(handle); /* NULL if the microphone was lost */ \
     libusb_exit(NULL)
 
 #define VERBOSE_ARG _("Arguments parsed successfully.")
@@ -50,28 +54,179 @@
 #define VERBOSE_COL _("Assembling data packets.")
 #define VERBOSE_PKT _("Sending packets.")
 #define VERBOSE_END _("Done.")
+#define VERBOSE_SCN _("Loading the scene.")
+#define VERBOSE_WAIT _("Waiting for the microphone.")
+#define VERBOSE_SAVE _("Saving the colorscheme.")
+#define VERBOSE_BATCH _("Reading the batch.")
+
+#define DIM_LINE_LEN 64
+
+enum { sceneerr = 6 }; /* exitcode, continues the ones of devio */
+
+static int play_colorscheme(libusb_device_handle **handle,
+                  struct colschemes *cs, const struct progopts *opts,
+                  struct ctl *ctl);
+static int save_colorscheme(const datpack *data_arr, int pck_cnt,
+                       unsigned short pid, const struct progopts *opts);
+static int play_scene(libusb_device_handle **handle, unsigned short pid,
+                           const struct progopts *opts, struct ctl *ctl);
+static int serve(struct colschemes *cs, const struct progopts *opts,
+                                                         struct ctl *ctl);
+static int send_dim(const struct progopts *opts);
 
 int main(int argc, const char **argv)
 {
     struct colschemes cs;
-    datpack *data_arr;
+    struct progopts opts;
+    struct ctl ctl;
     libusb_device_handle *handle;
-    int verbose = 0, data_packet_cnt;
+    int status;
     /* Parse arguments */
-    parse_arg(&cs, argc, argv, &verbose);
-    VERBOSE_PRINT(verbose, VERBOSE_ARG);
+    status = parse_arg(&cs, argc, argv, &opts);
+    if(status != success)
+        return (status == argdone) ? success : status;
+    VERBOSE_PRINT(opts.verbose, VERBOSE_ARG);
+    if(opts.poke)
+        return ctl_poke(opts.socket);
+    if(opts.dim)
+        return send_dim(&opts);
+    if(opts.analyze)
+        return capture_analyze(opts.analyze);
+    status = ctl_listen(&ctl, opts.socket);
+    if(status)
+        return status;
+    if(ctl.fd >= 0) { /* resident, waits for the microphone */
+        status = serve(&cs, &opts, &ctl);
+        reporter_stop();
+        ctl_close(&ctl);
+        VERBOSE_PRINT(opts.verbose, VERBOSE_END);
+        return status;
+    }
     /* Open the microphone */
-    VERBOSE_PRINT(verbose, VERBOSE_MIC);
-    handle = open_mic(&cs.pid);
+    VERBOSE_PRINT(opts.verbose, VERBOSE_MIC);
+    status = open_mic(&handle, &cs.pid);
+    if(status)
+        return status;
+    if(opts.batch) {
+        VERBOSE_PRINT(opts.verbose, VERBOSE_BATCH);
+        status = play_batch(&handle, cs.pid, &opts);
+    } else if(opts.scene) {
+        status = play_scene(&handle, cs.pid, &opts, NULL);
+    } else {
+        status = play_colorscheme(&handle, &cs, &opts, NULL);
+    }
+    reporter_stop(); /* the last reports of the frame loop */
+    LIBUSB_FREE_EVERYTHING();
+    VERBOSE_PRINT(opts.verbose, VERBOSE_END);
+    return status;
+}
+
+/* Shows the colors until the program is stopped or the microphone is lost,
+ * the latter gives transfererr. The clients of ctl (may be NULL) can
+ * stream frames meanwhile */
+static int play_colorscheme(libusb_device_handle **handle,
+                   struct colschemes *cs, const struct progopts *opts,
+                   struct ctl *ctl)
+{
+    struct render_batch redraw;
+    datpack *data_arr;
+    int data_packet_cnt, status;
     /* Create data packets */
-    VERBOSE_PRINT(verbose, VERBOSE_COL);
-    data_arr = parse_colorscheme(&cs, &data_packet_cnt);
+    VERBOSE_PRINT(opts->verbose, VERBOSE_COL);
+    cs->br_at_send = !opts->scene_out; /* the saved frames keep -b */
+    data_arr = stream_colorscheme(cs, &data_packet_cnt, &redraw);
+    if(!data_arr) { /* the user was told if the mode is unsupported */
+        render_batch_free(&redraw);
+        if(data_packet_cnt < 0)
+            return nosupporterr;
+        fputs(NOMEM_MSG, stderr);
+        return nomemerr;
+    }
+    if(opts->scene_out &&
+              save_colorscheme(data_arr, data_packet_cnt, cs->pid, opts)) {
+        render_batch_free(&redraw);
+        free(data_arr);
+        return sceneerr;
+    }
     /* Send packets */
-    VERBOSE_PRINT(verbose, VERBOSE_PKT);
-    send_packets(handle, data_arr, data_packet_cnt, verbose, cs.pid);
+    VERBOSE_PRINT(opts->verbose, VERBOSE_PKT);
+    status = send_packets(handle, data_arr, data_packet_cnt, opts, cs,
+                                                            &redraw, ctl);
     /* Free all memory */
+    render_batch_free(&redraw);
     free(data_arr);
-    LIBUSB_FREE_EVERYTHING();
-    VERBOSE_PRINT(verbose, VERBOSE_END);
-    return 0;
+    return status;
+}
+
+/* Writes the frames for --restore (--scene) to play without any parsing */
+static int save_colorscheme(const datpack *data_arr, int pck_cnt,
+                        unsigned short pid, const struct progopts *opts)
+{
+    struct scene sc;
+    struct frame_seq seq;
+    int errcode;
+    VERBOSE_PRINT(opts->verbose, VERBOSE_SAVE);
+    frame_seq_init(&seq, data_arr, pck_cnt, pid);
+    if(scene_from_frames(&sc, &seq, pid))
+        return 1;
+    errcode = scene_save(&sc, opts->scene_out);
+    scene_free(&sc);
+    return errcode;
+}
+
+static int play_scene(libusb_device_handle **handle, unsigned short pid,
+                            const struct progopts *opts, struct ctl *ctl)
+{
+    struct scene sc;
+    int status;
+    VERBOSE_PRINT(opts->verbose, VERBOSE_SCN);
+    if(scene_load(&sc, opts->scene, pid))
+        return sceneerr;
+    if(opts->scene_out && scene_save(&sc, opts->scene_out)) {
+        scene_free(&sc);
+        return sceneerr;
+    }
+    VERBOSE_PRINT(opts->verbose, VERBOSE_PKT);
+    status = send_scene(handle, &sc, opts, ctl);
+    scene_free(&sc);
+    return status;
+}
+
+/* Plays again each time the microphone comes back, the frames are
+ * assembled anew since it might be another model */
+static int serve(struct colschemes *cs, const struct progopts *opts,
+                                                           struct ctl *ctl)
+{
+    libusb_device_handle *handle = NULL;
+    int status = 0;
+    if(libusb_init(NULL)) {
+        perror("libusb_init");
+        return libusberr;
+    }
+    VERBOSE_PRINT(opts->verbose, VERBOSE_WAIT);
+    while(!wait_mic(&handle, &cs->pid, ctl, opts)) {
+        service_notify("STATUS=Showing the colors");
+        if(opts->batch) /* a file starts over, stdin goes on */
+            status = play_batch(&handle, cs->pid, opts);
+        else if(opts->scene)
+            status = play_scene(&handle, cs->pid, opts, ctl);
+        else
+            status = play_colorscheme(&handle, cs, opts, ctl);
+        close_mic(handle);
+        handle = NULL;
+        if(status != transfererr) /* stopped, done or can't be played */
+            break;
+        status = 0;
+    }
+    libusb_exit(NULL);
+    return status;
+}
+
+/* --dim PERCENT[:MS] becomes the command "dim PERCENT MS" */
+static int send_dim(const struct progopts *opts)
+{
+    char line[DIM_LINE_LEN];
+    snprintf(line, sizeof(line), "dim %s\n", opts->dim);
+    line[strcspn(line, ":")] = ' ';
+    return ctl_send(opts->socket, line);
 }
@@ -23,15 +23,42 @@
  * Also, you may visit the Free Software Foundation at
  * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
  */
+#include <time.h> /* for time */
+
 #include "argparser.h"
+#include "ledmap.h" /* for ledmap_parse_range */
+#include "governor.h" /* for GOVERNOR_MAX_THRESHOLD */
+#include "dimmer.h" /* for DIMMER_FULL */
+#include "modereg.h"
 
 /* Static declarations */
-static void set_arg(const char ***arg_pp, const char **argv_end,
-                    struct colschemes *cs, int *state, int *verbose);
-static void set_br_spd_dly(const char **arg_p, const char **argv_end,
-                           int state, struct colschemes *cs);
-static void set_mode(const char ***arg_pp, const char **argv_end,
-                     int state, struct colschemes *cs);
+static int set_arg(const char ***arg_pp, const char **argv_end,
+                   struct colschemes *cs, int *state,
+                   struct progopts *opts);
+static int set_file_opt(const char ***arg_pp, const char **argv_end,
+                        const char **file);
+static int set_wb(const char ***arg_pp, const char **argv_end,
+                  struct colschemes *cs);
+static int set_seed(const char ***arg_pp, const char **argv_end,
+                    struct colschemes *cs);
+static int set_range(const char ***arg_pp, const char **argv_end,
+                     struct colschemes *cs);
+static int set_governor(const char ***arg_pp, const char **argv_end,
+                        struct progopts *opts);
+static int set_realtime(const char ***arg_pp, const char **argv_end,
+                        struct progopts *opts);
+static int set_duration(const char ***arg_pp, const char **argv_end,
+                        struct progopts *opts);
+static int set_dim(const char ***arg_pp, const char **argv_end,
+                   struct progopts *opts);
+static int set_crossfade(const char ***arg_pp, const char **argv_end,
+                         struct progopts *opts);
+static int parse_hexcolor(const char *str);
+static int set_br_spd_dly(const char **arg_p, const char **argv_end,
+                          int state, struct colschemes *cs);
+static int set_plugin(const char ***arg_pp, const char **argv_end);
+static void set_mode(const struct rgb_mode *md, int state,
+                     struct colschemes *cs);
 static void set_colors(const char ***arg_pp, const char **argv_end,
                        int state, struct colschemes *cs);
 static void write_default_cols(struct colschemes *cs, int state);
@@ -40,7 +67,6 @@ static int no_opt_param(const char **arg_p, const char **argv_end);
 static int is_color(const char **arg_p, const char **argv_end);
 static int ishexnumber(const char *str);
 static int is_number(const char *str);
-static int is_mode(const char *str);
 
 #define WRITE_PARAM(TYPE, FUNNAME) \
     static void FUNNAME(TYPE *u, TYPE *l, TYPE value, int state) \
@@ -54,39 +80,55 @@ static int is_mode(const char *str);
     } \
 
 WRITE_PARAM(int, write_int_param)
-WRITE_PARAM(const char *, write_str_param)
-
-/* Const arrays */
-const char *modes[MODES_CNT] = {
-    "solid", "blink", "cycle", "wave", "lightning", "pulse", "visualizer"
-};
-static const int rainbow[RAINBOW_CNT] = {
-    0xff0000, 0xff009e, 0xcd00ff,
-    0x2b00ff, 0x0068ff, 0x00ffff,
-    0x00ff67, 0x32ff00, 0xceff00,
-    nocolor
-};
+WRITE_PARAM(const struct rgb_mode *, write_mode_param)
 
 /* Functions */
-void parse_arg(struct colschemes *cs, int argc, const char **argv,
-                                                                  int *verbose)
+/* Returns success, argerr or argdone if the help or version was printed */
+int parse_arg(struct colschemes *cs, int argc, const char **argv,
+                                                      struct progopts *opts)
 {
     const char **arg_p;
-    int cs_state = all;
+    int cs_state = all, status;
+    char names[MODE_NAMES_LEN];
 
     /* Set defaults */
     cs->upper.br = cs->lower.br = MAX_BR_SPD_DLY;
     cs->upper.spd = cs->lower.spd = SPD_DEFAULT;
     cs->upper.dly = cs->lower.dly = DLY_DEFAULT;
     cs->upper.mode = cs->lower.mode = NULL;
+    cs->gamma = cs->dither = cs->br_at_send = 0;
+    cs->wb = nocolor;
+    cs->seed = (unsigned long)time(NULL);
+    cs->range_cnt = 0;
+    opts->verbose = opts->foreground = opts->poke = opts->sync = 0;
+    opts->scene = opts->scene_out = opts->socket = opts->batch = NULL;
+    opts->governor = -1;
+    opts->rt.priority = opts->rt.cpu = -1;
+    opts->capture = opts->analyze = NULL;
+    opts->duration = 0;
+    opts->dim = NULL;
+    opts->crossfade = 0;
+    opts->muted = NULL;
 
-    for(arg_p = argv+1; arg_p < argv+argc; arg_p++)
-        set_arg(&arg_p, argv+argc-1, cs, &cs_state, verbose);
+    for(arg_p = argv+1; arg_p < argv+argc; arg_p++) {
+        status = set_arg(&arg_p, argv+argc-1, cs, &cs_state, opts);
+        if(status != success)
+            return status;
+    }
 
-    if(!(cs->upper.mode)) { /* any chosen group sets also the other */
-        fprintf(stderr, NOMODE_MSG);
-        exit(argerr);
+    if(!(cs->upper.mode) && cs->range_cnt) { /* ranges over black */
+        cs->upper.mode = cs->lower.mode = &solid_mode;
+        cs->upper.colors[0] = cs->lower.colors[0] = black;
+        cs->upper.colors[1] = cs->lower.colors[1] = nocolor;
     }
+    /* any group sets the other, so the upper one is enough to check */
+    if(!(cs->upper.mode) && !(opts->scene) && !(opts->poke) &&
+                 !(opts->batch) && !(opts->analyze) && !(opts->dim)) {
+        mode_names(names, sizeof(names), "|");
+        fprintf(stderr, NOMODE_MSG, names);
+        return argerr;
+    }
+    return success;
 }
 
 int strequ(const char *str1, const char *str2)
@@ -95,17 +137,61 @@ int strequ(const char *str1, const char *str2)
 }
 
 /* Changes all given parameters except argv_end */
-static void set_arg(const char ***arg_pp, const char **argv_end,
-                    struct colschemes *cs, int *state, int *verbose)
+static int set_arg(const char ***arg_pp, const char **argv_end,
+                   struct colschemes *cs, int *state,
+                   struct progopts *opts)
 {
+    char names[MODE_NAMES_LEN];
     if(strequ(**arg_pp, "--version")) {
         puts(VERSION_MESSAGE);
-        exit(success);
+        return argdone;
     } else if(strequ(**arg_pp, "-h") || strequ(**arg_pp, "--help")) {
-        puts(HELP_MESSAGE);
-        exit(success);
+        mode_names(names, sizeof(names), ", ");
+        printf(HELP_MESSAGE, names);
+        return argdone;
     } else if(strequ(**arg_pp, "-v") || strequ(**arg_pp, "--verbose")) {
-        *verbose = 1;
+        opts->verbose = 1;
+    } else if(strequ(**arg_pp, "-f") || strequ(**arg_pp, "--foreground")) {
+        opts->foreground = 1;
+    } else if(strequ(**arg_pp, "--socket")) {
+        return set_file_opt(arg_pp, argv_end, &opts->socket);
+    } else if(strequ(**arg_pp, "--poke")) {
+        opts->poke = 1;
+    } else if(strequ(**arg_pp, "--sync")) {
+        opts->sync = 1;
+    } else if(strequ(**arg_pp, "--governor")) {
+        return set_governor(arg_pp, argv_end, opts);
+    } else if(strequ(**arg_pp, "--realtime")) {
+        return set_realtime(arg_pp, argv_end, opts);
+    } else if(strequ(**arg_pp, "--capture")) {
+        return set_file_opt(arg_pp, argv_end, &opts->capture);
+    } else if(strequ(**arg_pp, "--analyze")) {
+        return set_file_opt(arg_pp, argv_end, &opts->analyze);
+    } else if(strequ(**arg_pp, "--dim")) {
+        return set_dim(arg_pp, argv_end, opts);
+    } else if(strequ(**arg_pp, "--duration")) {
+        return set_duration(arg_pp, argv_end, opts);
+    } else if(strequ(**arg_pp, "--crossfade")) {
+        return set_crossfade(arg_pp, argv_end, opts);
+    } else if(strequ(**arg_pp, "--muted")) {
+        return set_file_opt(arg_pp, argv_end, &opts->muted);
+    } else if(strequ(**arg_pp, "-g") || strequ(**arg_pp, "--gamma")) {
+        cs->gamma = 1;
+    } else if(strequ(**arg_pp, "--dither")) {
+        cs->gamma = cs->dither = 1;
+    } else if(strequ(**arg_pp, "-w") || strequ(**arg_pp, "--white-balance")) {
+        return set_wb(arg_pp, argv_end, cs);
+    } else if(strequ(**arg_pp, "--seed")) {
+        return set_seed(arg_pp, argv_end, cs);
+    } else if(strequ(**arg_pp, "-r") || strequ(**arg_pp, "--range")) {
+        return set_range(arg_pp, argv_end, cs);
+    } else if(strequ(**arg_pp, "--scene") || strequ(**arg_pp, "--restore")) {
+        return set_file_opt(arg_pp, argv_end, &opts->scene);
+    } else if(strequ(**arg_pp, "--scene-out") || strequ(**arg_pp, "--save")) {
+        return set_file_opt(arg_pp, argv_end, &opts->scene_out);
+    } else if(strequ(**arg_pp, "--batch")) {
+        opts->foreground = 1; /* the lines are read as they come */
+        return set_file_opt(arg_pp, argv_end, &opts->batch);
     } else if(strequ(**arg_pp, "-a") || strequ(**arg_pp, "--all")) {
         *state = all;
     } else if(strequ(**arg_pp, "-u") || strequ(**arg_pp, "--upper")) {
@@ -114,39 +200,184 @@ static void set_arg(const char ***arg_pp, const char **argv_end,
         *state = lower;
     } else if(strequ(**arg_pp, "-b") || strequ(**arg_pp, "-s") ||
                                         strequ(**arg_pp, "-d")) {
-        set_br_spd_dly(*arg_pp, argv_end, *state, cs);
         (*arg_pp)++; /* skip option's parameter */
-    } else if(is_mode(**arg_pp)) {
-        set_mode(arg_pp, argv_end, *state, cs);
+        return set_br_spd_dly(*arg_pp-1, argv_end, *state, cs);
+    } else if(strequ(**arg_pp, "--plugin")) {
+        return set_plugin(arg_pp, argv_end);
+    } else if(mode_find(**arg_pp)) {
+        set_mode(mode_find(**arg_pp), *state, cs);
         set_colors(arg_pp, argv_end, *state, cs);
     } else {
         fprintf(stderr, BADARG_MSG, **arg_pp);
-        exit(argerr);
+        return argerr;
     }
+    return success;
 }
 
-static int is_mode(const char *str)
+static int set_file_opt(const char ***arg_pp, const char **argv_end,
+                        const char **file)
 {
-    int i;
-    for(i = 0; i < MODES_CNT; i++) {
-        if(strequ(modes[i], str))
-            return 1;
+    if(*arg_pp == argv_end) {
+        fprintf(stderr, NOFILE_MSG, **arg_pp);
+        return argerr;
+    }
+    (*arg_pp)++;
+    *file = **arg_pp;
+    return success;
+}
+
+static int set_wb(const char ***arg_pp, const char **argv_end,
+                  struct colschemes *cs)
+{
+    if(!is_color(*arg_pp+1, argv_end)) {
+        fprintf(stderr, NOCOLOR_MSG, **arg_pp);
+        return argerr;
     }
-    return 0;
+    (*arg_pp)++;
+    cs->wb = parse_hexcolor(**arg_pp);
+    return success;
 }
 
-static void set_br_spd_dly(const char **arg_p, const char **argv_end,
-                           int state, struct colschemes *cs)
+static int set_seed(const char ***arg_pp, const char **argv_end,
+                    struct colschemes *cs)
+{
+    if(no_opt_param(*arg_pp, argv_end)) {
+        fprintf(stderr, NOPARAM_SHORT_MSG, **arg_pp);
+        return argerr;
+    }
+    (*arg_pp)++;
+    cs->seed = strtoul(**arg_pp, NULL, 10);
+    return success;
+}
+
+static int set_range(const char ***arg_pp, const char **argv_end,
+                     struct colschemes *cs)
+{
+    struct ledrange *rng;
+    if(cs->range_cnt == MAX_RANGES) {
+        fprintf(stderr, RANGES_MSG, **arg_pp);
+        return argerr;
+    }
+    rng = cs->ranges + cs->range_cnt;
+    if(*arg_pp == argv_end || !is_color(*arg_pp+2, argv_end) ||
+                 ledmap_parse_range(*(*arg_pp+1), &rng->first, &rng->last)) {
+        fprintf(stderr, BADRANGE_MSG, **arg_pp);
+        return argerr;
+    }
+    *arg_pp += 2;
+    rng->start = parse_hexcolor(**arg_pp);
+    rng->end = nocolor;
+    if(is_color(*arg_pp+1, argv_end)) { /* a gradient */
+        (*arg_pp)++;
+        rng->end = parse_hexcolor(**arg_pp);
+    }
+    cs->range_cnt++;
+    return success;
+}
+
+static int set_governor(const char ***arg_pp, const char **argv_end,
+                        struct progopts *opts)
+{
+    long threshold;
+    if(no_opt_param(*arg_pp, argv_end)) {
+        fprintf(stderr, NOPARAM_SHORT_MSG, **arg_pp);
+        return argerr;
+    }
+    threshold = strtol(*(*arg_pp+1), NULL, 10);
+    if(threshold > GOVERNOR_MAX_THRESHOLD) {
+        fprintf(stderr, GOVERNOR_MSG, **arg_pp, GOVERNOR_MAX_THRESHOLD);
+        return argerr;
+    }
+    (*arg_pp)++;
+    opts->governor = (int)threshold;
+    return success;
+}
+
+/* PRIO or PRIO:CPU */
+static int set_realtime(const char ***arg_pp, const char **argv_end,
+                        struct progopts *opts)
+{
+    const char *param;
+    char *end;
+    long prio, cpu = -1;
+    if(*arg_pp == argv_end) {
+        fprintf(stderr, NOPARAM_LONG_MSG, **arg_pp);
+        return argerr;
+    }
+    param = *(*arg_pp+1);
+    prio = strtol(param, &end, 10);
+    if(*end == ':' && end[1] >= '0' && end[1] <= '9')
+        cpu = strtol(end+1, &end, 10);
+    if(end == param || *end || prio < 0 || prio > RT_MAX_PRIORITY) {
+        fprintf(stderr, REALTIME_MSG, **arg_pp, RT_MAX_PRIORITY);
+        return argerr;
+    }
+    (*arg_pp)++;
+    opts->rt.priority = (int)prio;
+    opts->rt.cpu = (int)cpu;
+    return success;
+}
+
+static int set_duration(const char ***arg_pp, const char **argv_end,
+                        struct progopts *opts)
+{
+    if(no_opt_param(*arg_pp, argv_end)) {
+        fprintf(stderr, NOPARAM_SHORT_MSG, **arg_pp);
+        return argerr;
+    }
+    (*arg_pp)++;
+    opts->duration = strtoul(**arg_pp, NULL, 10);
+    return success;
+}
+
+static int set_crossfade(const char ***arg_pp, const char **argv_end,
+                         struct progopts *opts)
+{
+    if(no_opt_param(*arg_pp, argv_end)) {
+        fprintf(stderr, NOPARAM_SHORT_MSG, **arg_pp);
+        return argerr;
+    }
+    (*arg_pp)++;
+    opts->crossfade = strtoul(**arg_pp, NULL, 10);
+    return success;
+}
+
+/* PERCENT or PERCENT:MS, checked here to fail before connecting */
+static int set_dim(const char ***arg_pp, const char **argv_end,
+                   struct progopts *opts)
+{
+    const char *param;
+    char *end;
+    long level;
+    if(*arg_pp == argv_end) {
+        fprintf(stderr, NOPARAM_LONG_MSG, **arg_pp);
+        return argerr;
+    }
+    param = *(*arg_pp+1);
+    level = strtol(param, &end, 10);
+    if(*end == ':' && end[1] >= '0' && end[1] <= '9')
+        strtoul(end+1, &end, 10);
+    if(end == param || *end || level < 0 || level > DIMMER_FULL) {
+        fprintf(stderr, DIM_MSG, **arg_pp);
+        return argerr;
+    }
+    (*arg_pp)++;
+    opts->dim = param;
+    return success;
+}
+
+static int set_br_spd_dly(const char **arg_p, const char **argv_end,
+                          int state, struct colschemes *cs)
 {
     short num;
     if(no_opt_param(arg_p, argv_end)) {
         fprintf(stderr, NOPARAM_SHORT_MSG, *arg_p);
-        exit(argerr);
+        return argerr;
     }
     num = atoi(*(arg_p+1));
     if(num > MAX_BR_SPD_DLY) {
         fprintf(stderr, BS_BADPARAM_MSG, *arg_p);
-        exit(argerr);
+        return argerr;
     }
     if(strequ(*arg_p, "-b")) {        /* brightness */
         write_int_param(&(cs->upper.br), &(cs->lower.br), num, state);
@@ -155,6 +386,7 @@ static void set_br_spd_dly(const char **arg_p, const char **argv_end,
     } else if(strequ(*arg_p, "-d")) { /* delay */
         write_int_param(&(cs->upper.dly), &(cs->lower.dly), num, state);
     }
+    return success;
 }
 
 static int is_number(const char *str)
@@ -172,13 +404,25 @@ static int no_opt_param(const char **arg_p, const char **argv_end)
     return (arg_p == argv_end || !(is_number(*(arg_p+1)))) ? 1 : 0;
 }
 
-static void set_mode(const char ***arg_pp, const char **argv_end,
-                     int state, struct colschemes *cs)
+/* The modes of the plug-in can be given after it */
+static int set_plugin(const char ***arg_pp, const char **argv_end)
 {
-    write_str_param(&(cs->upper.mode), &(cs->lower.mode), **arg_pp, state);
+    if(*arg_pp == argv_end) {
+        fprintf(stderr, NOFILE_MSG, **arg_pp);
+        return argerr;
+    }
+    (*arg_pp)++;
+    return mode_load_plugin(**arg_pp) ? argerr : success;
+}
+
+static void set_mode(const struct rgb_mode *md, int state,
+                     struct colschemes *cs)
+{
+    write_mode_param(&(cs->upper.mode), &(cs->lower.mode), md, state);
     if(!(cs->upper.mode) || !(cs->lower.mode)) { /* write solid to the other */
         int swap = (state == upper) ? lower : upper; /* state != all */
-        write_str_param(&(cs->upper.mode), &(cs->lower.mode), modes[0], swap);
+        write_mode_param(&(cs->upper.mode), &(cs->lower.mode),
+                                          &solid_mode, swap);
         write_int_param(cs->upper.colors, cs->lower.colors, black, swap);
         write_int_param(cs->upper.colors+1, cs->lower.colors+1, nocolor,
                         swap);
@@ -196,10 +440,7 @@ static void set_colors(const char ***arg_pp, const char **argv_end,
         do {
             int hexnum;
             (*arg_pp)++;
-            if(***arg_pp == '#')
-                hexnum = (int)strtol(**arg_pp+1, NULL, 16);
-            else
-                hexnum = (int)strtol(**arg_pp, NULL, 16);
+            hexnum = parse_hexcolor(**arg_pp);
 
             write_int_param(&(cs->upper.colors[col_cnt]),
                             &(cs->lower.colors[col_cnt]), hexnum, state);
@@ -211,23 +452,25 @@ static void set_colors(const char ***arg_pp, const char **argv_end,
     }
 }
 
+/* The defaults of the mode, see struct rgb_mode */
 static void write_default_cols(struct colschemes *cs, int state)
 {
-    const char *md = (state == upper) ? cs->upper.mode : cs->lower.mode;
-    if(strequ(md, modes[2]) || strequ(md, modes[3])) { /* cycle or wave */
-        int i;
-        for(i = 0; i < RAINBOW_CNT; i++) {
-            write_int_param(&(cs->upper.colors[i]), &(cs->lower.colors[i]),
-                            rainbow[i], state);
-        }
-    } else if(strequ(md, modes[1])) { /* blink */
-        write_int_param(cs->upper.colors, cs->lower.colors,
-                        nocolor, state);
-    } else { /* solid, lightning, pulse */
-        write_int_param(cs->upper.colors, cs->lower.colors, red, state);
-        write_int_param(cs->upper.colors+1, cs->lower.colors+1, nocolor,
-                        state);
+    const struct rgb_mode *md;
+    int i;
+    md = (state == upper) ? cs->upper.mode : cs->lower.mode;
+    for(i = 0; i < COLORS_CNT-1 && md->defaults[i] != nocolor; i++) {
+        write_int_param(&(cs->upper.colors[i]), &(cs->lower.colors[i]),
+                        md->defaults[i], state);
     }
+    write_int_param(&(cs->upper.colors[i]), &(cs->lower.colors[i]),
+                    nocolor, state);
+}
+
+static int parse_hexcolor(const char *str)
+{
+    if(*str == '#')
+        str++;
+    return (int)strtol(str, NULL, 16);
 }
 
 static int ishexnumber(const char *str)
@@ -2,8 +2,9 @@
  * File argparser.h
  * The task of this module is to allocate a colorscheme struct
  * according to the arguments.
- * In case of [-h|--help], write help message and finish program
- * with 0 exit code.
+ * In case of [-h|--help], write help message and return argdone so the
+ * caller can finish with 0 exit code. Errors are reported on stderr and
+ * returned as argerr, the module never ends the program by itself.
  *
  * <----- License notice ----->
  * Copyright (C) 2022, 2023, 2024 Ors1mer
@@ -31,17 +32,17 @@
 #define ARGPARSER_SENTRY
 
 #include <stdio.h> /* for fprintf */
-#include <stdlib.h> /* for malloc, exit, atoi */
+#include <stdlib.h> /* for malloc, atoi, strtoul */
 #include <string.h> /* for strcmp */
 #include "locale_macros.h"
+#include "rtprofile.h" /* for struct rtprofile */
 
 /* Constants */
 #define COLORS_CNT 11
-#define MODES_CNT 7
-#define RAINBOW_CNT 10
 #define MAX_BR_SPD_DLY 100
 #define SPD_DEFAULT 81
 #define DLY_DEFAULT 10
+#define MAX_RANGES 16
 
 enum hexcolors {
     red = 0xf20000,
@@ -49,7 +50,7 @@ enum hexcolors {
     nocolor = -1
 };
 
-enum arg_exitcodes { success, argerr }; /* exitcodes */
+enum arg_exitcodes { argdone = -1, success, argerr }; /* exitcodes */
 
 enum diode_group { all, upper, lower }; /* state values */
 
@@ -58,34 +59,93 @@ enum diode_group { all, upper, lower }; /* state values */
 #define VERSION "unknown"
 #endif
 #define VERSION_MESSAGE "quadcastrgb version " VERSION
-#define HELP_MESSAGE _("Usage: quadcastrgb [-h] [-v] [-a|-u|-l] [-b bright] "\
-                     "[-s speed] mode [COLORS]...\nAvailable modes: "\
-                     "solid, blink, cycle, lightning, wave. Colors are hex "\
-                     "numbers.\nSee 'man quadcastrgb' for details.")
+#define HELP_MESSAGE _("Usage: quadcastrgb [-h] [-v] [-g] [-w gains] "\
+                     "[--dither] [--seed N] [-a|-u|-l] [-b bright] "\
+                     "[-s speed] [--save FILE] mode [COLORS]...\n"\
+                     "       quadcastrgb [OPTIONS] [mode [COLORS]...] "\
+                     "-r RANGE COLOR [COLOR]...\n"\
+                     "       quadcastrgb [-v] "\
+                     "--scene FILE [--scene-out FILE]\n"\
+                     "       quadcastrgb [-v] --restore FILE\n"\
+                     "       quadcastrgb [-v] [--crossfade MS] --batch FILE\n"\
+                     "       quadcastrgb --poke [--socket PATH]\n"\
+                     "       quadcastrgb --dim PERCENT[:MS] "\
+                     "[--socket PATH]\n"\
+                     "       quadcastrgb --analyze FILE\n"\
+                     "Service options: -f (--foreground), --socket PATH, "\
+                     "--sync, --governor N, --realtime PRIO[:CPU], "\
+                     "--capture FILE, --duration SEC, --muted FILE."\
+                     "\nAvailable modes: %s; --plugin FILE before the "\
+                     "mode loads more.\nColors are hex numbers. "\
+                     "See 'man quadcastrgb' for details.\n")
 #define BADARG_MSG   _("Unknown option: %s\n")
 #define NOPARAM_LONG_MSG _("%s: no parameter(s) specified\n")
 #define NOPARAM_SHORT_MSG _("%s: no parameter or it isn't a natural number\n")
 #define BS_BADPARAM_MSG _("%s: the parameter must be an integer 0-100\n")
-#define NOMODE_MSG _("No mode specified (solid|blink|cycle|lightning|wave)\n")
+#define NOMODE_MSG _("No mode specified (%s)\n")
+#define NOFILE_MSG _("%s: no file specified\n")
+#define NOCOLOR_MSG _("%s: the parameter must be a hex color\n")
+#define BADRANGE_MSG _("%s: the parameters must be a range of LEDs " \
+                       "(FIRST:LAST or a zone) and a hex color\n")
+#define RANGES_MSG _("%s: too many ranges\n")
+#define REALTIME_MSG _("%s: the parameter must be a priority 0-%d, " \
+                       "optionally followed by :CPU\n")
+#define DIM_MSG _("%s: the parameter must be a percent 0-100, " \
+                  "optionally followed by :MS\n")
+#define GOVERNOR_MSG _("%s: the parameter must be an integer 0-%d\n")
 
 /* Structs */
+struct rgb_mode; /* see modereg.h */
+
 struct colscheme {
-    const char *mode;
+    const struct rgb_mode *mode;
     int colors[COLORS_CNT];
     int br;
     int spd; /* ignored in solid */
     int dly; /* blink-only */
 };
 
+struct ledrange { /* Quadcast 2S only, see ledmap.h */
+    int first, last; /* LEDs */
+    int start, end; /* hexcolors, end is nocolor if it isn't a gradient */
+};
+
 struct colschemes {
     struct colscheme upper; /* for the upper diode */
     struct colscheme lower; /* for the lower diodes */
     unsigned short pid; /* the microphone's product id */
+    int gamma; /* use the perceptual color pipeline (see colorpipe.h) */
+    int wb; /* white balance gains as a hexcolor, nocolor - neutral */
+    int dither; /* temporal dithering, implies gamma */
+    int br_at_send; /* -b of Quadcast S goes over the frames as they are
+                     * sent, see frame_seq_levels */
+    unsigned long seed; /* of the random colors, the time by default */
+    struct ledrange ranges[MAX_RANGES]; /* put over the frames in order */
+    int range_cnt;
+};
+
+struct progopts {
+    int verbose;
+    int foreground; /* don't become a daemon */
+    const char *scene; /* scene file to play instead of a colorscheme */
+    const char *scene_out; /* where to write the compiled scene/scheme */
+    const char *socket; /* control socket to listen on (see service.h) */
+    int poke; /* only poke the resident instance at socket */
+    int sync; /* take the frames from the master clock, see frameclock.h */
+    const char *batch; /* colorschemes to show one by one, see batch.h */
+    int governor; /* threshold of the frame-rate governor, -1 - off */
+    struct rtprofile rt; /* real-time profile of the send loop */
+    const char *capture; /* where to record the timing of the frames */
+    const char *analyze; /* capture to analyze instead of showing colors */
+    unsigned int duration; /* seconds to show the colors for, 0 - endless */
+    const char *dim; /* PERCENT[:MS] to send to the resident instance */
+    unsigned long crossfade; /* millisec between batch lines, 0 - a cut */
+    const char *muted; /* colorscheme while muted, see mutewatch.h */
 };
 
 /* Functions */
-void parse_arg(struct colschemes *cs, int argc, const char **argv,
-                                                                 int *verbose);
+int parse_arg(struct colschemes *cs, int argc, const char **argv,
+                                                    struct progopts *opts);
 int strequ(const char *str1, const char *str2);
 
 #endif
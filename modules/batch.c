@@ -0,0 +1,321 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File batch.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include <pthread.h>
+#include <stdio.h> /* for fgets, printf & setvbuf */
+#include <stdlib.h> /* for free & strtoul */
+#include <string.h> /* for strtok, strtok_r, strcat & strspn */
+
+#include "locale_macros.h"
+#include "argparser.h"
+#include "rgbmodes.h"
+#include "devio.h"
+#include "frameclock.h"
+#include "batch.h"
+
+#define TOKEN_DELIM " \t\r\n"
+
+struct batch_entry { /* the frames of a line */
+    char key[BATCH_LINE_LEN]; /* the arguments, a space between them */
+    datpack *data_arr;
+    struct render_batch redraw;
+    struct frame_seq seq;
+};
+
+struct batch_cache {
+    struct batch_entry entries[BATCH_CACHE_SIZE];
+    int cnt;
+    int next; /* the oldest one, replaced when all are taken */
+};
+
+struct batch_job { /* a line assembled while the shown one goes on */
+    struct batch_entry entry;
+    unsigned short pid;
+    pthread_mutex_t lock;
+    int done, ok;
+};
+
+static int read_line(FILE *f, unsigned int *line_num, unsigned int *ms,
+                                                           char *key);
+static struct batch_entry *cache_find(struct batch_cache *cache,
+                                                     const char *key);
+static struct batch_entry *cache_put(struct batch_cache *cache,
+                                     const struct batch_entry *entry,
+                                     const struct batch_entry *keep);
+static void cache_free(struct batch_cache *cache);
+static int compile_line(libusb_device_handle **handle,
+                        struct frame_output *out, struct batch_job *job,
+                        struct batch_entry *shown, unsigned long long *frame,
+                        const struct progopts *opts);
+static void *compile_main(void *arg);
+static int compile_entry(struct batch_entry *entry, unsigned short pid);
+static void entry_free(struct batch_entry *entry);
+
+/* Returns 0 at the end of the lines or after a signal, transfererr if the
+ * microphone is lost or batcherr if the file can't be opened. Bad lines
+ * are reported and skipped */
+int play_batch(libusb_device_handle **handle, unsigned short pid,
+                                          const struct progopts *opts)
+{
+    struct batch_cache cache;
+    struct batch_entry *entry, *shown = NULL;
+    struct batch_job job;
+    struct crossfade xf;
+    struct frame_output out;
+    char key[BATCH_LINE_LEN];
+    unsigned long long read_at, shown_at, frame = 0;
+    unsigned int line_num = 0, ms = 0;
+    int cached, fade, errcode = 0;
+    FILE *f;
+
+    f = strequ(opts->batch, "-") ? stdin : fopen(opts->batch, "r");
+    if(!f) {
+        fprintf(stderr, BATCH_OPEN_ERR_MSG, opts->batch);
+        return batcherr;
+    }
+    setvbuf(f, NULL, _IONBF, 0); /* nothing read ahead, poll tells it all */
+    cache.cnt = cache.next = 0;
+    frame_output_init(&out, pid);
+    governor_init(&out.gov, opts->governor, pid);
+    if(mute_watch_open(&out.mute, opts->muted, pid)) {
+        if(f != stdin)
+            fclose(f);
+        return muteerr;
+    }
+    job.pid = pid;
+    pthread_mutex_init(&job.lock, NULL);
+    while(!errcode && read_line(f, &line_num, &ms, key)) {
+        read_at = frame_clock_now();
+        entry = cache_find(&cache, key);
+        cached = entry != NULL;
+        if(!entry) {
+            strcpy(job.entry.key, key);
+            errcode = compile_line(handle, &out, &job, shown, &frame, opts);
+            if(!errcode && job.ok) /* a signal is seen when it's shown */
+                entry = cache_put(&cache, &job.entry, shown);
+        }
+        if(errcode)
+            break;
+        if(!entry) {
+            fprintf(stderr, BATCH_LINE_ERR_MSG, opts->batch, line_num);
+            continue;
+        }
+        fade = opts->crossfade && shown && shown != entry;
+        if(fade) { /* the first frame of the fade is the one to time */
+            xf.seq[0] = &shown->seq;
+            xf.redraw[0] = &shown->redraw;
+            xf.frame[0] = frame;
+            xf.seq[1] = &entry->seq;
+            xf.redraw[1] = &entry->redraw;
+            xf.frame[1] = 0;
+            xf.start = frame_clock_now();
+            xf.end = xf.start + opts->crossfade*1000000ULL;
+            errcode = send_crossfade(handle, &out, &xf, 1, opts);
+        } else {
+            frame = 0;
+            errcode = send_frames(handle, &out, &entry->seq,
+                                  &entry->redraw, &frame, 1, 0, -1, opts);
+        }
+        if(errcode || is_stopped())
+            break;
+        /* the 2S transfers nothing when the start of a fade is unchanged */
+        shown_at = out.sent > read_at ? out.sent : frame_clock_now();
+        printf(BATCH_SHOWN_MSG, line_num,
+               cached ? BATCH_CACHED_MSG : BATCH_COMPILED_MSG,
+               (shown_at - read_at)/1000);
+        fflush(stdout);
+        if(fade) {
+            errcode = send_crossfade(handle, &out, &xf, 0, opts);
+            frame = xf.frame[1];
+            if(errcode || is_stopped())
+                break;
+        }
+        shown = entry;
+        if(ms)
+            errcode = send_frames(handle, &out, &entry->seq,
+                                  &entry->redraw, &frame, 0,
+                                  out.sent + ms*1000000ULL, -1, opts);
+        if(!errcode) /* until the next line comes */
+            errcode = send_frames(handle, &out, &entry->seq,
+                          &entry->redraw, &frame, 0, 0, fileno(f), opts);
+        if(is_stopped())
+            break;
+    }
+    /* the last line without a duration stays on */
+    if(!errcode && shown && !ms && !is_stopped())
+        errcode = send_frames(handle, &out, &shown->seq, &shown->redraw,
+                                                 &frame, 0, 0, -1, opts);
+    mute_watch_close(&out.mute);
+    cache_free(&cache);
+    pthread_mutex_destroy(&job.lock);
+    if(f != stdin)
+        fclose(f);
+    return errcode;
+}
+
+/* Skips blank lines. Returns 0 at the end */
+static int read_line(FILE *f, unsigned int *line_num, unsigned int *ms,
+                                                           char *key)
+{
+    char line[BATCH_LINE_LEN], *tok, *comment;
+    while(fgets(line, sizeof(line), f)) {
+        (*line_num)++;
+        comment = strchr(line, '#');
+        if(comment)
+            *comment = '\0';
+        tok = strtok(line, TOKEN_DELIM);
+        if(!tok) /* blank line */
+            continue;
+        *ms = 0;
+        if(strspn(tok, "0123456789") == strlen(tok)) {
+            *ms = strtoul(tok, NULL, 10);
+            tok = strtok(NULL, TOKEN_DELIM);
+        }
+        for(*key = '\0'; tok; tok = strtok(NULL, TOKEN_DELIM)) {
+            if(*key)
+                strcat(key, " ");
+            strcat(key, tok);
+        }
+        return 1;
+    }
+    return 0;
+}
+
+static struct batch_entry *cache_find(struct batch_cache *cache,
+                                                     const char *key)
+{
+    int i;
+    for(i = 0; i < cache->cnt; i++) {
+        if(strequ(cache->entries[i].key, key))
+            return cache->entries + i;
+    }
+    return NULL;
+}
+
+/* Puts the assembled line in the place of the oldest one but keep if the
+ * cache is full */
+static struct batch_entry *cache_put(struct batch_cache *cache,
+                                     const struct batch_entry *entry,
+                                     const struct batch_entry *keep)
+{
+    struct batch_entry *place;
+    if(cache->cnt < BATCH_CACHE_SIZE) {
+        place = cache->entries + cache->cnt++;
+    } else {
+        if(cache->entries + cache->next == keep)
+            cache->next = (cache->next+1) % BATCH_CACHE_SIZE;
+        place = cache->entries + cache->next;
+        cache->next = (cache->next+1) % BATCH_CACHE_SIZE;
+        entry_free(place);
+    }
+    *place = *entry;
+    return place;
+}
+
+static void cache_free(struct batch_cache *cache)
+{
+    int i;
+    for(i = 0; i < cache->cnt; i++)
+        entry_free(cache->entries + i);
+    cache->cnt = cache->next = 0;
+}
+
+/* Assembles job->entry on a thread of its own while the frames of shown
+ * go on, so the microphone doesn't wait for it; without a shown line (or
+ * a thread) it's done right here. Sets job->ok, returns 0 or transfererr */
+static int compile_line(libusb_device_handle **handle,
+                        struct frame_output *out, struct batch_job *job,
+                        struct batch_entry *shown, unsigned long long *frame,
+                        const struct progopts *opts)
+{
+    pthread_t tid;
+    int done = 0, errcode = 0;
+    job->done = 0;
+    if(!shown || pthread_create(&tid, NULL, compile_main, job)) {
+        job->ok = !compile_entry(&job->entry, job->pid);
+        return 0;
+    }
+    while(!done && !errcode && !is_stopped()) {
+        errcode = send_frames(handle, out, &shown->seq, &shown->redraw,
+                                                 frame, 1, 0, -1, opts);
+        pthread_mutex_lock(&job->lock);
+        done = job->done;
+        pthread_mutex_unlock(&job->lock);
+    }
+    pthread_join(tid, NULL);
+    if(errcode && job->ok) /* it won't be shown */
+        entry_free(&job->entry);
+    return errcode;
+}
+
+static void *compile_main(void *arg)
+{
+    struct batch_job *job = arg;
+    int ok;
+    ok = !compile_entry(&job->entry, job->pid);
+    pthread_mutex_lock(&job->lock);
+    job->ok = ok;
+    job->done = 1;
+    pthread_mutex_unlock(&job->lock);
+    return NULL;
+}
+
+/* Assembles the frames of entry->key. Returns 1 if the line can't be
+ * shown. strtok_r leaves alone the strtok of read_line */
+static int compile_entry(struct batch_entry *entry, unsigned short pid)
+{
+    char args[BATCH_LINE_LEN], *tok[BATCH_MAX_ARGS+1], *save;
+    struct colschemes cs;
+    struct progopts opts;
+    int tok_cnt = 1, pck_cnt;
+
+    strcpy(args, entry->key);
+    tok[0] = ""; /* stands for argv[0] */
+    tok[1] = strtok_r(args, TOKEN_DELIM, &save);
+    while(tok[tok_cnt] && tok_cnt < BATCH_MAX_ARGS) {
+        tok_cnt++;
+        tok[tok_cnt] = strtok_r(NULL, TOKEN_DELIM, &save);
+    }
+    if(parse_arg(&cs, tok_cnt, (const char **)tok, &opts) != success)
+        return 1;
+    if(opts.scene || opts.poke || opts.batch) /* colorschemes only */
+        return 1;
+    cs.pid = pid;
+    cs.br_at_send = 1;
+    entry->data_arr = stream_colorscheme(&cs, &pck_cnt, &entry->redraw);
+    if(!entry->data_arr) {
+        render_batch_free(&entry->redraw);
+        return 1;
+    }
+    frame_seq_init(&entry->seq, entry->data_arr, pck_cnt, pid);
+    frame_seq_levels(&entry->seq, &cs);
+    return 0;
+}
+
+static void entry_free(struct batch_entry *entry)
+{
+    render_batch_free(&entry->redraw);
+    free(entry->data_arr);
+}
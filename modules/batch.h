@@ -0,0 +1,67 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File batch.h
+ * Batch mode: colorschemes are read line by line from a file or stdin
+ * ("-") and shown one after another on the microphone that is opened
+ * once. A line is the usual command-line arguments, optionally after a
+ * duration in milliseconds ('#' starts a comment):
+ *     [MS] [OPTIONS] mode [COLORS]...
+ * A line is shown until the next one comes, and at least for its
+ * duration. The program ends after the duration of the last line; the
+ * last line without a duration stays on until the program is stopped.
+ *
+ * The frames of the last BATCH_CACHE_SIZE distinct lines are kept, so a
+ * line that comes again is shown without being assembled anew. For each
+ * line, the time from reading it to the end of the transfers of its first
+ * frame is written to stdout.
+ *
+ * A new line is assembled on a thread of its own while the previous one
+ * goes on. With --crossfade, the frames of both lines are blended for
+ * that long (see frame_blend) before the new one is shown alone; the
+ * fade is a part of the duration of the new line.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#ifndef BATCH_SENTRY
+#define BATCH_SENTRY
+
+#include "devio.h" /* for libusb_device_handle */
+
+/* Constants */
+#define BATCH_CACHE_SIZE 16
+#define BATCH_LINE_LEN 1024
+#define BATCH_MAX_ARGS 64
+
+/* Messages */
+#define BATCH_OPEN_ERR_MSG _("Couldn't open the batch file %s\n")
+#define BATCH_LINE_ERR_MSG _("%s:%u: couldn't show the line\n")
+#define BATCH_SHOWN_MSG _("%u: %s, the first frame in %llu microsec\n")
+#define BATCH_COMPILED_MSG _("assembled")
+#define BATCH_CACHED_MSG _("cached")
+
+enum batch_exitcodes { batcherr = 9 }; /* exitcode, after ctlerr */
+
+/* Functions */
+int play_batch(libusb_device_handle **handle, unsigned short pid,
+                                          const struct progopts *opts);
+
+#endif
@@ -0,0 +1,274 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File capture.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include <stdlib.h> /* for malloc, realloc & qsort */
+#include <string.h> /* for memset, memcmp & memcpy */
+
+#include "locale_macros.h"
+#include "devio.h" /* for FRAME_PERIOD */
+#include "capture.h"
+#include "reporter.h" /* for reporter_drain */
+
+#define CAPTURE_CHUNK 1024 /* records read at once */
+
+struct capture_stats {
+    unsigned long frames, dropped, duplicated;
+    unsigned long long *intervals; /* nanosec per frame period */
+    unsigned long long elapsed;    /* nanosec from the first record */
+    unsigned long long advanced;   /* frames from the first record */
+};
+
+static void capture_drain(void *cap);
+static void write_ring(struct capture *cap);
+static int read_records(FILE *f, const char *path,
+                        struct capture_stats *st);
+static void add_record(struct capture_stats *st,
+                       const struct capture_rec *rec,
+                       const struct capture_rec *prev);
+static void print_json(const struct capture_header *hdr,
+                       const struct capture_stats *st);
+static unsigned long long percentile(const unsigned long long *sorted,
+                                     unsigned long cnt, int pct);
+static int cmp_ull(const void *a, const void *b);
+
+/* Returns 0 or captureerr, a path of NULL captures nothing */
+int capture_open(struct capture *cap, const char *path, unsigned short pid,
+                                                      unsigned long loop)
+{
+    struct capture_header hdr;
+    cap->f = NULL;
+    cap->path = path;
+    cap->head = cap->tail = 0;
+    cap->lost = 0;
+    cap->drained = 0;
+    if(!path)
+        return 0;
+    cap->ring = malloc(CAPTURE_RING*sizeof(*cap->ring));
+    cap->f = cap->ring ? fopen(path, "wb") : NULL;
+    if(!cap->f) {
+        fprintf(stderr, CAPTURE_OPEN_ERR_MSG, path);
+        free(cap->ring);
+        return captureerr;
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, CAPTURE_MAGIC, sizeof(hdr.magic));
+    hdr.version = CAPTURE_VERSION;
+    hdr.pid = pid;
+    hdr.period = FRAME_PERIOD(pid);
+    hdr.loop = loop;
+    if(fwrite(&hdr, sizeof(hdr), 1, cap->f) != 1) {
+        fprintf(stderr, CAPTURE_WRITE_ERR_MSG, path);
+        capture_close(cap);
+        return captureerr;
+    }
+    return 0;
+}
+
+/* From now on the reporter thread writes the records, if there is one */
+void capture_start(struct capture *cap)
+{
+    if(cap->f)
+        cap->drained = !reporter_drain(capture_drain, cap);
+}
+
+/* Only copies the record to the ring while the reporter writes it */
+void capture_add(struct capture *cap, unsigned long long stamp,
+                 unsigned long long frame, unsigned int periods)
+{
+    struct capture_rec *rec;
+    unsigned int head = cap->head;
+    if(!cap->f)
+        return;
+    if(head - __atomic_load_n(&cap->tail, __ATOMIC_ACQUIRE) >=
+                                                         CAPTURE_RING) {
+        if(cap->drained) {
+            cap->lost++;
+            return;
+        }
+        write_ring(cap);
+    }
+    rec = cap->ring + head % CAPTURE_RING;
+    rec->stamp = stamp;
+    rec->frame = frame;
+    rec->periods = periods;
+    rec->pad = 0;
+    __atomic_store_n(&cap->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void capture_close(struct capture *cap)
+{
+    if(!cap->f)
+        return;
+    if(cap->drained)
+        reporter_drain(NULL, NULL);
+    write_ring(cap);
+    if(cap->lost)
+        fprintf(stderr, CAPTURE_LOST_MSG, cap->path, cap->lost);
+    if(ferror(cap->f) | fclose(cap->f))
+        fprintf(stderr, CAPTURE_WRITE_ERR_MSG, cap->path);
+    cap->f = NULL;
+    free(cap->ring);
+}
+
+static void capture_drain(void *cap)
+{
+    write_ring(cap);
+}
+
+/* A slot is given back once its record is written */
+static void write_ring(struct capture *cap)
+{
+    unsigned int tail = cap->tail, head, cnt;
+    head = __atomic_load_n(&cap->head, __ATOMIC_ACQUIRE);
+    while(tail != head) {
+        cnt = CAPTURE_RING - tail % CAPTURE_RING; /* up to the end */
+        if(cnt > head - tail)
+            cnt = head - tail;
+        fwrite(cap->ring + tail % CAPTURE_RING, sizeof(*cap->ring), cnt,
+                                                                  cap->f);
+        tail += cnt;
+        __atomic_store_n(&cap->tail, tail, __ATOMIC_RELEASE);
+    }
+}
+
+/* Prints the analysis of the capture to stdout, returns 0 or captureerr */
+int capture_analyze(const char *path)
+{
+    struct capture_header hdr;
+    struct capture_stats st;
+    FILE *f;
+    int errcode;
+    f = fopen(path, "rb");
+    if(!f) {
+        fprintf(stderr, CAPTURE_OPEN_ERR_MSG, path);
+        return captureerr;
+    }
+    if(fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+                memcmp(hdr.magic, CAPTURE_MAGIC, sizeof(hdr.magic)) ||
+                hdr.version != CAPTURE_VERSION || !hdr.period) {
+        fprintf(stderr, CAPTURE_FORMAT_ERR_MSG, path, CAPTURE_VERSION);
+        fclose(f);
+        return captureerr;
+    }
+    errcode = read_records(f, path, &st);
+    fclose(f);
+    if(errcode)
+        return errcode;
+    qsort(st.intervals, st.frames - 1, sizeof(*st.intervals), cmp_ull);
+    print_json(&hdr, &st);
+    free(st.intervals);
+    return 0;
+}
+
+static int read_records(FILE *f, const char *path,
+                        struct capture_stats *st)
+{
+    struct capture_rec recs[CAPTURE_CHUNK], first, prev;
+    unsigned long long *tmp;
+    size_t cnt, i, room = 0;
+    memset(st, 0, sizeof(*st));
+    while((cnt = fread(recs, sizeof(*recs), CAPTURE_CHUNK, f)) > 0) {
+        if(st->frames + cnt > room) {
+            room = st->frames + cnt + CAPTURE_CHUNK;
+            tmp = realloc(st->intervals, room * sizeof(*tmp));
+            if(!tmp) {
+                perror("realloc");
+                free(st->intervals);
+                return captureerr;
+            }
+            st->intervals = tmp;
+        }
+        for(i = 0; i < cnt; i++) {
+            if(!st->frames)
+                first = recs[i];
+            else
+                add_record(st, recs + i, &prev);
+            prev = recs[i];
+            st->frames++;
+        }
+    }
+    if(st->frames < 2) {
+        fprintf(stderr, CAPTURE_EMPTY_ERR_MSG, path);
+        free(st->intervals);
+        return captureerr;
+    }
+    st->elapsed = prev.stamp - first.stamp;
+    st->advanced = prev.frame - first.frame;
+    return 0;
+}
+
+static void add_record(struct capture_stats *st,
+                       const struct capture_rec *rec,
+                       const struct capture_rec *prev)
+{
+    unsigned long long due = prev->frame + (prev->periods ? prev->periods
+                                                                    : 1);
+    st->intervals[st->frames - 1] = (rec->stamp - prev->stamp) /
+                                    (prev->periods ? prev->periods : 1);
+    if(rec->frame > due)
+        st->dropped += rec->frame - due;
+    else if(rec->frame < due)
+        st->duplicated++;
+}
+
+static void print_json(const struct capture_header *hdr,
+                       const struct capture_stats *st)
+{
+    unsigned long long intended = st->advanced * hdr->period * 1000;
+    long long drift = (long long)st->elapsed - (long long)intended;
+    unsigned long n = st->frames - 1;
+    printf("{\n");
+    printf("  \"frames\": %lu,\n", st->frames);
+    printf("  \"period_us\": %lu,\n", (unsigned long)hdr->period);
+    printf("  \"interval_us\": { \"p50\": %llu, \"p99\": %llu, "
+           "\"max\": %llu },\n", percentile(st->intervals, n, 50) / 1000,
+           percentile(st->intervals, n, 99) / 1000,
+           st->intervals[n - 1] / 1000);
+    printf("  \"drift_us\": %lld,\n", drift / 1000);
+    printf("  \"drift_ppm\": %lld,\n", intended ?
+                              drift * 1000000 / (long long)intended : 0);
+    printf("  \"loop_ms\": { \"intended\": %llu, \"measured\": %llu },\n",
+           (unsigned long long)hdr->loop * hdr->period / 1000,
+           st->advanced ? hdr->loop * st->elapsed / st->advanced / 1000000
+                        : 0);
+    printf("  \"dropped\": %lu,\n", st->dropped);
+    printf("  \"duplicated\": %lu\n", st->duplicated);
+    printf("}\n");
+}
+
+/* Nearest rank */
+static unsigned long long percentile(const unsigned long long *sorted,
+                                     unsigned long cnt, int pct)
+{
+    unsigned long rank = (cnt * pct + 99) / 100;
+    return sorted[rank ? rank - 1 : 0];
+}
+
+static int cmp_ull(const void *a, const void *b)
+{
+    unsigned long long x = *(const unsigned long long *)a,
+                       y = *(const unsigned long long *)b;
+    return (x > y) - (x < y);
+}
@@ -0,0 +1,106 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File capture.h
+ * Frame-timing captures and their analysis, an objective measure of how
+ * smooth the animations are. With --capture the send loop writes a
+ * record for each frame it has shown: when the transfers were over, the
+ * number of the frame and how many frame periods it is meant to last.
+ * --analyze reads a capture and prints as JSON:
+ *     frames        records in the capture
+ *     period_us     the frame period of the device
+ *     interval_us   p50, p99 & max of the interval between frames, per
+ *                   frame period
+ *     drift_us      how much longer the capture took than its frames
+ *                   should have, drift_ppm is the same per million
+ *     loop_ms       a pass of the animation until both groups start
+ *                   over, as SPEED_RANGE made it (intended) and as it
+ *                   was shown (measured)
+ *     dropped       frames skipped, e.g. by --sync when it was late
+ *     duplicated    frames shown again
+ *
+ * The send loop only copies the records to a ring allocated by
+ * capture_open; after capture_start the thread of reporter.h writes them
+ * to the file, before it they are written when the ring is full. Records
+ * that find the ring full while the thread lags behind are lost, and
+ * the user is told so.
+ *
+ * The capture is the header followed by the records, the numbers are in
+ * the byte order of the machine that wrote it.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#ifndef CAPTURE_SENTRY
+#define CAPTURE_SENTRY
+
+#include <stdio.h> /* for FILE */
+#include <stdint.h> /* for fixed-size fields of the capture */
+
+/* Constants */
+#define CAPTURE_MAGIC "QCAP"
+#define CAPTURE_VERSION 1
+#define CAPTURE_RING 1024 /* records, several ticks of the reporter */
+
+/* Messages */
+#define CAPTURE_OPEN_ERR_MSG _("Couldn't open the capture file %s\n")
+#define CAPTURE_WRITE_ERR_MSG _("Couldn't write the capture to %s\n")
+#define CAPTURE_FORMAT_ERR_MSG _("%s: not a capture of version %d\n")
+#define CAPTURE_EMPTY_ERR_MSG _("%s: fewer than 2 frames captured\n")
+#define CAPTURE_LOST_MSG _("%s: %lu frames weren't captured, " \
+                           "the file was written too slowly\n")
+
+enum capture_exitcodes { captureerr = 10 }; /* exitcode, after batcherr */
+
+/* Types */
+struct capture_header {
+    char magic[4];
+    uint16_t version;
+    uint16_t pid;
+    uint32_t period;       /* microsec */
+    uint32_t loop;         /* frames until both groups start over */
+};
+
+struct capture_rec {
+    uint64_t stamp;        /* CLOCK_MONOTONIC, nanosec */
+    uint64_t frame;
+    uint32_t periods;      /* the frame is meant to last */
+    uint32_t pad;
+};
+
+struct capture {
+    FILE *f;               /* NULL - nothing is captured */
+    const char *path;
+    struct capture_rec *ring;
+    unsigned int head, tail; /* added & written, they only go up */
+    unsigned long lost;    /* records that found the ring full */
+    int drained;           /* the reporter writes the ring */
+};
+
+/* Functions */
+int capture_open(struct capture *cap, const char *path, unsigned short pid,
+                                                     unsigned long loop);
+void capture_start(struct capture *cap);
+void capture_add(struct capture *cap, unsigned long long stamp,
+                 unsigned long long frame, unsigned int periods);
+void capture_close(struct capture *cap);
+int capture_analyze(const char *path);
+
+#endif
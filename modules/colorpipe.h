@@ -0,0 +1,61 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File colorpipe.h
+ * Perceptual color pipeline. Colors are decoded from sRGB to linear
+ * light with a lookup table, gradients and brightness are computed
+ * there with 16-bit precision, and the result is scaled by the white
+ * balance gains of -w into the (linear) PWM values of the LEDs.
+ * The hot path is lookups and integer math only.
+ * Optional temporal dithering keeps what is lost by rounding to 8 bits
+ * and carries it over to the next frame of the same LED, so the average
+ * over a few frames has sub-LSB precision.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#ifndef COLORPIPE_SENTRY
+#define COLORPIPE_SENTRY
+
+/* Constants */
+#define LIN_MAX 65535 /* linear light of a fully lit channel */
+#define WB_NEUTRAL 0xffffff /* white balance gains that change nothing */
+#define DITHER_FRAMES 16 /* frames for still colors to average over */
+
+/* Types */
+struct colorpipe {
+    unsigned int scale[3]; /* brightness & white balance, 0 to LIN_MAX */
+    int dither;
+};
+
+struct dither {
+    unsigned int err[3]; /* the carried part of an LSB, 0 to LIN_MAX-1 */
+};
+
+/* Functions */
+void colorpipe_init(struct colorpipe *pipe, int br, int wb, int dither);
+unsigned int colorpipe_gain(int br);
+void colorpipe_decode(int color, unsigned short *lin);
+int colorpipe_encode(const struct colorpipe *pipe, const unsigned short *lin);
+void dither_init(struct dither *d, unsigned int led);
+int colorpipe_encode_dither(const struct colorpipe *pipe,
+                            const unsigned short *lin, struct dither *d);
+
+#endif
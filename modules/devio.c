@@ -26,14 +26,29 @@
 #include <unistd.h> /* for usleep */
 #include <fcntl.h> /* for daemonization */
 #include <signal.h> /* for signal handling */
+#include <time.h> /* for clock_gettime */
+#include <poll.h> /* for waiting on the batch input & held frames */
 
 #include "locale_macros.h"
 
 #include "devio.h"
+#include "scene.h"
+#include "ledmap.h"
+#include "usbfind.h"
+#include "service.h"
+#include "frameclock.h"
+#include "framestream.h"
+#include "rtprofile.h"
+#include "reporter.h"
 
 /* Constants */
-#define DISPLAY_MODE_SLEEP_TIME 55*1000 /* microsec */
-#define QS2S_DISPLAY_SLEEP_TIME 700 /* microsec */
+#define QS2S_REFRESH_FRAMES 200 /* resend still frames about every second */
+/* Retry policy */
+#define XFER_RETRIES 3 /* more attempts after an error that may pass */
+#define XFER_RETRY_DELAY (20*1000) /* microsec, doubles with each attempt */
+#define REOPEN_TRIES 30 /* attempts to get a lost microphone back */
+#define REOPEN_DELAY (1000*1000) /* microsec between them */
+#define WAIT_POLL_TIME 1000 /* millisec, how often waiting checks signals */
 
 #define DEV_EPOUT 0x00 /* control endpoint OUT */
 #define DEV_EPIN 0x80 /* control endpoint IN */
@@ -48,9 +63,6 @@
 #define DISPLAY_CODE 0xf2
 #define PACKET_CNT 0x01
 
-#define INTR_EP_IN 0x82
-#define INTR_LENGTH 8
-
 #define QS2S_RESPONSE_CODE 0xff
 
 #define TIMEOUT 1000 /* one second per packet */
@@ -76,71 +88,88 @@
                                                        "endpoint 0x%02x: %s\n")
 #define INTERRUPT_RSP_ERR_MSG _("USB Interrupt response error on " \
                                                        "endpoint 0x%02x: %s\n")
+#define RETRY_MSG _("Transfer error: %s. Retrying.\n")
+#define RECOVER_MSG _("Lost the microphone, trying to open it again.\n")
 #define PID_MSG _("Started with pid %d\n")
-/* Error codes */
-enum {
-    libusberr = 2,
-    nodeverr,
-    devopenerr,
-    transfererr
-};
 
-/* For open_mic */
-#define FREE_AND_EXIT() \
-    libusb_free_device_list(devs, 1); \
-    libusb_exit(NULL); \
-    exit(libusberr)
-
-#define HANDLE_ERR(CONDITION, MSG) \
-    if(CONDITION) { \
-        fprintf(stderr, MSG); \
-        FREE_AND_EXIT(); \
-    }
-/* For send_packets */
-#define HANDLE_TRANSFER_ERR(ERRCODE) \
-    if(ERRCODE) { \
-        fprintf(stderr, TRANSFER_ERR_MSG); \
-        libusb_close(handle); \
-        libusb_exit(NULL); \
-        free(data_arr); \
-        exit(transfererr); \
-    }
-
-/* Vendor IDs */
-#define DEV_VID_KINGSTON      0x0951
-#define DEV_VID_HP            0x03f0
-/* Product IDs */
-const unsigned short product_ids_kingston[] = {
-    0x171f
-};
-const unsigned short product_ids_hp[] = {
-    0x0f8b,
-    0x028c,
-    0x048c,
-    0x068c,
-    0x098c,         /* Duocast */
-    0x09af,         /* Quadcast 2 */
-    QUADCAST_2S_PID /* Quadcast 2S */
+/* Transfer errors besides the ones of libusb, which are negative */
+enum xfer_errors { xfer_short = 1, xfer_mismatch };
+
+#ifdef DEBUG
+/* Fault injection to test the error paths: QUADCASTRGB_FAULT=KIND[:N]
+ * spoils every Nth transfer (FAULT_EVERY by default). KIND is short,
+ * busy, timeout, mismatch (a wrong response of 2S) or nodev; claim makes
+ * the interfaces look busy when the microphone is opened */
+#define FAULT_ENV "QUADCASTRGB_FAULT"
+#define FAULT_EVERY 5
+enum fault_kinds {
+    fault_none, fault_short, fault_busy, fault_timeout, fault_mismatch,
+    fault_nodev, fault_claim
 };
+static int fault_kind(int *every);
+static int fault_next();
+#endif
 
 /* Microphone opening */
 static int claim_dev_interface(libusb_device_handle *handle);
-static libusb_device *dev_search(libusb_device **devs, ssize_t cnt);
+static libusb_device *dev_search(libusb_device **devs, ssize_t cnt,
+                                                         int cache);
+static libusb_device *dev_at_path(libusb_device **devs, ssize_t cnt,
+                                                         const char *path);
 static int is_compatible_mic(libusb_device *dev);
 static void get_dev_vid_pid(libusb_device *dev, unsigned short *vid,
                            unsigned short *pid);
 /* Packet transfer */
-static short send_display_command(byte_t *packet,
-                                  libusb_device_handle *handle);
+static void enter_display_mode(const struct progopts *opts);
+static int show_frame(libusb_device_handle **handle,
+                      struct frame_output *out, const byte_t *frame);
+static int show_or_stream(libusb_device_handle **handle,
+                          struct frame_output *out, const byte_t *frame,
+                          struct frame_stream *fs,
+                          const struct progopts *opts);
+static int send_synced(libusb_device_handle **handle,
+                       struct frame_output *out, const struct frame_seq *seq,
+                       const struct progopts *opts,
+                       struct render_batch *redraw, struct frame_stream *fs);
+static void redraw_passes(struct render_batch *redraw,
+                          const struct frame_seq *seq,
+                          unsigned long long frame, unsigned long long *drawn);
+static int recover_mic(libusb_device_handle **handle,
+                                             struct frame_output *out);
+static int send_display_command(byte_t *packet,
+                                libusb_device_handle *handle);
+static int display_colcommand(libusb_device_handle *handle,
+                              const byte_t *colcommand, byte_t *packet);
 static int qs2s_send_display_command(byte_t *packet,
                                                  libusb_device_handle *handle);
-static void display_data_arr(libusb_device_handle *handle,
-                             const byte_t *colcommand, const byte_t *end);
-static void qs2s_display_data_arr(libusb_device_handle *handle,
-                                          const byte_t *data_arr, int pck_cnt);
+static int qs2s_display_frame(libusb_device_handle *handle,
+                              struct frame_output *out, const byte_t *frame);
+static int qs2s_display_dirty(libusb_device_handle *handle,
+                                                   struct ledframe *lf);
 static int send_interrupt_with_rsp(libusb_device_handle *handle, byte_t *pck,
                                                         byte_t out, byte_t in);
+static int interrupt_with_rsp(libusb_device_handle *handle, byte_t *pck,
+                                                        byte_t out, byte_t in);
 static int qs2s_rsp_check(const byte_t *cmd, const byte_t *rsp);
+static int control_out(libusb_device_handle *handle, byte_t *packet);
+static int interrupt_xfer(libusb_device_handle *handle, byte_t ep,
+                                                           byte_t *buf);
+static int try_again(int errcode, int *attempt);
+static const char *xfer_strerror(int errcode);
+static int input_ready(int fd);
+static void hold_frames(struct frame_output *out, unsigned int held,
+                        int fd, const struct ctl *ctl,
+                        unsigned long long until);
+static void report_governor(struct frame_output *out, unsigned int held);
+static void measure_jitter(struct rt_jitter *jit, unsigned int held,
+                           const struct progopts *opts);
+/* Scenes */
+static int play_scene_step(libusb_device_handle **handle,
+                           const struct scene *sc, unsigned int step_num,
+                           byte_t *last, struct frame_output *out,
+                           struct frame_stream *fs,
+                           const struct progopts *opts);
+static long long monotonic_ms();
 #if !defined(DEBUG) && !defined(OS_MAC)
 static void daemonize(int verbose);
 #endif
@@ -158,34 +187,93 @@ static void nonstop_reset_handler(int s)
 }
 
 /* Functions */
-libusb_device_handle *open_mic(unsigned short *pid)
+/* Opens the microphone with the default libusb context, which is
+ * initialized here. Returns 0 or an exitcode */
+int open_mic(libusb_device_handle **handle, unsigned short *pid)
 {
-    libusb_device **devs;
-    libusb_device *mic_dev = NULL;
-    libusb_device_handle *handle;
-    ssize_t dev_count;
-    short errcode;
+    int errcode;
     errcode = libusb_init(NULL);
     if(errcode) {
         perror("libusb_init");
-        exit(libusberr);
+        return libusberr;
+    }
+    errcode = open_mic_ctx(NULL, handle, pid, 1);
+    if(errcode) {
+        libusb_exit(NULL);
+        *handle = NULL;
+    }
+    return errcode;
+}
+
+/* Opens the first compatible microphone of an initialized libusb context,
+ * NULL stands for the default one. With cache the port of the last one
+ * is tried first and kept in the cache of the user (see usbcache_load).
+ * Returns 0 or an exitcode */
+int open_mic_ctx(libusb_context *ctx, libusb_device_handle **handle,
+                                           unsigned short *pid, int cache)
+{
+    libusb_device **devs;
+    libusb_device *mic_dev = NULL;
+    char path[USBPATH_LEN], cached[USBPATH_LEN];
+    ssize_t dev_count;
+    int errcode;
+    dev_count = libusb_get_device_list(ctx, &devs);
+    if(dev_count < 0) {
+        fprintf(stderr, DEVLIST_ERR_MSG);
+        return libusberr;
+    }
+    mic_dev = dev_search(devs, dev_count, cache);
+    if(!mic_dev) {
+        fprintf(stderr, NODEV_ERR_MSG);
+        libusb_free_device_list(devs, 1);
+        return nodeverr;
     }
-    dev_count = libusb_get_device_list(NULL, &devs);
-    HANDLE_ERR(dev_count < 0, DEVLIST_ERR_MSG);
-    mic_dev = dev_search(devs, dev_count);
-    HANDLE_ERR(!mic_dev, NODEV_ERR_MSG);
     get_dev_vid_pid(mic_dev, NULL, pid);
-    errcode = libusb_open(mic_dev, &handle);
+    usbpath_of(mic_dev, path);
+    errcode = libusb_open(mic_dev, handle); /* keeps its own reference */
+    libusb_free_device_list(devs, 1);
     if(errcode) {
         fprintf(stderr, "%s\n%s", libusb_strerror(errcode), OPEN_ERR_MSG);
-        FREE_AND_EXIT();
+        return devopenerr;
     }
-    errcode = claim_dev_interface(handle);
+    if(claim_dev_interface(*handle)) {
+        libusb_close(*handle);
+        return devopenerr;
+    }
+    if(cache && (usbcache_load(cached) || strcmp(cached, path) != 0))
+        usbcache_save(path);
+    return 0;
+}
+
+/* Closes the handle and opens the microphone anew, it must be the same
+ * model. Returns 0 or an exitcode, the handle is NULL after a failure */
+int reopen_mic(libusb_context *ctx, libusb_device_handle **handle,
+                                            unsigned short pid, int cache)
+{
+    unsigned short new_pid;
+    int errcode;
+    close_mic(*handle);
+    *handle = NULL;
+    errcode = open_mic_ctx(ctx, handle, &new_pid, cache);
     if(errcode) {
-        libusb_close(handle); FREE_AND_EXIT();
+        *handle = NULL;
+        return errcode;
     }
-    libusb_free_device_list(devs, 1);
-    return handle;
+    if(new_pid != pid) {
+        close_mic(*handle);
+        *handle = NULL;
+        return nodeverr;
+    }
+    return 0;
+}
+
+void close_mic(libusb_device_handle *handle)
+{
+    if(!handle)
+        return;
+    libusb_release_interface(handle, 0);
+    libusb_release_interface(handle, 1);
+    libusb_close(handle);
 }
 
 static int claim_dev_interface(libusb_device_handle *handle)
@@ -194,6 +282,10 @@ static int claim_dev_interface(libusb_device_handle *handle)
     libusb_set_auto_detach_kernel_driver(handle, 1); /* might be unsupported */
     errcode0 = libusb_claim_interface(handle, 0);
     errcode1 = libusb_claim_interface(handle, 1);
+    #ifdef DEBUG
+    if(fault_kind(NULL) == fault_claim)
+        errcode0 = LIBUSB_ERROR_BUSY;
+    #endif
     if(errcode0 == LIBUSB_ERROR_BUSY || errcode1 == LIBUSB_ERROR_BUSY) {
         fprintf(stderr, BUSY_ERR_MSG);
         return 1;
@@ -205,44 +297,42 @@ static int claim_dev_interface(libusb_device_handle *handle)
     return 0;
 }
 
-static libusb_device *dev_search(libusb_device **devs, ssize_t cnt)
+/* The cached path goes first, then the one sysfs tells, then all of them */
+static libusb_device *dev_search(libusb_device **devs, ssize_t cnt,
+                                                          int cache)
 {
-    libusb_device **dev;
-    for(dev = devs; dev < devs+cnt; dev++) {
+    char path[USBPATH_LEN];
+    libusb_device **dev, *found = NULL;
+    if(cache && !usbcache_load(path))
+        found = dev_at_path(devs, cnt, path);
+    #ifdef SYSFS_SCAN
+    if(!found && !sysfs_find_mic(path))
+        found = dev_at_path(devs, cnt, path);
+    #endif
+    for(dev = devs; !found && dev < devs+cnt; dev++) {
         if(is_compatible_mic(*dev))
-            return *dev;
+            found = *dev;
     }
-    return NULL;
+    return found;
+}
+
+/* Returns the device at path if it is a compatible microphone */
+static libusb_device *dev_at_path(libusb_device **devs, ssize_t cnt,
+                                                          const char *path)
+{
+    libusb_device *dev;
+    dev = usbpath_find(devs, cnt, path);
+    return dev && is_compatible_mic(dev) ? dev : NULL;
 }
 
 static int is_compatible_mic(libusb_device *dev)
 {
-    int i, arr_size;
-    const unsigned short *product_id_arr;
     unsigned short vid, pid;
     get_dev_vid_pid(dev, &vid, &pid);
-
-    if (vid == DEV_VID_KINGSTON) {
-        product_id_arr = product_ids_kingston;
-        arr_size = sizeof(product_ids_kingston)/sizeof(*product_id_arr);
-    } else if (vid == DEV_VID_HP) {
-        product_id_arr = product_ids_hp;
-        arr_size = sizeof(product_ids_hp)/sizeof(*product_id_arr);
-    } else {
-        return 0;
-    }
-
     #ifdef DEBUG
-    printf("Valid vendor found: %04x\nTrying product ids:\n", vid);
+    printf("Checking the device %04x:%04x\n", vid, pid);
     #endif
-    for (i = 0; i < arr_size; i++) {
-        #ifdef DEBUG
-        printf("\t%04x\n", product_id_arr[i]);
-        #endif
-        if (pid == product_id_arr[i])
-            return 1;
-    }
-    return 0;
+    return mic_is_compatible(vid, pid);
 }
 
 static void get_dev_vid_pid(libusb_device *dev, unsigned short *vid,
@@ -257,31 +347,394 @@ static void get_dev_vid_pid(libusb_device *dev, unsigned short *vid,
         *pid = descr.idProduct;
 }
 
-void send_packets(libusb_device_handle *handle, const datpack *data_arr,
-                  int pck_cnt, int verbose, int pid)
+/* Returns 0 after a signal or transfererr if the microphone is lost.
+ * With redraw, the random colors of data_arr are redrawn after every
+ * pass, so random blink streams endlessly instead of looping. The frames
+ * streamed by the clients of ctl (may be NULL) replace data_arr while
+ * they come */
+int send_packets(libusb_device_handle **handle, const datpack *data_arr,
+                 int pck_cnt, const struct progopts *opts,
+                 const struct colschemes *cs, struct render_batch *redraw,
+                 struct ctl *ctl)
 {
+    struct frame_output out;
+    struct frame_stream fs;
+    struct frame_seq seq;
+    struct rt_jitter jit;
+    byte_t frame_buf[QS_FRAME_SIZE];
+    unsigned long long frame = 0, drawn[2] = { 0, 0 };
+    unsigned int held = 1;
+    int errcode = 0, varies = redraw && render_batch_varies(redraw);
+    unsigned short pid = cs->pid;
+    frame_seq_init(&seq, data_arr, pck_cnt, pid);
+    frame_seq_levels(&seq, cs);
+    frame_output_init(&out, pid);
+    frame_stream_init(&fs, ctl, pid);
+    if(capture_open(&out.cap, opts->capture, pid, seq.period))
+        return captureerr;
+    if(mute_watch_open(&out.mute, opts->muted, pid)) {
+        capture_close(&out.cap);
+        return muteerr;
+    }
+    enter_display_mode(opts);
+    capture_start(&out.cap); /* the reporter runs from now on */
+    /* after daemonize, as the locks of memory don't survive fork */
+    rt_enter(&opts->rt, data_arr, sizeof(*data_arr)*pck_cnt);
+    rt_jitter_init(&jit, FRAME_PERIOD(pid));
+    if(opts->sync) {
+        errcode = send_synced(handle, &out, &seq, opts, redraw, &fs);
+        frame_stream_close(&fs);
+        mute_watch_close(&out.mute);
+        capture_close(&out.cap);
+        return errcode;
+    }
+    governor_init(&out.gov, opts->governor, pid);
+    /* The loop runs until a signal handler resets the variable */
+    while(nonstop && !errcode) {
+        /* streamed frames come at any moment, a ramp changes each one */
+        if(fs.fd < 0 && !dimmer_ramping(&out.dim) &&
+                                         !mute_watch_muted(&out.mute))
+            held = governor_hold(&out.gov, &seq, frame, varies);
+        errcode = show_or_stream(handle, &out,
+                           frame_seq_get(&seq, frame, frame_buf), &fs, opts);
+        measure_jitter(&jit, held, opts);
+        capture_add(&out.cap, frame_clock_now(), frame, held);
+        /* a client of the control socket cuts the hold short */
+        hold_frames(&out, held, -1, ctl, 0);
+        report_governor(&out, held);
+        frame += held;
+        held = 1;
+        redraw_passes(redraw, &seq, frame, drawn);
+    }
+    frame_stream_close(&fs);
+    mute_watch_close(&out.mute);
+    capture_close(&out.cap);
+    return errcode;
+}
+
+/* The groups of Quadcast S loop on their own, so each is redrawn when it
+ * starts a pass; drawn keeps the passes of the groups drawn so far */
+static void redraw_passes(struct render_batch *redraw,
+                          const struct frame_seq *seq,
+                          unsigned long long frame, unsigned long long *drawn)
+{
+    unsigned long long pass;
+    int g;
+    for(g = 0; redraw && g < (seq->lower ? 2 : 1); g++) {
+        pass = frame / seq->len[g];
+        if(pass != drawn[g])
+            render_batch_redraw(redraw, seq->lower ? (g ? lower : upper) :
+                                                  all, pass - drawn[g]);
+        drawn[g] = pass;
+    }
+}
+
+/* Shows the frame a client streams (see framestream.h) instead of frame
+ * when there is one */
+static int show_or_stream(libusb_device_handle **handle,
+                          struct frame_output *out, const byte_t *frame,
+                          struct frame_stream *fs,
+                          const struct progopts *opts)
+{
+    const byte_t *streamed;
+    struct report r;
+    int errcode;
+    streamed = frame_stream_poll(fs, opts->verbose);
+    if(fs->ctl && fs->ctl->dim_cnt != out->dim_cnt) { /* a dim command */
+        /* the level of an earlier microphone is taken at once */
+        dimmer_set(&out->dim, fs->ctl->dim,
+                              out->dim_cnt ? fs->ctl->dim_ramp : 0);
+        out->dim_cnt = fs->ctl->dim_cnt;
+    }
+    errcode = show_frame(handle, out, streamed ? streamed : frame);
+    if(streamed)
+        frame_stream_shown(fs, out->sent);
+    if(frame_stream_report(fs, &r))
+        reporter_post(&r);
+    return errcode;
+}
+
+/* Shows the frames the master clock tells (see frameclock.h) instead of
+ * one after another. The random colors are drawn for each pass that has
+ * gone by, so the instances with the same seed show the same colors */
+static int send_synced(libusb_device_handle **handle,
+                       struct frame_output *out, const struct frame_seq *seq,
+                       const struct progopts *opts,
+                       struct render_batch *redraw, struct frame_stream *fs)
+{
+    struct frame_clock clk;
+    byte_t frame_buf[QS_FRAME_SIZE];
+    unsigned long long frame, drawn[2] = { 0, 0 };
+    struct report r;
+    int errcode = 0;
+    frame_clock_init(&clk, FRAME_PERIOD(out->pid));
+    out->paced = 1;
+    while(nonstop && !errcode) {
+        frame = frame_clock_next(&clk);
+        redraw_passes(redraw, seq, frame, drawn);
+        frame_clock_wait(&clk, frame);
+        errcode = show_or_stream(handle, out,
+                            frame_seq_get(seq, frame, frame_buf), fs, opts);
+        frame_clock_done(&clk, frame);
+        capture_add(&out->cap, frame_clock_now(), frame, 1);
+        if(frame_clock_report(&clk, &r))
+            reporter_post(&r);
+    }
+    return errcode;
+}
+
+/* Shows the frames of seq from *frame on, at most cnt of them (0 - no
+ * limit), and stops before a frame once until has passed (see
+ * frame_clock_now, 0 - never) or fd has something to read (-1 - never).
+ * *frame is where to go on from then. Returns 0 or transfererr */
+int send_frames(libusb_device_handle **handle, struct frame_output *out,
+                const struct frame_seq *seq, struct render_batch *redraw,
+                unsigned long long *frame, unsigned long long cnt,
+                unsigned long long until, int fd,
+                const struct progopts *opts)
+{
+    byte_t frame_buf[QS_FRAME_SIZE];
+    unsigned long long shown, drawn[2];
+    unsigned int held;
+    int errcode = 0, varies = redraw && render_batch_varies(redraw);
+    enter_display_mode(opts);
+    drawn[0] = *frame / seq->len[0];
+    drawn[1] = *frame / seq->len[1];
+    for(shown = 0; nonstop && !errcode && (!cnt || shown < cnt);
+                                                         shown += held) {
+        if((until && frame_clock_now() >= until) || input_ready(fd))
+            break;
+        redraw_passes(redraw, seq, *frame, drawn);
+        held = mute_watch_muted(&out->mute) ? 1 :
+                           governor_hold(&out->gov, seq, *frame, varies);
+        if(cnt && held > cnt - shown)
+            held = cnt - shown;
+        errcode = show_frame(handle, out, frame_seq_get(seq, *frame,
+                                                           frame_buf));
+        hold_frames(out, held, fd, NULL, until);
+        report_governor(out, held);
+        *frame += held;
+    }
+    return errcode;
+}
+
+/* Shows the blends of the frames of the sequences until xf->end, at most
+ * cnt of them (0 - no limit). The weight of the new one follows the clock
+ * from xf->start on, so the fade takes its time whatever the device does.
+ * Returns 0 or transfererr */
+int send_crossfade(libusb_device_handle **handle, struct frame_output *out,
+                   struct crossfade *xf, unsigned long long cnt,
+                   const struct progopts *opts)
+{
+    byte_t bufs[2][QS_FRAME_SIZE], blend[QS2S_FRAME_SIZE];
+    const byte_t *frames[2];
+    unsigned long long now, shown, drawn[2][2];
+    int i, errcode = 0;
+    enter_display_mode(opts);
+    for(i = 0; i < 2; i++) {
+        drawn[i][0] = xf->frame[i] / xf->seq[i]->len[0];
+        drawn[i][1] = xf->frame[i] / xf->seq[i]->len[1];
+    }
+    for(shown = 0; nonstop && !errcode && (!cnt || shown < cnt); shown++) {
+        now = frame_clock_now();
+        if(now >= xf->end)
+            break;
+        for(i = 0; i < 2; i++) {
+            redraw_passes(xf->redraw[i], xf->seq[i], xf->frame[i],
+                                                              drawn[i]);
+            frames[i] = frame_seq_get(xf->seq[i], xf->frame[i], bufs[i]);
+            xf->frame[i]++;
+        }
+        frame_blend(frames[0], frames[1], now <= xf->start ? 0 :
+                    (now - xf->start) * FRAME_BLEND_ONE /
+                    (xf->end - xf->start), blend, out->pid);
+        errcode = show_frame(handle, out, blend);
+    }
+    return errcode;
+}
+
+/* After a signal the frames are no longer shown */
+int is_stopped(void)
+{
+    return !nonstop;
+}
+
+/* Sleeps through the frames held after the one shown, the wait ends
+ * early once fd or a client of ctl (may be NULL) has something to read,
+ * until has passed (see send_frames) or the mute button was pressed */
+static void hold_frames(struct frame_output *out, unsigned int held,
+                        int fd, const struct ctl *ctl,
+                        unsigned long long until)
+{
+    unsigned long long now, end;
+    struct pollfd pfds[1 + CTL_MAX_POLLFDS + MUTE_MAX_POLLFDS];
+    int cnt, in_cnt = 1, i;
+    if(held < 2)
+        return;
+    out->idle += held - 1; /* the 2S still gets its refresh on time */
+    now = frame_clock_now();
+    end = now + (unsigned long long)(held - 1)*FRAME_PERIOD(out->pid)*1000;
+    if(until && until < end)
+        end = until;
+    pfds[0].fd = fd; /* ignored by poll if negative */
+    pfds[0].events = POLLIN;
+    pfds[0].revents = 0;
+    if(ctl)
+        in_cnt += ctl_pollfds(ctl, pfds + 1, CTL_MAX_POLLFDS);
+    /* libusb wakes it for any of its events, not only for a report */
+    while(now < end) {
+        cnt = mute_watch_pollfds(&out->mute, pfds + in_cnt,
+                                                     MUTE_MAX_POLLFDS);
+        if(poll(pfds, in_cnt + cnt, (end - now) / 1000000) <= 0 ||
+                                           mute_watch_changed(&out->mute))
+            return;
+        for(i = 0; i < in_cnt; i++) {
+            if(pfds[i].revents)
+                return;
+        }
+        now = frame_clock_now();
+    }
+}
+
+static void report_governor(struct frame_output *out, unsigned int held)
+{
+    struct report r;
+    governor_woke(&out->gov, held);
+    if(governor_report(&out->gov, out->transfers, &r))
+        reporter_post(&r);
+}
+
+static void measure_jitter(struct rt_jitter *jit, unsigned int held,
+                           const struct progopts *opts)
+{
+    struct report r;
+    if(opts->rt.priority < 0)
+        return;
+    rt_jitter_add(jit, frame_clock_now(), held);
+    if(rt_jitter_report(jit, &r))
+        reporter_post(&r);
+}
+
+static int input_ready(int fd)
+{
+    struct pollfd pfd;
+    if(fd < 0)
+        return 0;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    return poll(&pfd, 1, 0) > 0;
+}
+
+int send_scene(libusb_device_handle **handle, const struct scene *sc,
+                          const struct progopts *opts, struct ctl *ctl)
+{
+    byte_t last[QS2S_FRAME_SIZE]; /* the last shown frame, for fades */
+    struct frame_output out;
+    struct frame_stream fs;
+    struct frame_seq seq;
+    unsigned int loop, step;
+    int errcode = 0;
+
+    memset(last, 0, sizeof(last)); /* the first fade starts from black */
+    frame_output_init(&out, sc->hdr->pid);
+    if(mute_watch_open(&out.mute, opts->muted, sc->hdr->pid))
+        return muteerr;
+    frame_stream_init(&fs, ctl, sc->hdr->pid);
+    enter_display_mode(opts);
+    if(opts->sync && sc->hdr->step_cnt == 1 &&
+       sc->steps->type == step_play && !sc->steps->duration) { /* restore */
+        frame_seq_whole(&seq, scene_frame(sc, sc->steps, 0),
+                        sc->steps->frame_cnt, sc->hdr->pid);
+        errcode = send_synced(handle, &out, &seq, opts, NULL, &fs);
+        frame_stream_close(&fs);
+        mute_watch_close(&out.mute);
+        return errcode;
+    }
+    for(loop = 0; nonstop && (!sc->hdr->loop || loop < sc->hdr->loop);
+                                                                   loop++) {
+        for(step = 0; step < sc->hdr->step_cnt && nonstop && !errcode;
+                                                                   step++)
+            errcode = play_scene_step(handle, sc, step, last, &out, &fs,
+                                                                     opts);
+    }
+    frame_stream_close(&fs);
+    mute_watch_close(&out.mute);
+    return errcode;
+}
+
+/* Waits for a poke of the control socket until a compatible microphone
+ * can be opened. Returns 0 or 1 if the program was stopped meanwhile */
+int wait_mic(libusb_device_handle **handle, unsigned short *pid,
+                           struct ctl *ctl, const struct progopts *opts)
+{
+    enter_display_mode(opts);
+    while(nonstop) {
+        if(!open_mic_ctx(NULL, handle, pid, 1))
+            return 0;
+        *handle = NULL;
+        service_notify("STATUS=Waiting for the microphone");
+        while(nonstop && ctl_wait(ctl, WAIT_POLL_TIME) != cmd_poke)
+            ;
+    }
+    return 1;
+}
+
+/* Does its job once, a resident instance enters it again and again */
+static void enter_display_mode(const struct progopts *opts)
+{
+    static int entered = 0;
+    if(entered)
+        return;
     #ifdef DEBUG
     puts("Entering display mode...");
     #endif
     #if !defined(DEBUG) && !defined(OS_MAC)
-    daemonize(verbose);
+    if(!opts->foreground)
+        daemonize(opts->verbose);
     #endif
 
     signal(SIGINT, nonstop_reset_handler);
     signal(SIGTERM, nonstop_reset_handler);
+    if(opts->duration) {
+        signal(SIGALRM, nonstop_reset_handler);
+        alarm(opts->duration);
+    }
 
-    /* The loop runs until a signal handler resets the variable */
     nonstop = 1; /* set to 1 only here */
-    if(pid == QUADCAST_2S_PID) {
-        while(nonstop)
-            qs2s_display_data_arr(handle, *data_arr, pck_cnt);
-    } else {
-        short command_cnt;
-        command_cnt = count_color_commands(data_arr, pck_cnt, 0);
-        while(nonstop)
-            display_data_arr(handle, *data_arr,
-                                            *data_arr+2*BYTE_STEP*command_cnt);
+    entered = 1;
+    service_notify("READY=1");
+    reporter_start(opts->verbose); /* after the fork, see reporter.h */
+}
+
+/* Shows a frame, or the muted one when the microphone is muted; a
+ * microphone that stops responding is opened again */
+static int show_frame(libusb_device_handle **handle,
+                      struct frame_output *out, const byte_t *frame)
+{
+    frame = mute_watch_frame(&out->mute, *handle, frame);
+    if(!display_frame(*handle, out, frame)) {
+        out->reopens = 0;
+        return 0;
+    }
+    return recover_mic(handle, out);
+}
+
+static int recover_mic(libusb_device_handle **handle,
+                                              struct frame_output *out)
+{
+    fputs(RECOVER_MSG, stderr);
+    mute_watch_stop(&out->mute); /* before its handle is closed */
+    while(out->reopens < REOPEN_TRIES && nonstop) {
+        out->reopens++;
+        if(!reopen_mic(NULL, handle, out->pid, 1)) {
+            out->shown.dirty = QS2S_ALL_DIRTY; /* the device forgot it all */
+            mute_watch_start(&out->mute, *handle);
+            return 0;
+        }
+        usleep(REOPEN_DELAY);
     }
+    fputs(TRANSFER_ERR_MSG, stderr);
+    return transfererr;
 }
 
 #if !defined(DEBUG) && !defined(OS_MAC)
@@ -310,52 +763,97 @@ static void daemonize(int verbose)
 }
 #endif
 
-static void display_data_arr(libusb_device_handle *handle,
-                             const byte_t *colcommand, const byte_t *end)
+static int display_colcommand(libusb_device_handle *handle,
+                              const byte_t *colcommand, byte_t *packet)
 {
-    short sent;
-    byte_t *packet;
+    int errcode, attempt = 0;
     byte_t header_packet[PACKET_SIZE] = {
         HEADER_CODE, DISPLAY_CODE, 0, 0, 0, 0, 0, 0, PACKET_CNT, 0, 0, 0,
         0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
     };
-    packet = calloc(PACKET_SIZE, 1);
-    while(colcommand < end && nonstop) {
-        sent = send_display_command(header_packet, handle);
-        if(sent != PACKET_SIZE) {
-            nonstop = 0; break; /* finish program in case of any errors */
-        }
-        memcpy(packet, colcommand, 2*BYTE_STEP);
-        sent = libusb_control_transfer(handle, BMREQUEST_TYPE_OUT,
-                   BREQUEST_OUT, WVALUE, WINDEX, packet, PACKET_SIZE, TIMEOUT);
-        if(sent != PACKET_SIZE) {
-            nonstop = 0; break;
-        }
-        #ifdef DEBUG
+    memcpy(packet, colcommand, 2*BYTE_STEP);
+    do { /* the header and the data go together */
+        errcode = send_display_command(header_packet, handle);
+        if(!errcode)
+            errcode = control_out(handle, packet);
+    } while(errcode && try_again(errcode, &attempt));
+    #ifdef DEBUG
+    if(!errcode)
         print_packet(packet, "Data:");
-        #endif
-        colcommand += 2*BYTE_STEP;
-        usleep(DISPLAY_MODE_SLEEP_TIME);
-    }
-    free(packet);
+    #endif
+    return errcode;
 }
 
-static short send_display_command(byte_t *packet, libusb_device_handle *handle)
+static int send_display_command(byte_t *packet, libusb_device_handle *handle)
 {
-    short sent;
-    sent = libusb_control_transfer(handle, BMREQUEST_TYPE_OUT, BREQUEST_OUT,
-                                 WVALUE, WINDEX, packet, PACKET_SIZE,
-                                 TIMEOUT);
+    int errcode;
+    errcode = control_out(handle, packet);
     #ifdef DEBUG
     print_packet(packet, "Header display:");
-    if(sent != PACKET_SIZE)
-        fprintf(stderr, HEADER_ERR_MSG, libusb_strerror(sent));
+    if(errcode)
+        fprintf(stderr, HEADER_ERR_MSG, xfer_strerror(errcode));
     #endif
-    return sent;
+    return errcode;
+}
+
+void frame_output_init(struct frame_output *out, unsigned short pid)
+{
+    out->pid = pid;
+    ledframe_init(&out->shown, out->buf);
+    out->idle = 0;
+    out->reopens = 0;
+    out->paced = 0;
+    out->sent = 0;
+    out->transfers = 0;
+    governor_init(&out->gov, -1, pid);
+    out->cap.f = NULL;
+    dimmer_init(&out->dim);
+    out->dim_cnt = 0;
+    mute_watch_open(&out->mute, NULL, pid); /* nothing to watch yet */
+}
+
+/* Shows a frame of FRAME_SIZE(pid) bytes, it takes one frame period
+ * whatever has changed. Returns 0 or transfererr */
+int display_frame(libusb_device_handle *handle, struct frame_output *out,
+                                                       const byte_t *frame)
+{
+    byte_t packet[PACKET_SIZE], dimmed[QS2S_FRAME_SIZE];
+    frame = dimmer_frame(&out->dim, frame, dimmed, out->pid);
+    if(out->pid == QUADCAST_2S_PID) /* sleeps between packets itself */
+        return qs2s_display_frame(handle, out, frame);
+    memset(packet, 0, PACKET_SIZE);
+    if(display_colcommand(handle, frame, packet))
+        return transfererr;
+    out->transfers += 2; /* the header and the command */
+    out->sent = frame_clock_now();
+    if(!out->paced)
+        usleep(DISPLAY_MODE_SLEEP_TIME);
+    return 0;
+}
+
+static int qs2s_display_frame(libusb_device_handle *handle,
+                               struct frame_output *out, const byte_t *frame)
+{
+    ledframe_load(&out->shown, frame);
+    if(!out->shown.dirty) { /* wait as long as a whole frame would take */
+        if(!out->paced)
+            usleep(QS2S_DISPLAY_SLEEP_TIME*(QS2S_SOLID_PKT_CNT+1));
+        if(++out->idle < QS2S_REFRESH_FRAMES)
+            return 0;
+        out->shown.dirty = QS2S_ALL_DIRTY;
+    }
+    out->idle = 0;
+    /* the header and the packets, each of them with a response */
+    out->transfers += 2*(1 + ledframe_dirty_cnt(&out->shown));
+    if(qs2s_display_dirty(handle, &out->shown))
+        return transfererr;
+    out->sent = frame_clock_now();
+    return 0;
 }
 
-static void qs2s_display_data_arr(libusb_device_handle *handle,
-                                           const byte_t *data_arr, int pck_cnt)
+/* Sends only the packets marked dirty, each of them carries its number */
+static int qs2s_display_dirty(libusb_device_handle *handle,
+                                                    struct ledframe *lf)
 {
     int pck = 0, errcode;
     byte_t header_packet[PACKET_SIZE], packet[PACKET_SIZE];
@@ -363,24 +861,25 @@ static void qs2s_display_data_arr(libusb_device_handle *handle,
     memset(header_packet, 0, PACKET_SIZE);
     header_packet[0] = QS2S_DISPLAY_CODE;
     header_packet[1] = QS2S_PACKET_CNT_CODE;
-    header_packet[2] = pck_cnt;
+    header_packet[2] = ledframe_dirty_cnt(lf);
     errcode = qs2s_send_display_command(header_packet, handle);
     usleep(QS2S_DISPLAY_SLEEP_TIME);
 
-    if(errcode)
-        nonstop = 0;
-    for(; pck < pck_cnt && nonstop; pck++) {
-        memcpy(packet, data_arr + pck*DATA_PACKET_SIZE, DATA_PACKET_SIZE);
+    for(; pck < QS2S_SOLID_PKT_CNT && !errcode; pck++) {
+        if(!(lf->dirty & 1 << pck))
+            continue;
+        memcpy(packet, lf->data + pck*DATA_PACKET_SIZE, DATA_PACKET_SIZE);
         errcode = send_interrupt_with_rsp(handle, packet, QS2S_EDP_OUT,
                                                                   QS2S_EDP_IN);
-        if(errcode) {
-            nonstop = 0; break;
-        }
+        if(errcode)
+            break;
+        lf->dirty &= ~(1 << pck);
         #ifdef DEBUG
         print_packet(packet, "Data:");
         #endif
         usleep(QS2S_DISPLAY_SLEEP_TIME);
     }
+    return errcode;
 }
 
 static int qs2s_send_display_command(byte_t *packet,
@@ -398,30 +897,29 @@ static int qs2s_send_display_command(byte_t *packet,
 static int send_interrupt_with_rsp(libusb_device_handle *handle, byte_t *pck,
                                                          byte_t out, byte_t in)
 { /* use in QS2S protocol only */
-    int errcode, o_transferred, i_transferred;
+    int errcode, attempt = 0;
+    do {
+        errcode = interrupt_with_rsp(handle, pck, out, in);
+    } while(errcode && try_again(errcode, &attempt));
+    return errcode;
+}
+
+static int interrupt_with_rsp(libusb_device_handle *handle, byte_t *pck,
+                                                         byte_t out, byte_t in)
+{
+    int errcode;
     byte_t rsp[PACKET_SIZE];
 
-    errcode = libusb_interrupt_transfer(handle, out, pck,
-                                         PACKET_SIZE, &o_transferred, TIMEOUT);
+    errcode = interrupt_xfer(handle, out, pck);
     if(errcode) {
-        fprintf(stderr, INTERRUPT_CMD_ERR_MSG, out, libusb_strerror(errcode));
+        fprintf(stderr, INTERRUPT_CMD_ERR_MSG, out, xfer_strerror(errcode));
         return errcode;
     }
-    if(o_transferred != PACKET_SIZE) {
-        fprintf(stderr, "Short command transfer on EDP %x: %d/%d\n", out,
-                                                   o_transferred, PACKET_SIZE);
-    }
-    errcode = libusb_interrupt_transfer(handle, in, rsp,
-                                         PACKET_SIZE, &i_transferred, TIMEOUT);
+    errcode = interrupt_xfer(handle, in, rsp);
     if(errcode) {
-        fprintf(stderr, INTERRUPT_RSP_ERR_MSG, in, libusb_strerror(errcode));
+        fprintf(stderr, INTERRUPT_RSP_ERR_MSG, in, xfer_strerror(errcode));
         return errcode;
     }
-    if(i_transferred != PACKET_SIZE) {
-        fprintf(stderr, "Short response transfer on EDP %x: %d/%d\n", in,
-                                                   i_transferred, PACKET_SIZE);
-    }
-
     return qs2s_rsp_check(pck, rsp);
 }
 
@@ -430,16 +928,188 @@ static int qs2s_rsp_check(const byte_t *cmd, const byte_t *rsp)
     if (rsp[0] != QS2S_RESPONSE_CODE) {
         fprintf(stderr, "Response code mismatch: %x instead of %x\n", rsp[0],
                                                            QS2S_RESPONSE_CODE);
-        return 1;
+        return xfer_mismatch;
     } else if (rsp[14] != cmd[0]) {
         fprintf(stderr, "Response command mismatch: %x instead of %x\n",
                                                               rsp[14], cmd[0]);
-        return 2;
+        return xfer_mismatch;
     }
     return 0;
 }
 
+/* Both transfer functions return 0, xfer_short or an error of libusb */
+static int control_out(libusb_device_handle *handle, byte_t *packet)
+{
+    int sent;
+    #ifdef DEBUG
+    int fault = fault_next();
+    if(fault == fault_busy)
+        return LIBUSB_ERROR_BUSY;
+    else if(fault == fault_timeout)
+        return LIBUSB_ERROR_TIMEOUT;
+    else if(fault == fault_nodev)
+        return LIBUSB_ERROR_NO_DEVICE;
+    #endif
+    sent = libusb_control_transfer(handle, BMREQUEST_TYPE_OUT, BREQUEST_OUT,
+                                   WVALUE, WINDEX, packet, PACKET_SIZE,
+                                   TIMEOUT);
+    if(sent < 0)
+        return sent;
+    #ifdef DEBUG
+    if(fault == fault_short)
+        sent /= 2;
+    #endif
+    return (sent == PACKET_SIZE) ? 0 : xfer_short;
+}
+
+static int interrupt_xfer(libusb_device_handle *handle, byte_t ep,
+                                                            byte_t *buf)
+{
+    int errcode, transferred;
+    #ifdef DEBUG
+    int fault = fault_next();
+    if(fault == fault_busy)
+        return LIBUSB_ERROR_BUSY;
+    else if(fault == fault_timeout)
+        return LIBUSB_ERROR_TIMEOUT;
+    else if(fault == fault_nodev)
+        return LIBUSB_ERROR_NO_DEVICE;
+    #endif
+    errcode = libusb_interrupt_transfer(handle, ep, buf, PACKET_SIZE,
+                                                     &transferred, TIMEOUT);
+    if(errcode == LIBUSB_ERROR_PIPE) /* a stalled endpoint, for the retry */
+        libusb_clear_halt(handle, ep);
+    if(errcode)
+        return errcode;
+    #ifdef DEBUG
+    if(fault == fault_short)
+        transferred /= 2;
+    else if(fault == fault_mismatch && (ep & LIBUSB_ENDPOINT_IN))
+        buf[0] = 0; /* anything but QS2S_RESPONSE_CODE */
+    #endif
+    return (transferred == PACKET_SIZE) ? 0 : xfer_short;
+}
+
+/* Waits before the next attempt if the error may pass by itself */
+static int try_again(int errcode, int *attempt)
+{
+    struct report r;
+    switch(errcode) {
+    case LIBUSB_ERROR_NO_DEVICE:
+    case LIBUSB_ERROR_NOT_FOUND:
+    case LIBUSB_ERROR_ACCESS:
+    case LIBUSB_ERROR_NO_MEM:
+        return 0;
+    }
+    if(*attempt == XFER_RETRIES)
+        return 0;
+    report_init(&r, RETRY_MSG);
+    r.str = xfer_strerror(errcode);
+    r.warn = 1;
+    reporter_post(&r);
+    usleep(XFER_RETRY_DELAY << *attempt);
+    (*attempt)++;
+    return 1;
+}
+
+static const char *xfer_strerror(int errcode)
+{
+    if(errcode == xfer_short)
+        return "Short transfer";
+    else if(errcode == xfer_mismatch)
+        return "Response mismatch";
+    return libusb_strerror(errcode);
+}
+
+static int play_scene_step(libusb_device_handle **handle,
+                           const struct scene *sc, unsigned int step_num,
+                           byte_t *last, struct frame_output *out,
+                           struct frame_stream *fs,
+                           const struct progopts *opts)
+{
+    int errcode = 0;
+    const struct scene_step *st, *next;
+    const byte_t *frame;
+    byte_t blend[QS2S_FRAME_SIZE];
+    long long start, elapsed;
+    unsigned int frame_num;
+
+    st = sc->steps + step_num;
+    next = sc->steps + (step_num+1) % sc->hdr->step_cnt;
+    if(st->type == step_fade && st->duration == 0)
+        return 0;
+    frame = last;
+    start = monotonic_ms();
+    elapsed = 0;
+    /* Each frame costs the same no matter how long the scene is */
+    for(frame_num = 0; nonstop && !errcode; frame_num++) {
+        if(st->type == step_fade) {
+            scene_blend(sc, last, scene_frame(sc, next, 0), elapsed,
+                                                         st->duration, blend);
+            frame = blend;
+        } else {
+            frame = scene_frame(sc, st, frame_num);
+        }
+        errcode = show_or_stream(handle, out, frame, fs, opts);
+        elapsed = monotonic_ms() - start;
+        if(st->duration && elapsed >= st->duration)
+            break;
+    }
+    if(frame != last)
+        memcpy(last, frame, sc->hdr->frame_size);
+    return errcode;
+}
+
+static long long monotonic_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec*1000 + ts.tv_nsec/1000000;
+}
+
 #ifdef DEBUG
+/* Reads FAULT_ENV once, every may be NULL */
+static int fault_kind(int *every)
+{
+    static const char *names[] = {
+        "", "short", "busy", "timeout", "mismatch", "nodev", "claim", NULL
+    };
+    static int kind = -1, period = FAULT_EVERY;
+    if(kind == -1) {
+        const char *env = getenv(FAULT_ENV), *colon;
+        size_t len;
+        kind = fault_none;
+        if(env) {
+            colon = strchr(env, ':');
+            len = colon ? (size_t)(colon - env) : strlen(env);
+            for(kind = fault_short; names[kind]; kind++) {
+                if(strlen(names[kind]) == len &&
+                                           !strncmp(env, names[kind], len))
+                    break;
+            }
+            if(!names[kind])
+                kind = fault_none;
+            if(colon && atoi(colon+1) > 0)
+                period = atoi(colon+1);
+        }
+    }
+    if(every)
+        *every = period;
+    return kind;
+}
+
+/* Returns the fault to spoil the next transfer with */
+static int fault_next()
+{
+    static unsigned long cnt = 0;
+    int kind, every;
+    kind = fault_kind(&every);
+    if(kind == fault_none || kind == fault_claim)
+        return fault_none;
+    cnt++;
+    return (cnt % every == 0) ? kind : fault_none;
+}
+
 static void print_packet(byte_t *pck, char *str)
 {
     byte_t *p;
@@ -32,16 +32,90 @@
 /* Quadcast 2S protocol */
 #define QS2S_DISPLAY_CODE 0x44
 #define QS2S_PACKET_CNT_CODE 0x01
-#define QS2S_LED_CNT 108
 #define QS2S_SOLID_PKT_CNT 0x06
 
+#ifdef USBFS
+#include "usbfs.h" /* the libusb calls without libusb */
+#else
 #include <libusb-1.0/libusb.h>
-#include "rgbmodes.h" /* for datpack & byte_t types, count_color_pairs, defs */
+#endif
+#include "rgbmodes.h" /* for datpack & byte_t types, struct frame_seq, defs */
+#include "ledmap.h" /* for struct ledframe */
+#include "governor.h"
+#include "capture.h"
+#include "dimmer.h"
+#include "mutewatch.h"
 
 #define QUADCAST_2S_PID 0x02b5 /* for rgbmodes */
+#define FRAME_SIZE(PID) \
+    ((PID) == QUADCAST_2S_PID ? QS2S_FRAME_SIZE : QS_FRAME_SIZE)
+#define DISPLAY_MODE_SLEEP_TIME 55*1000 /* microsec */
+#define QS2S_DISPLAY_SLEEP_TIME 700 /* microsec */
+#define FRAME_PERIOD(PID) /* microsec a frame is shown at least */ \
+    ((PID) == QUADCAST_2S_PID ? \
+        QS2S_DISPLAY_SLEEP_TIME*(QS2S_SOLID_PKT_CNT+1) : \
+        DISPLAY_MODE_SLEEP_TIME)
+
+/* Error codes, they are the exitcodes of the program as well */
+enum devio_exitcodes {
+    libusberr = 2,
+    nodeverr,
+    devopenerr,
+    transfererr
+};
+
+/* Types */
+struct frame_output { /* what the device shows, to send only the changes */
+    unsigned short pid;
+    struct ledframe shown;
+    byte_t buf[QS2S_FRAME_SIZE];
+    int idle; /* frames without changes since the last transfer */
+    int reopens; /* times the microphone was reopened, none shown since */
+    int paced; /* the caller keeps the frame period, no sleep after frames */
+    unsigned long long sent; /* when the last transfers were over, nanosec */
+    unsigned long transfers; /* USB transfers so far */
+    struct governor gov; /* off unless the sender turns it on */
+    struct capture cap; /* the frames shown, see capture.h */
+    struct dimmer dim; /* put over the frames as they are sent */
+    unsigned int dim_cnt; /* dim commands of the control socket taken */
+    struct mute_watch mute; /* the mute button, see mutewatch.h */
+};
+
+struct crossfade { /* both sequences go on while one turns into the other */
+    const struct frame_seq *seq[2];     /* from & to */
+    struct render_batch *redraw[2];     /* may be NULL */
+    unsigned long long frame[2];        /* to show next of each */
+    unsigned long long start, end;      /* see frame_clock_now */
+};
+
+struct scene; /* see scene.h */
+struct ctl; /* see service.h */
 
 /* Functions */
-libusb_device_handle *open_mic(unsigned short *pid);
-void send_packets(libusb_device_handle *handle, const datpack *data_arr,
-                  int pck_cnt, int verbose, int vid);
+int open_mic(libusb_device_handle **handle, unsigned short *pid);
+int open_mic_ctx(libusb_context *ctx, libusb_device_handle **handle,
+                                          unsigned short *pid, int cache);
+int reopen_mic(libusb_context *ctx, libusb_device_handle **handle,
+                                           unsigned short pid, int cache);
+void close_mic(libusb_device_handle *handle);
+void frame_output_init(struct frame_output *out, unsigned short pid);
+int display_frame(libusb_device_handle *handle, struct frame_output *out,
+                                                      const byte_t *frame);
+int wait_mic(libusb_device_handle **handle, unsigned short *pid,
+                           struct ctl *ctl, const struct progopts *opts);
+int send_packets(libusb_device_handle **handle, const datpack *data_arr,
+                 int pck_cnt, const struct progopts *opts,
+                 const struct colschemes *cs, struct render_batch *redraw,
+                 struct ctl *ctl);
+int send_scene(libusb_device_handle **handle, const struct scene *sc,
+                          const struct progopts *opts, struct ctl *ctl);
+int send_frames(libusb_device_handle **handle, struct frame_output *out,
+                const struct frame_seq *seq, struct render_batch *redraw,
+                unsigned long long *frame, unsigned long long cnt,
+                unsigned long long until, int fd,
+                const struct progopts *opts);
+int send_crossfade(libusb_device_handle **handle, struct frame_output *out,
+                   struct crossfade *xf, unsigned long long cnt,
+                   const struct progopts *opts);
+int is_stopped(void);
 #endif
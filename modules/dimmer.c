@@ -0,0 +1,125 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File dimmer.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include "devio.h" /* for QUADCAST_2S_PID */
+#include "frameclock.h"
+#include "colorpipe.h"
+#include "dimmer.h"
+
+#define SCALE_FULL 256
+
+static unsigned int scale_at(const struct dimmer *d, unsigned long long now);
+static void swap_lut(struct dimmer *d, unsigned int scale);
+static int is_color_byte(unsigned int i, unsigned short pid);
+
+void dimmer_init(struct dimmer *d)
+{
+    d->cur = -1;
+    d->scale = d->from = d->to = SCALE_FULL;
+    d->start = d->ramp = 0;
+}
+
+/* The ramp starts from where the current one has got to */
+void dimmer_set(struct dimmer *d, int level, unsigned long ramp_ms)
+{
+    unsigned long long now = frame_clock_now();
+    if(level < 0)
+        level = 0;
+    else if(level > DIMMER_FULL)
+        level = DIMMER_FULL;
+    if(ramp_ms > DIMMER_MAX_RAMP)
+        ramp_ms = DIMMER_MAX_RAMP;
+    d->from = scale_at(d, now);
+    d->to = (level*SCALE_FULL + DIMMER_FULL/2) / DIMMER_FULL;
+    d->start = now;
+    d->ramp = (unsigned long long)ramp_ms * 1000000;
+}
+
+int dimmer_ramping(const struct dimmer *d)
+{
+    return d->scale != d->to;
+}
+
+/* Returns frame itself at full brightness, otherwise its dimmed copy made
+ * in buf of FRAME_SIZE(pid) bytes */
+const byte_t *dimmer_frame(struct dimmer *d, const byte_t *frame,
+                           byte_t *buf, unsigned short pid)
+{
+    unsigned int i, scale, size = FRAME_SIZE(pid);
+    const byte_t *lut;
+    scale = d->scale == d->to ? d->to : scale_at(d, frame_clock_now());
+    if(scale != d->scale)
+        swap_lut(d, scale);
+    if(d->cur < 0)
+        return frame;
+    lut = d->luts[d->cur];
+    for(i = 0; i < size; i++)
+        buf[i] = is_color_byte(i, pid) ? lut[frame[i]] : frame[i];
+    return buf;
+}
+
+/* Fills lut with -b level the way plan_colorscheme would build it in: a
+ * cut of the sRGB value, or with gamma the gain of the pipeline over the
+ * linear PWM value (then within 1 LSB of the pipeline's own) */
+void dimmer_level(byte_t *lut, int level, int gamma)
+{
+    unsigned int i, gain = colorpipe_gain(level);
+    for(i = 0; i < 256; i++)
+        lut[i] = gamma ? (i*gain + LIN_MAX/2) / LIN_MAX :
+                         i*level / DIMMER_FULL;
+}
+
+static unsigned int scale_at(const struct dimmer *d, unsigned long long now)
+{
+    unsigned long long done;
+    if(!d->ramp || now >= d->start + d->ramp)
+        return d->to;
+    done = now - d->start;
+    if(d->to > d->from)
+        return d->from + (d->to - d->from) * done / d->ramp;
+    return d->from - (d->from - d->to) * done / d->ramp;
+}
+
+/* The spare table is filled first, then it takes the place of the other */
+static void swap_lut(struct dimmer *d, unsigned int scale)
+{
+    int spare = d->cur == 0;
+    unsigned int i;
+    d->scale = scale;
+    if(scale == SCALE_FULL) {
+        d->cur = -1;
+        return;
+    }
+    for(i = 0; i < 256; i++)
+        d->luts[spare][i] = (i*scale + SCALE_FULL/2) / SCALE_FULL;
+    d->cur = spare;
+}
+
+static int is_color_byte(unsigned int i, unsigned short pid)
+{
+    if(pid == QUADCAST_2S_PID)
+        return i % DATA_PACKET_SIZE >= QS2S_PCT_HEADER;
+    return i % BYTE_STEP != 0; /* skip RGB_CODE */
+}
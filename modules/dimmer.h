@@ -0,0 +1,65 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File dimmer.h
+ * The send-time dimmer. Frames are assembled at full brightness of the
+ * dimmer and it puts a 256-entry table over their color bytes while they
+ * are staged for the transfer, so a change of the level costs one table
+ * and never a new colorscheme. The level may ramp to the new one over a
+ * time: the table then follows the clock frame by frame. A table is
+ * filled before it's put in use, the frames never see a half-made one.
+ *
+ * The -b of each group of Quadcast S is a table of its own too: the
+ * frames of the colorscheme leave it out and frame_seq_get puts it over
+ * the command of the group (see dimmer_level).
+ *
+ * The resident instance takes the level from the clients of the control
+ * socket (the command "dim PERCENT [MS]", see service.h).
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#ifndef DIMMER_SENTRY
+#define DIMMER_SENTRY
+
+#include "rgbmodes.h" /* for byte_t */
+
+/* Constants */
+#define DIMMER_FULL 100 /* percent */
+#define DIMMER_MAX_RAMP 3600000UL /* millisec */
+
+/* Types */
+struct dimmer {
+    byte_t luts[2][256];
+    int cur;                        /* the table in use, -1 - none */
+    unsigned int scale;             /* of the table in use, 0-256 */
+    unsigned int from, to;          /* the scales of the ramp */
+    unsigned long long start, ramp; /* nanosec */
+};
+
+/* Functions */
+void dimmer_init(struct dimmer *d);
+void dimmer_set(struct dimmer *d, int level, unsigned long ramp_ms);
+int dimmer_ramping(const struct dimmer *d);
+const byte_t *dimmer_frame(struct dimmer *d, const byte_t *frame,
+                           byte_t *buf, unsigned short pid);
+void dimmer_level(byte_t *lut, int level, int gamma);
+
+#endif
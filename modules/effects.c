@@ -0,0 +1,221 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File effects.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include "prng.h"
+#include "rgbmodes.h" /* for SPEED_RANGE */
+#include "modereg.h"
+#include "effects.h"
+
+#define NOISE_OCTAVE_SEED 0x5bd1e995 /* the second octave of fire */
+
+/* A quarter of a sine wave, FX_ONE at the top */
+static const int16_t quarter_sin[65] = {
+    0, 804, 1608, 2410, 3212, 4011, 4808, 5602,
+    6393, 7179, 7962, 8739, 9512, 10278, 11039, 11793,
+    12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+    18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+    23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+    27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+    30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971,
+    32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+    32767
+};
+
+static uint32_t effect_time(const struct effect *fx, unsigned long frame);
+static int breathe_color(const struct effect *fx, uint32_t ms, int led);
+static int noise_color(const struct effect *fx, uint32_t ms, int led);
+static int fire_color(const struct effect *fx, uint32_t ms, int led);
+static int palette_color(const struct effect *fx, unsigned int pos);
+static int scale_color(int color, int level);
+static int fx_sin(uint32_t phase);
+static int table_sin(unsigned int idx);
+static unsigned int value_noise(uint32_t seed, uint32_t x, uint32_t y);
+static unsigned int lattice(uint32_t seed, uint32_t x, uint32_t y);
+static unsigned int fade(unsigned int frac);
+static unsigned int lerp_frac(unsigned int a, unsigned int b,
+                                                 unsigned int frac);
+
+/* Modes, see modereg.h */
+const struct rgb_mode breathe_mode = {
+    "breathe", cap_qs | cap_qs2s, red_colors, NULL, NULL, breathe_color,
+    BREATHE_MIN_MS, BREATHE_MAX_MS
+};
+const struct rgb_mode noise_mode = {
+    "noise", cap_qs | cap_qs2s, rainbow_colors, NULL, NULL, noise_color,
+    NOISE_MIN_MS, NOISE_MAX_MS
+};
+const struct rgb_mode fire_mode = {
+    "fire", cap_qs | cap_qs2s, fire_colors, NULL, NULL, fire_color,
+    FIRE_MIN_MS, FIRE_MAX_MS
+};
+
+/* Functions */
+/* Effects of the same seed and stream look the same */
+void effect_init(struct effect *fx, const struct colscheme *colsch,
+             unsigned long seed, unsigned int stream, unsigned long frame_us)
+{
+    const struct rgb_mode *md = colsch->mode;
+    struct prng rng;
+    fx->step = md->step;
+    for(fx->color_cnt = 0; fx->color_cnt < COLORS_CNT-1 &&
+                  colsch->colors[fx->color_cnt] != nocolor; fx->color_cnt++)
+        fx->colors[fx->color_cnt] = colsch->colors[fx->color_cnt];
+    if(!fx->color_cnt)
+        fx->colors[fx->color_cnt++] = red;
+    fx->period_ms = SPEED_RANGE(md->min_ms, md->max_ms, colsch->spd);
+    fx->frame_us = frame_us;
+    prng_seed(&rng, seed, stream);
+    fx->seed = prng_next(&rng);
+}
+
+int effect_color(const struct effect *fx, unsigned long frame, int led)
+{
+    if(!fx->step)
+        return black;
+    return fx->step(fx, effect_time(fx, frame), led);
+}
+
+/* Wraps around after about 50 days, the noise just jumps then */
+static uint32_t effect_time(const struct effect *fx, unsigned long frame)
+{
+    return (uint32_t)((uint64_t)frame * fx->frame_us / 1000);
+}
+
+/* The same for every LED */
+static int breathe_color(const struct effect *fx, uint32_t ms, int led)
+{
+    uint32_t breath = ms / fx->period_ms, phase;
+    int level;
+    phase = (uint32_t)((uint64_t)(ms % fx->period_ms) * FX_TURN /
+                                                          fx->period_ms);
+    /* 1 - cos, dark at the beginning & the end of a breath */
+    level = (FX_ONE - fx_sin(phase + FX_TURN/4)) / 2;
+    return scale_color(fx->colors[breath % fx->color_cnt], level);
+}
+
+static int noise_color(const struct effect *fx, uint32_t ms, int led)
+{
+    uint32_t x, y;
+    x = (uint32_t)led * 256 / NOISE_LED_CELL;
+    y = (uint32_t)((uint64_t)ms * 256 / fx->period_ms);
+    return palette_color(fx, value_noise(fx->seed, x, y));
+}
+
+static int fire_color(const struct effect *fx, uint32_t ms, int led)
+{
+    uint32_t x, y;
+    unsigned int heat;
+    x = (uint32_t)led * 256 / FIRE_LED_CELL;
+    y = (uint32_t)((uint64_t)ms * 256 / fx->period_ms);
+    heat = (2*value_noise(fx->seed, x, y) +
+            value_noise(fx->seed ^ NOISE_OCTAVE_SEED, 2*x, 2*y)) / 3;
+    heat = heat*heat / 65535; /* mostly dim with bright flares */
+    return palette_color(fx, heat);
+}
+
+/* pos from 0 (the first color) to 65535 (the last one), a single color
+ * is dimmed instead */
+static int palette_color(const struct effect *fx, unsigned int pos)
+{
+    unsigned int seg, frac;
+    int shift, color = 0;
+    if(fx->color_cnt < 2)
+        return scale_color(fx->colors[0], pos/2);
+    pos *= fx->color_cnt - 1;
+    seg = pos >> 16;
+    frac = (pos >> 8) & 0xff;
+    if(seg >= (unsigned int)fx->color_cnt - 1)
+        return fx->colors[fx->color_cnt-1];
+    for(shift = 16; shift >= 0; shift -= 8) {
+        color |= lerp_frac((fx->colors[seg] >> shift) & 0xff,
+                          (fx->colors[seg+1] >> shift) & 0xff, frac) << shift;
+    }
+    return color;
+}
+
+static int scale_color(int color, int level)
+{
+    int shift, res = 0;
+    for(shift = 16; shift >= 0; shift -= 8)
+        res |= (((color >> shift) & 0xff) * level / FX_ONE) << shift;
+    return res;
+}
+
+/* FX_TURN is a whole turn, interpolated between 256 steps */
+static int fx_sin(uint32_t phase)
+{
+    unsigned int idx = (phase >> 8) & 0xff;
+    int a = table_sin(idx), b = table_sin((idx+1) & 0xff);
+    return a + (b - a)*(int)(phase & 0xff)/256;
+}
+
+static int table_sin(unsigned int idx)
+{
+    unsigned int q = idx & 0x3f;
+    switch(idx >> 6) {
+    case 0:
+        return quarter_sin[q];
+    case 1:
+        return quarter_sin[64-q];
+    case 2:
+        return -quarter_sin[q];
+    }
+    return -quarter_sin[64-q];
+}
+
+/* x & y have 8 fractional bits, one is a lattice cell; 0 to 65535 */
+static unsigned int value_noise(uint32_t seed, uint32_t x, uint32_t y)
+{
+    uint32_t ix = x >> 8, iy = y >> 8;
+    unsigned int fx = fade(x & 0xff), fy = fade(y & 0xff), top, bottom;
+    top = lerp_frac(lattice(seed, ix, iy), lattice(seed, ix+1, iy), fx);
+    bottom = lerp_frac(lattice(seed, ix, iy+1), lattice(seed, ix+1, iy+1),
+                                                                      fx);
+    return lerp_frac(top, bottom, fy);
+}
+
+/* The value at a lattice point, 0 to 65535 */
+static unsigned int lattice(uint32_t seed, uint32_t x, uint32_t y)
+{
+    uint32_t h = seed ^ (x * 0x9e3779b1u) ^ (y * 0x85ebca77u);
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h >> 16;
+}
+
+/* Smoothstep of a fraction of 256 */
+static unsigned int fade(unsigned int frac)
+{
+    return frac*frac*(3*256 - 2*frac) >> 16;
+}
+
+static unsigned int lerp_frac(unsigned int a, unsigned int b,
+                                                  unsigned int frac)
+{
+    return (unsigned int)((int)a + ((int)b - (int)a)*(int)frac/256);
+}
@@ -0,0 +1,77 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File effects.h
+ * Procedural effects. The color of an LED is computed from the frame
+ * number and the LED alone, so an effect never repeats, needs no memory
+ * besides its small struct and any frame can be evaluated on its own,
+ * in any order. A color takes a few table lookups, integer multiplies
+ * and hashes, so the work per frame is bounded by the number of LEDs.
+ *     breathe   the colors fade in and out one after another along a
+ *               sine from a table
+ *     noise     smooth value noise drifting over the LEDs in time, put
+ *               onto a gradient through the colors
+ *     fire      two octaves of faster noise, mostly at the dark end of
+ *               the colors with bright flares, like flames
+ * The speed sets the length of a breath or how fast the noise drifts.
+ * Time is the frame number times the frame period of the device, so an
+ * effect looks the same on both microphones. The effects are the modes
+ * that step (see modereg.h), struct effect is all that a step gets.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#ifndef EFFECTS_SENTRY
+#define EFFECTS_SENTRY
+
+#include <stdint.h> /* for the fixed-point math */
+#include "argparser.h" /* for struct colscheme, COLORS_CNT */
+
+/* Constants */
+#define FX_ONE 32767 /* fixed-point 1.0 of levels and the sine */
+#define FX_TURN 65536 /* a whole turn of a phase */
+/* Milliseconds at the lowest & the highest speed */
+#define BREATHE_MAX_MS 8000 /* of a breath */
+#define BREATHE_MIN_MS 1000
+#define NOISE_MAX_MS 6000 /* to drift over a noise cell */
+#define NOISE_MIN_MS 400
+#define FIRE_MAX_MS 500
+#define FIRE_MIN_MS 60
+/* LEDs a noise cell spans */
+#define NOISE_LED_CELL 8
+#define FIRE_LED_CELL 3
+
+/* Types */
+struct effect {
+    /* the step of the mode, NULL for the groups that don't step */
+    int (*step)(const struct effect *fx, uint32_t ms, int led);
+    int colors[COLORS_CNT]; /* the palette */
+    int color_cnt;
+    uint32_t period_ms; /* of a breath or a noise cell */
+    uint32_t frame_us;  /* how long a frame is shown */
+    uint32_t seed;
+};
+
+/* Functions */
+void effect_init(struct effect *fx, const struct colscheme *colsch,
+            unsigned long seed, unsigned int stream, unsigned long frame_us);
+int effect_color(const struct effect *fx, unsigned long frame, int led);
+
+#endif
@@ -0,0 +1,130 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File frameclock.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include <errno.h> /* for EINTR */
+#include <time.h> /* for clock_gettime, clock_nanosleep */
+
+#include "locale_macros.h"
+#include "frameclock.h"
+#include "reporter.h"
+
+#define NSEC_PER_SEC 1000000000ULL
+
+static void sleep_until(unsigned long long ns);
+static void reset_stats(struct frame_clock *clk);
+
+void frame_clock_init(struct frame_clock *clk, unsigned long period_us)
+{
+    clk->period = (unsigned long long)period_us*1000;
+    clk->next = 0;
+    clk->report = 0;
+    reset_stats(clk);
+}
+
+/* Returns the number of the frame to show next: the one after the last
+ * shown frame or, if it's too late for that one, the next to come. The
+ * first frame is the one of the next period boundary */
+unsigned long long frame_clock_next(struct frame_clock *clk)
+{
+    unsigned long long frame;
+    frame = (frame_clock_now() + clk->period - 1) / clk->period;
+    if(!clk->next)
+        clk->report = frame + FRAME_CLOCK_REPORT*NSEC_PER_SEC / clk->period;
+    else if(frame > clk->next)
+        clk->skipped += frame - clk->next;
+    else
+        frame = clk->next;
+    clk->next = frame + 1;
+    return frame;
+}
+
+/* Sleeps until the frame is due */
+void frame_clock_wait(const struct frame_clock *clk, unsigned long long frame)
+{
+    sleep_until(frame * clk->period);
+}
+
+/* Called when the transfers of the frame are over */
+void frame_clock_done(struct frame_clock *clk, unsigned long long frame)
+{
+    unsigned long long now = frame_clock_now(), due = frame * clk->period;
+    clk->skew_last = now > due ? (now - due) / 1000 : 0;
+    if(clk->skew_last > clk->skew_max)
+        clk->skew_max = clk->skew_last;
+    clk->skew_sum += clk->skew_last;
+    clk->frames++;
+}
+
+/* Once in FRAME_CLOCK_REPORT seconds, writes the skew since the last
+ * report to r and returns 1 */
+int frame_clock_report(struct frame_clock *clk, struct report *r)
+{
+    if(!clk->frames || clk->next <= clk->report)
+        return 0;
+    report_init(r, FRAME_CLOCK_REPORT_MSG);
+    r->num[0] = clk->skew_last;
+    r->num[1] = clk->skew_sum / clk->frames;
+    r->num[2] = clk->skew_max;
+    r->num[3] = clk->skipped;
+    r->num[4] = clk->frames + clk->skipped;
+    clk->report = clk->next + FRAME_CLOCK_REPORT*NSEC_PER_SEC / clk->period;
+    reset_stats(clk);
+    return 1;
+}
+
+/* CLOCK_MONOTONIC in nanoseconds */
+unsigned long long frame_clock_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec*NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void sleep_until(unsigned long long ns)
+{
+    struct timespec ts;
+    #ifdef OS_MAC /* no absolute sleep there */
+    unsigned long long now = frame_clock_now();
+    if(ns <= now)
+        return;
+    ns -= now;
+    ts.tv_sec = ns / NSEC_PER_SEC;
+    ts.tv_nsec = ns % NSEC_PER_SEC;
+    nanosleep(&ts, NULL);
+    #else
+    ts.tv_sec = ns / NSEC_PER_SEC;
+    ts.tv_nsec = ns % NSEC_PER_SEC;
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) ==
+                                                                     EINTR)
+        ; /* a signal stops the program after the frame, not before it */
+    #endif
+}
+
+static void reset_stats(struct frame_clock *clk)
+{
+    clk->frames = clk->skipped = 0;
+    clk->skew_last = clk->skew_max = 0;
+    clk->skew_sum = 0;
+}
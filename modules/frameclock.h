@@ -0,0 +1,67 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File frameclock.h
+ * The master clock of synced output. Frame N is due N frame periods
+ * after the origin of CLOCK_MONOTONIC, which is one for every process
+ * on the machine, so microphones driven by separate instances show the
+ * same frame at the same moment without talking to each other. A device
+ * that falls behind skips frames instead of drifting away.
+ * The skew of a frame is how late its transfer was over in comparison
+ * with the moment the frame was due.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#ifndef FRAMECLOCK_SENTRY
+#define FRAMECLOCK_SENTRY
+
+#include <stddef.h> /* for size_t */
+
+/* Constants */
+#define FRAME_CLOCK_REPORT 10 /* seconds between skew reports */
+
+/* Messages */
+#define FRAME_CLOCK_REPORT_MSG _("Skew: last %lu, average %lu, " \
+                                 "max %lu microsec; %lu of %lu frames " \
+                                 "skipped")
+
+/* Types */
+struct report; /* see reporter.h */
+
+struct frame_clock {
+    unsigned long long period; /* nanoseconds */
+    unsigned long long next;   /* the frame due next, 0 - not started */
+    unsigned long long report; /* the frame to report the skew at */
+    /* Since the last report, the skew is in microseconds */
+    unsigned long frames, skipped;
+    unsigned long skew_last, skew_max;
+    unsigned long long skew_sum;
+};
+
+/* Functions */
+void frame_clock_init(struct frame_clock *clk, unsigned long period_us);
+unsigned long long frame_clock_next(struct frame_clock *clk);
+void frame_clock_wait(const struct frame_clock *clk, unsigned long long frame);
+void frame_clock_done(struct frame_clock *clk, unsigned long long frame);
+int frame_clock_report(struct frame_clock *clk, struct report *r);
+unsigned long long frame_clock_now();
+
+#endif
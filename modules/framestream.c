@@ -0,0 +1,209 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File framestream.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include <stdio.h> /* for puts */
+#include <string.h> /* for memset & memcpy */
+#include <errno.h>
+#include <fcntl.h> /* for non-blocking reads */
+#include <unistd.h> /* for read & close */
+
+#include "locale_macros.h"
+#include "service.h"
+#include "frameclock.h" /* for frame_clock_now */
+#include "ledmap.h"
+#include "framestream.h"
+#include "reporter.h"
+
+static int read_messages(struct frame_stream *fs);
+static int bad_header(const struct frame_stream *fs);
+static void message_done(struct frame_stream *fs);
+static void colors_to_frame(const byte_t *colors, unsigned short pid,
+                                                            byte_t *frame);
+static void reset_stats(struct frame_stream *fs);
+
+/* ctl may be NULL, there are no clients then */
+void frame_stream_init(struct frame_stream *fs, struct ctl *ctl,
+                                                     unsigned short pid)
+{
+    fs->ctl = ctl;
+    fs->fd = -1;
+    fs->pid = pid;
+    memset(fs->bufs, 0, sizeof(fs->bufs));
+    fs->filling = fs->ready = fs->fresh = 0;
+    fs->got = 0;
+    fs->stamp = 0;
+    fs->report = frame_clock_now()/1000000 + STREAM_REPORT*1000;
+    reset_stats(fs);
+}
+
+/* Takes a new client and reads what the client has sent. Returns the
+ * frame to show or NULL if the colors of the program are to be shown */
+const byte_t *frame_stream_poll(struct frame_stream *fs, int verbose)
+{
+    int conn;
+    if(fs->ctl && ctl_accept(fs->ctl, 0, &conn) == cmd_stream) {
+        frame_stream_close(fs); /* the new client takes over */
+        fs->fd = conn;
+        fcntl(fs->fd, F_SETFL, fcntl(fs->fd, F_GETFL) | O_NONBLOCK);
+        if(verbose)
+            puts(STREAM_START_MSG);
+    }
+    if(fs->fd < 0)
+        return NULL;
+    if(read_messages(fs)) {
+        frame_stream_close(fs);
+        if(verbose)
+            puts(STREAM_STOP_MSG);
+        return NULL;
+    }
+    return fs->ready ? fs->bufs[!fs->filling] : NULL;
+}
+
+/* Called after the frame given by poll was shown, sent is the time
+ * (see frame_clock_now) its transfers were over */
+void frame_stream_shown(struct frame_stream *fs, unsigned long long sent)
+{
+    if(!fs->fresh)
+        return;
+    fs->fresh = 0;
+    if(fs->stamp && fs->stamp <= sent) {
+        unsigned long lat = (sent - fs->stamp) / 1000;
+        if(lat > fs->lat_max)
+            fs->lat_max = lat;
+        fs->lat_sum += lat;
+        fs->lat_cnt++;
+    }
+}
+
+/* Once in STREAM_REPORT seconds, writes the latency and the dropped
+ * frames since the last report to r and returns 1 */
+int frame_stream_report(struct frame_stream *fs, struct report *r)
+{
+    long long now = frame_clock_now()/1000000;
+    if(now < fs->report)
+        return 0;
+    fs->report = now + STREAM_REPORT*1000;
+    if(!fs->frames)
+        return 0;
+    report_init(r, STREAM_REPORT_MSG);
+    r->num[0] = fs->lat_cnt ? fs->lat_sum / fs->lat_cnt : 0;
+    r->num[1] = fs->lat_max;
+    r->num[2] = fs->dropped;
+    r->num[3] = fs->frames;
+    reset_stats(fs);
+    return 1;
+}
+
+void frame_stream_close(struct frame_stream *fs)
+{
+    if(fs->fd >= 0)
+        close(fs->fd);
+    fs->fd = -1;
+    fs->ready = fs->fresh = 0;
+    fs->got = 0;
+}
+
+/* Reads until nothing is left, each complete message takes the place of
+ * the one before it. Returns 1 if the client is gone or broke the rules */
+static int read_messages(struct frame_stream *fs)
+{
+    for(;;) {
+        byte_t *dst;
+        size_t want, off;
+        ssize_t n;
+        if(fs->got < sizeof(fs->hdr)) {
+            dst = (byte_t *)&fs->hdr + fs->got;
+            want = sizeof(fs->hdr) - fs->got;
+        } else { /* the payload goes right where it is used */
+            off = fs->got - sizeof(fs->hdr);
+            dst = fs->hdr.type == stream_frame ?
+                  fs->bufs[fs->filling] + off : fs->colors + off;
+            want = fs->hdr.size - off;
+        }
+        n = read(fs->fd, dst, want);
+        if(n < 0)
+            return errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR;
+        if(n == 0)
+            return 1;
+        fs->got += n;
+        if(fs->got == sizeof(fs->hdr) && bad_header(fs))
+            return 1;
+        if(fs->got > sizeof(fs->hdr) &&
+                                 fs->got == sizeof(fs->hdr) + fs->hdr.size)
+            message_done(fs);
+    }
+}
+
+static int bad_header(const struct frame_stream *fs)
+{
+    switch(fs->hdr.type) {
+    case stream_frame:
+        return fs->hdr.size != FRAME_SIZE(fs->pid);
+    case stream_colors:
+        return fs->hdr.size != STREAM_COLORS_SIZE;
+    }
+    return 1;
+}
+
+static void message_done(struct frame_stream *fs)
+{
+    if(fs->hdr.type == stream_colors)
+        colors_to_frame(fs->colors, fs->pid, fs->bufs[fs->filling]);
+    if(fs->fresh)
+        fs->dropped++;
+    fs->filling = !fs->filling;
+    fs->ready = fs->fresh = 1;
+    fs->stamp = fs->hdr.stamp;
+    fs->got = 0;
+    fs->frames++;
+}
+
+static void colors_to_frame(const byte_t *colors, unsigned short pid,
+                                                             byte_t *frame)
+{
+    struct ledframe lf;
+    int upper, lower;
+    if(pid != QUADCAST_2S_PID) { /* one color command of both groups */
+        frame[0] = RGB_CODE;
+        memcpy(frame+1, colors, 3);
+        frame[BYTE_STEP] = RGB_CODE;
+        memcpy(frame+BYTE_STEP+1, colors+3, 3);
+        return;
+    }
+    upper = colors[0] << 16 | colors[1] << 8 | colors[2];
+    lower = colors[3] << 16 | colors[4] << 8 | colors[5];
+    ledframe_init(&lf, frame);
+    led_fill(&lf, QS2S_UPPER_FIRST, QS2S_UPPER_FIRST + QS2S_GROUP_LEDS - 1,
+                                                                     upper);
+    led_fill(&lf, QS2S_LOWER_FIRST, QS2S_LOWER_FIRST + QS2S_GROUP_LEDS - 1,
+                                                                     lower);
+}
+
+static void reset_stats(struct frame_stream *fs)
+{
+    fs->frames = fs->dropped = 0;
+    fs->lat_cnt = fs->lat_max = 0;
+    fs->lat_sum = 0;
+}
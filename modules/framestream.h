@@ -0,0 +1,101 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File framestream.h
+ * Frames pushed by other programs through the control socket. A client
+ * connects, sends the line "stream\n" and then messages, each of them a
+ * header and the payload right after it:
+ *     type   1 byte   'F' - a whole frame, 'C' - two colors
+ *     flags  1 byte   0
+ *     size   2 bytes  of the payload
+ *     pad    4 bytes
+ *     stamp  8 bytes  CLOCK_MONOTONIC nanoseconds of the write, 0 - none
+ * The numbers are in the byte order of the machine. A frame is in the
+ * format of the microphone (see qcrgb_render in libquadcastrgb.h),
+ * colors are 0xRRGGBB of the upper and the lower group, 3 bytes each,
+ * most significant first.
+ *
+ * The frames are read straight into the buffer they are sent from, and
+ * all that has come is read before each frame of the device; only the
+ * last complete frame is shown, the others are dropped. The last frame
+ * stays on while the client is connected, the colors of the program come
+ * back when it disconnects or breaks the protocol. The latency is the
+ * time from the stamp to the end of the transfers of the frame.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#ifndef FRAMESTREAM_SENTRY
+#define FRAMESTREAM_SENTRY
+
+#include <stdint.h> /* for fixed-size fields of the header */
+#include "devio.h" /* for byte_t, QS2S_FRAME_SIZE */
+
+/* Constants */
+#define STREAM_REPORT 10 /* seconds between latency reports */
+#define STREAM_COLORS_SIZE 6
+
+/* Messages */
+#define STREAM_START_MSG _("A client streams frames.")
+#define STREAM_STOP_MSG _("The client has stopped streaming.")
+#define STREAM_REPORT_MSG _("Stream latency: average %lu, max %lu " \
+                            "microsec; %lu of %lu frames dropped")
+
+/* Types */
+enum stream_msg_types { stream_frame = 'F', stream_colors = 'C' };
+
+struct stream_header {
+    uint8_t type;
+    uint8_t flags;
+    uint16_t size;
+    uint32_t pad;
+    uint64_t stamp;
+};
+
+struct ctl; /* see service.h */
+struct report; /* see reporter.h */
+
+struct frame_stream {
+    struct ctl *ctl;
+    int fd;                 /* of the client, -1 - none */
+    unsigned short pid;
+    byte_t bufs[2][QS2S_FRAME_SIZE];
+    int filling;            /* the buffer being read to, the other is shown */
+    int ready;              /* a frame is in the other buffer */
+    int fresh;              /* it hasn't been shown yet */
+    struct stream_header hdr;
+    byte_t colors[STREAM_COLORS_SIZE];
+    size_t got;             /* bytes of the message read so far */
+    uint64_t stamp;         /* of the frame to show */
+    /* Since the last report, the latency is in microseconds */
+    long long report;       /* millisec of the monotonic clock */
+    unsigned long frames, dropped, lat_cnt, lat_max;
+    unsigned long long lat_sum;
+};
+
+/* Functions */
+void frame_stream_init(struct frame_stream *fs, struct ctl *ctl,
+                                                    unsigned short pid);
+const byte_t *frame_stream_poll(struct frame_stream *fs, int verbose);
+void frame_stream_shown(struct frame_stream *fs, unsigned long long sent);
+int frame_stream_report(struct frame_stream *fs, struct report *r);
+void frame_stream_close(struct frame_stream *fs);
+
+#endif
@@ -0,0 +1,125 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File governor.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include "locale_macros.h"
+#include "devio.h" /* for FRAME_PERIOD */
+#include "frameclock.h"
+#include "governor.h"
+#include "reporter.h"
+
+#define NSEC_PER_SEC 1000000000ULL
+
+static int frame_delta(const byte_t *a, const byte_t *b, size_t size);
+static int starts_pass(const struct frame_seq *seq,
+                                       unsigned long long frame);
+static void reset_stats(struct governor *gov, unsigned long transfers);
+
+void governor_init(struct governor *gov, int threshold,
+                                          unsigned short pid)
+{
+    gov->threshold = threshold;
+    gov->keepalive = GOVERNOR_KEEPALIVE*1000UL / FRAME_PERIOD(pid);
+    if(!gov->keepalive)
+        gov->keepalive = 1;
+    gov->report = frame_clock_now() + GOVERNOR_REPORT*NSEC_PER_SEC;
+    reset_stats(gov, 0);
+}
+
+/* Frames to show frame for, 1 or more: it stands for the ones after it
+ * that differ by no more than the threshold, up to the keep-alive. With
+ * redraw, a new pass ends the hold since its colors are drawn anew */
+unsigned int governor_hold(const struct governor *gov,
+                           const struct frame_seq *seq,
+                           unsigned long long frame, int redraw)
+{
+    byte_t shown_buf[QS_FRAME_SIZE], next_buf[QS_FRAME_SIZE];
+    const byte_t *shown, *next;
+    unsigned int held;
+    if(gov->threshold < 0)
+        return 1;
+    shown = frame_seq_get(seq, frame, shown_buf);
+    for(held = 1; held < gov->keepalive; held++) {
+        if(redraw && starts_pass(seq, frame + held))
+            break;
+        next = frame_seq_get(seq, frame + held, next_buf);
+        if(frame_delta(shown, next, seq->frame_size) > gov->threshold)
+            break;
+    }
+    return held;
+}
+
+/* A frame was sent for frames frames */
+void governor_woke(struct governor *gov, unsigned int frames)
+{
+    gov->wakeups++;
+    gov->frames += frames;
+}
+
+/* transfers is the count of the device, see struct frame_output */
+int governor_report(struct governor *gov, unsigned long transfers,
+                                                   struct report *r)
+{
+    unsigned long long now = frame_clock_now();
+    unsigned long secs, wakeups10, transfers10;
+    if(gov->threshold < 0 || now < gov->report)
+        return 0;
+    secs = GOVERNOR_REPORT + (now - gov->report) / NSEC_PER_SEC;
+    wakeups10 = gov->wakeups*10 / secs; /* one decimal digit */
+    transfers10 = (transfers - gov->transfers)*10 / secs;
+    report_init(r, GOVERNOR_REPORT_MSG);
+    r->num[0] = wakeups10 / 10;
+    r->num[1] = wakeups10 % 10;
+    r->num[2] = transfers10 / 10;
+    r->num[3] = transfers10 % 10;
+    r->num[4] = gov->frames - gov->wakeups;
+    r->num[5] = gov->frames;
+    gov->report = now + GOVERNOR_REPORT*NSEC_PER_SEC;
+    reset_stats(gov, transfers);
+    return 1;
+}
+
+/* The largest difference of a byte, the codes are the same in all frames */
+static int frame_delta(const byte_t *a, const byte_t *b, size_t size)
+{
+    int delta, max = 0;
+    for(; size; size--, a++, b++) {
+        delta = *a > *b ? *a - *b : *b - *a;
+        if(delta > max)
+            max = delta;
+    }
+    return max;
+}
+
+static int starts_pass(const struct frame_seq *seq,
+                                       unsigned long long frame)
+{
+    return frame % seq->len[0] == 0 || frame % seq->len[1] == 0;
+}
+
+static void reset_stats(struct governor *gov, unsigned long transfers)
+{
+    gov->transfers = transfers;
+    gov->wakeups = gov->frames = 0;
+}
@@ -0,0 +1,74 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File governor.h
+ * The frame-rate governor. The frames of a colorscheme are known ahead,
+ * so before a frame is shown the governor looks at the ones after it:
+ * those that differ from it by no more than the threshold (the largest
+ * difference of a color channel, 0-255) are held, i.e. not sent, and
+ * the program sleeps through them. A still frame is sent again at least
+ * every GOVERNOR_KEEPALIVE millisec, and the first frame that differs is
+ * sent on time, so a change shows up at once. A pass that gets new
+ * random colors isn't held over.
+ *
+ * Every GOVERNOR_REPORT seconds the wakeups (frames sent) and the USB
+ * transfers per second are reported.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#ifndef GOVERNOR_SENTRY
+#define GOVERNOR_SENTRY
+
+#include "rgbmodes.h" /* for struct frame_seq */
+
+struct report; /* see reporter.h */
+
+/* Constants */
+#define GOVERNOR_KEEPALIVE 1000 /* millisec */
+#define GOVERNOR_REPORT 10 /* seconds between reports */
+#define GOVERNOR_MAX_THRESHOLD 255
+
+/* Messages */
+#define GOVERNOR_REPORT_MSG _("Governor: %lu.%lu wakeups, %lu.%lu USB " \
+                              "transfers per second; %lu of %lu frames " \
+                              "held")
+
+/* Types */
+struct governor {
+    int threshold;             /* -1 - off, every frame is sent */
+    unsigned int keepalive;    /* frames a still frame is held at most */
+    unsigned long long report; /* nanosec of the monotonic clock */
+    unsigned long transfers;   /* of the device at the last report */
+    /* Since the last report */
+    unsigned long wakeups, frames;
+};
+
+/* Functions */
+void governor_init(struct governor *gov, int threshold,
+                                         unsigned short pid);
+unsigned int governor_hold(const struct governor *gov,
+                           const struct frame_seq *seq,
+                           unsigned long long frame, int redraw);
+void governor_woke(struct governor *gov, unsigned int frames);
+int governor_report(struct governor *gov, unsigned long transfers,
+                                                  struct report *r);
+
+#endif
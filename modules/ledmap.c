@@ -0,0 +1,178 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File ledmap.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include <stdlib.h> /* for strtol */
+#include <string.h> /* for memcmp, memset */
+#include <limits.h> /* for INT_MAX */
+
+#include "devio.h" /* for QS2S_DISPLAY_CODE */
+#include "colorpipe.h"
+#include "ledmap.h"
+
+static const struct led_zone zones[] = {
+    { "upper", QS2S_UPPER_FIRST, QS2S_LOWER_FIRST - 1 },
+    { "lower", QS2S_LOWER_FIRST, QS2S_LED_CNT - 1 },
+    { "all", 0, QS2S_LED_CNT - 1 },
+    { NULL, 0, 0 }
+};
+
+static int parse_led(const char *str, const char **end);
+static int lerp(int start, int end, int pos, int length);
+
+/* Functions */
+byte_t *qs2s_led(byte_t *frame, int led)
+{
+    return frame + (led / QS2S_LEDS_PER_PCT)*DATA_PACKET_SIZE +
+                      QS2S_PCT_HEADER + 3*(led % QS2S_LEDS_PER_PCT);
+}
+
+void qs2s_frame_headers(byte_t *frame)
+{
+    int pck;
+    for(pck = 0; pck < QS2S_FRAME_PKT_CNT; pck++) {
+        frame[pck*DATA_PACKET_SIZE] = QS2S_DISPLAY_CODE;
+        frame[pck*DATA_PACKET_SIZE+1] = QS2S_RGB_PACKET_CODE;
+        frame[pck*DATA_PACKET_SIZE+2] = pck;
+    }
+}
+
+/* Returns 0 and the LEDs in first & last if str is a valid range */
+int ledmap_parse_range(const char *str, int *first, int *last)
+{
+    const struct led_zone *zone;
+    const char *end;
+    for(zone = zones; zone->name; zone++) {
+        if(strequ(zone->name, str)) {
+            *first = zone->first;
+            *last = zone->last;
+            return 0;
+        }
+    }
+    *first = parse_led(str, &end);
+    if(*end == ':')
+        *last = parse_led(end+1, &end);
+    else
+        *last = *first;
+    if(*end || *first < 0 || *first >= QS2S_LED_CNT || *last < *first)
+        return 1;
+    if(*last >= QS2S_LED_CNT)
+        *last = QS2S_LED_CNT - 1;
+    return 0;
+}
+
+void ledframe_init(struct ledframe *lf, byte_t *buf)
+{
+    lf->data = buf;
+    memset(buf, 0, QS2S_FRAME_SIZE);
+    qs2s_frame_headers(buf);
+    lf->dirty = QS2S_ALL_DIRTY;
+}
+
+/* Replaces the colors with the ones of frame, marking what has changed */
+void ledframe_load(struct ledframe *lf, const byte_t *frame)
+{
+    int pck;
+    for(pck = 0; pck < QS2S_FRAME_PKT_CNT; pck++) {
+        const byte_t *src = frame + pck*DATA_PACKET_SIZE;
+        byte_t *dst = lf->data + pck*DATA_PACKET_SIZE;
+        if(memcmp(dst, src, DATA_PACKET_SIZE)) {
+            memcpy(dst, src, DATA_PACKET_SIZE);
+            lf->dirty |= 1 << pck;
+        }
+    }
+}
+
+void led_set(struct ledframe *lf, int led, int color)
+{
+    byte_t rgb[3], *p;
+    if(led < 0 || led >= QS2S_LED_SLOTS)
+        return;
+    rgb[0] = (color >> 16) & 0xff;
+    rgb[1] = (color >> 8) & 0xff;
+    rgb[2] = color & 0xff;
+    p = qs2s_led(lf->data, led);
+    if(memcmp(p, rgb, 3)) {
+        memcpy(p, rgb, 3);
+        lf->dirty |= 1 << (led / QS2S_LEDS_PER_PCT);
+    }
+}
+
+void led_fill(struct ledframe *lf, int first, int last, int color)
+{
+    for(; first <= last; first++)
+        led_set(lf, first, color);
+}
+
+/* Without a pipe the gradient goes in sRGB like the ones of the modes */
+void led_gradient(struct ledframe *lf, int first, int last, int start,
+                                     int end, const struct colorpipe *pipe)
+{
+    unsigned short st[3], en[3], lin[3];
+    int led, i, length = last - first + 1;
+    if(pipe) {
+        colorpipe_decode(start, st);
+        colorpipe_decode(end, en);
+    }
+    for(led = first; led <= last; led++) {
+        int color = 0, shift;
+        if(pipe) {
+            for(i = 0; i < 3; i++)
+                lin[i] = lerp(st[i], en[i], led-first, length);
+            color = colorpipe_encode(pipe, lin);
+        } else {
+            for(shift = 16; shift >= 0; shift -= 8) {
+                color += lerp((start >> shift) & 0xff, (end >> shift) & 0xff,
+                                              led-first, length) << shift;
+            }
+        }
+        led_set(lf, led, color);
+    }
+}
+
+int ledframe_dirty_cnt(const struct ledframe *lf)
+{
+    int pck, cnt = 0;
+    for(pck = 0; pck < QS2S_FRAME_PKT_CNT; pck++)
+        cnt += (lf->dirty >> pck) & 1;
+    return cnt;
+}
+
+static int parse_led(const char *str, const char **end)
+{
+    char *e;
+    long led;
+    led = strtol(str, &e, 10);
+    *end = e;
+    if(e == str || led < 0 || led > INT_MAX)
+        return -1;
+    return (int)led;
+}
+
+static int lerp(int start, int end, int pos, int length)
+{
+    if(length < 2)
+        return start;
+    return start + (end - start)*pos/(length - 1);
+}
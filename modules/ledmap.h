@@ -0,0 +1,75 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File ledmap.h
+ * Per-LED addressing of Quadcast 2S. A frame of the 2S is 6 packets of
+ * 20 LEDs each; the map gives names to the zones the LEDs form and sets
+ * single LEDs, ranges and gradients in a frame. A frame remembers which
+ * packets have changed since it was last sent, so only those packets
+ * need to go to the device.
+ *
+ * LED numbers are positions in the frame, 0 is the first LED of the
+ * first packet. The ring has QS2S_LED_CNT of them, the rest of the slots
+ * of a frame light nothing. Ranges are given as FIRST:LAST (both
+ * included, LAST stops at the end of the ring), a single LED number or a
+ * zone name:
+ *     upper    the LEDs of the upper part, 0-53
+ *     lower    the LEDs of the lower part, 54-107
+ *     all      every LED of the ring, 0-107
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#ifndef LEDMAP_SENTRY
+#define LEDMAP_SENTRY
+
+#include "rgbmodes.h" /* for byte_t, QS2S_* constants */
+
+/* Constants */
+#define QS2S_FRAME_PKT_CNT (QS2S_FRAME_SIZE/DATA_PACKET_SIZE)
+#define QS2S_LED_SLOTS (QS2S_FRAME_PKT_CNT*QS2S_LEDS_PER_PCT)
+#define QS2S_ALL_DIRTY ((1 << QS2S_FRAME_PKT_CNT) - 1)
+
+/* Types */
+struct led_zone {
+    const char *name;
+    int first, last;
+};
+
+struct ledframe {
+    byte_t *data;       /* QS2S_FRAME_SIZE bytes, owned by the caller */
+    unsigned int dirty; /* bit N - packet N changed since it was sent */
+};
+
+struct colorpipe; /* see colorpipe.h */
+
+/* Functions */
+byte_t *qs2s_led(byte_t *frame, int led);
+void qs2s_frame_headers(byte_t *frame);
+int ledmap_parse_range(const char *str, int *first, int *last);
+void ledframe_init(struct ledframe *lf, byte_t *buf);
+void ledframe_load(struct ledframe *lf, const byte_t *frame);
+void led_set(struct ledframe *lf, int led, int color);
+void led_fill(struct ledframe *lf, int first, int last, int color);
+void led_gradient(struct ledframe *lf, int first, int last, int start,
+                                    int end, const struct colorpipe *pipe);
+int ledframe_dirty_cnt(const struct ledframe *lf);
+
+#endif
@@ -0,0 +1,233 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File libquadcastrgb.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include <stdlib.h> /* for malloc */
+#include <string.h> /* for memcpy */
+
+#include "locale_macros.h"
+#include "argparser.h"
+#include "rgbmodes.h"
+#include "devio.h"
+#include "libquadcastrgb.h"
+
+struct qcrgb_dev {
+    libusb_context *ctx;
+    int own_ctx; /* the context was made by qcrgb_open */
+    int cache;   /* QCRGB_OPEN_CACHE */
+    libusb_device_handle *handle;
+    unsigned short pid;
+    struct frame_output out;
+};
+
+struct qcrgb_scheme {
+    datpack *data_arr;
+    unsigned short pid;
+    struct frame_seq seq;
+};
+
+/* Devices */
+int qcrgb_open(struct qcrgb_dev **dev, struct libusb_context *ctx)
+{
+    return qcrgb_open_flags(dev, ctx, 0);
+}
+
+int qcrgb_open_flags(struct qcrgb_dev **dev, struct libusb_context *ctx,
+                                                     unsigned int flags)
+{
+    struct qcrgb_dev *d;
+    int errcode;
+    if(!dev)
+        return qcrgb_err_args;
+    d = malloc(sizeof(*d));
+    if(!d)
+        return qcrgb_err_nomem;
+    d->ctx = ctx;
+    d->own_ctx = !ctx;
+    d->cache = (flags & QCRGB_OPEN_CACHE) != 0;
+    if(d->own_ctx && libusb_init(&d->ctx)) {
+        free(d);
+        return qcrgb_err_libusb;
+    }
+    errcode = open_mic_ctx(d->ctx, &d->handle, &d->pid, d->cache);
+    if(errcode) {
+        if(d->own_ctx)
+            libusb_exit(d->ctx);
+        free(d);
+        return errcode;
+    }
+    frame_output_init(&d->out, d->pid);
+    *dev = d;
+    return qcrgb_ok;
+}
+
+void qcrgb_close(struct qcrgb_dev *dev)
+{
+    if(!dev)
+        return;
+    close_mic(dev->handle);
+    if(dev->own_ctx)
+        libusb_exit(dev->ctx);
+    free(dev);
+}
+
+/* Gets back a microphone that was replugged or stopped responding */
+int qcrgb_reopen(struct qcrgb_dev *dev)
+{
+    struct dimmer dim;
+    int errcode;
+    if(!dev)
+        return qcrgb_err_args;
+    errcode = reopen_mic(dev->ctx, &dev->handle, dev->pid, dev->cache);
+    /* everything is sent anew, the dimmer stays */
+    dim = dev->out.dim;
+    frame_output_init(&dev->out, dev->pid);
+    dev->out.dim = dim;
+    return errcode;
+}
+
+unsigned short qcrgb_product_id(const struct qcrgb_dev *dev)
+{
+    return dev ? dev->pid : 0;
+}
+
+/* Schemes */
+int qcrgb_compile(struct qcrgb_scheme **sch, unsigned short product_id,
+                                               int argc, const char **argv)
+{
+    struct qcrgb_scheme *s;
+    struct colschemes cs;
+    struct progopts opts;
+    const char **args;
+    int pck_cnt, status;
+    if(!sch || argc < 0 || (argc && !argv))
+        return qcrgb_err_args;
+    args = malloc(sizeof(*args) * (argc+1)); /* parse_arg skips argv[0] */
+    if(!args)
+        return qcrgb_err_nomem;
+    args[0] = "";
+    if(argc)
+        memcpy(args+1, argv, sizeof(*args) * argc);
+    status = parse_arg(&cs, argc+1, args, &opts);
+    free(args);
+    if(status != success || opts.scene || opts.poke ||
+                              opts.analyze) /* help & the like */
+        return qcrgb_err_args;
+
+    s = malloc(sizeof(*s));
+    if(!s)
+        return qcrgb_err_nomem;
+    cs.pid = product_id;
+    s->data_arr = parse_colorscheme(&cs, &pck_cnt);
+    if(!s->data_arr) {
+        free(s);
+        return pck_cnt < 0 ? qcrgb_err_nosupport : qcrgb_err_nomem;
+    }
+    s->pid = product_id;
+    frame_seq_init(&s->seq, s->data_arr, pck_cnt, product_id);
+    *sch = s;
+    return qcrgb_ok;
+}
+
+void qcrgb_free(struct qcrgb_scheme *sch)
+{
+    if(!sch)
+        return;
+    free(sch->data_arr);
+    free(sch);
+}
+
+/* Both groups of Quadcast S start over together after that many */
+unsigned int qcrgb_frame_count(const struct qcrgb_scheme *sch)
+{
+    return sch ? sch->seq.period : 0;
+}
+
+size_t qcrgb_frame_size(const struct qcrgb_scheme *sch)
+{
+    return sch ? sch->seq.frame_size : 0;
+}
+
+/* Frame numbers wrap around, so a counter can be passed as is */
+int qcrgb_render(const struct qcrgb_scheme *sch, unsigned int frame,
+                                            unsigned char *buf, size_t size)
+{
+    if(!sch || !buf || size < sch->seq.frame_size)
+        return qcrgb_err_args;
+    frame_seq_copy(&sch->seq, frame, buf);
+    return qcrgb_ok;
+}
+
+/* Output */
+int qcrgb_send(struct qcrgb_dev *dev, const struct qcrgb_scheme *sch,
+                                                       unsigned int frame)
+{
+    byte_t buf[QS_FRAME_SIZE];
+    if(!dev || !sch || sch->pid != dev->pid)
+        return qcrgb_err_args;
+    if(!dev->handle)
+        return qcrgb_err_nodev;
+    return display_frame(dev->handle, &dev->out,
+                                  frame_seq_get(&sch->seq, frame, buf));
+}
+
+int qcrgb_show(struct qcrgb_dev *dev, const unsigned char *frame)
+{
+    if(!dev || !frame)
+        return qcrgb_err_args;
+    if(!dev->handle)
+        return qcrgb_err_nodev;
+    return display_frame(dev->handle, &dev->out, frame);
+}
+
+int qcrgb_dim(struct qcrgb_dev *dev, int percent, unsigned long ramp_ms)
+{
+    if(!dev || percent < 0 || percent > DIMMER_FULL)
+        return qcrgb_err_args;
+    dimmer_set(&dev->out.dim, percent, ramp_ms);
+    return qcrgb_ok;
+}
+
+const char *qcrgb_strerror(int status)
+{
+    switch(status) {
+    case qcrgb_ok:
+        return _("Success");
+    case qcrgb_err_args:
+        return _("Invalid arguments");
+    case qcrgb_err_libusb:
+        return _("libusb error");
+    case qcrgb_err_nodev:
+        return _("No compatible microphone is connected");
+    case qcrgb_err_open:
+        return _("Couldn't open the microphone");
+    case qcrgb_err_transfer:
+        return _("Couldn't transfer a packet");
+    case qcrgb_err_nomem:
+        return _("Out of memory");
+    case qcrgb_err_nosupport:
+        return _("The mode isn't supported by the microphone");
+    }
+    return _("Unknown error");
+}
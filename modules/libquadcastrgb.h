@@ -0,0 +1,105 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File libquadcastrgb.h
+ * The public interface of libquadcastrgb, the library the program is
+ * built from. Everything works on handles and returns a status, nothing
+ * ends the process, forks or installs signal handlers, so the library
+ * can drive the microphone from inside a long-running program.
+ *
+ * The usual sequence is:
+ *     qcrgb_open       find & claim the microphone
+ *     qcrgb_compile    turn the usual command-line arguments into frames
+ *     qcrgb_send       show a frame, takes one frame period of the device
+ *     qcrgb_free, qcrgb_close
+ * Transfers are retried a few times before qcrgb_send gives up; after
+ * that, qcrgb_reopen gets the same microphone back without starting
+ * over (it fails with qcrgb_err_nodev until the microphone is back).
+ * qcrgb_render copies a frame out, so that it can be changed before
+ * being shown with qcrgb_show. qcrgb_dim dims whatever is sent after it
+ * without compiling anything again. Only the types and functions below are
+ * stable; QCRGB_API_VERSION grows when something is added.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#ifndef LIBQUADCASTRGB_SENTRY
+#define LIBQUADCASTRGB_SENTRY
+
+#include <stddef.h> /* for size_t */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define QCRGB_API_VERSION 4
+#define QCRGB_MAX_FRAME_SIZE 384 /* bytes, see qcrgb_frame_size */
+#define QCRGB_OPEN_CACHE 0x1 /* see qcrgb_open_flags */
+
+/* Statuses, the non-zero ones match the exitcodes of the program */
+enum qcrgb_status {
+    qcrgb_ok = 0,
+    qcrgb_err_args = 1,      /* bad arguments or a NULL handle */
+    qcrgb_err_libusb = 2,    /* libusb couldn't be set up */
+    qcrgb_err_nodev = 3,     /* no compatible microphone */
+    qcrgb_err_open = 4,      /* couldn't open or claim the microphone */
+    qcrgb_err_transfer = 5,  /* a packet wasn't delivered */
+    qcrgb_err_nomem = 7,
+    qcrgb_err_nosupport = 254 /* the mode isn't supported by the device */
+};
+
+struct libusb_context;
+struct qcrgb_dev;    /* an opened microphone */
+struct qcrgb_scheme; /* compiled frames for one microphone model */
+
+/* Devices. ctx is the caller's libusb context or NULL for a private one */
+int qcrgb_open(struct qcrgb_dev **dev, struct libusb_context *ctx);
+/* With QCRGB_OPEN_CACHE the port of the microphone is tried first and
+ * remembered in $XDG_CACHE_HOME/quadcastrgb/device, as the program does;
+ * qcrgb_open is qcrgb_open_flags with no flags and writes no files */
+int qcrgb_open_flags(struct qcrgb_dev **dev, struct libusb_context *ctx,
+                                                   unsigned int flags);
+void qcrgb_close(struct qcrgb_dev *dev);
+int qcrgb_reopen(struct qcrgb_dev *dev);
+unsigned short qcrgb_product_id(const struct qcrgb_dev *dev);
+
+/* Schemes. argv holds the arguments only, without the program name */
+int qcrgb_compile(struct qcrgb_scheme **sch, unsigned short product_id,
+                                              int argc, const char **argv);
+void qcrgb_free(struct qcrgb_scheme *sch);
+unsigned int qcrgb_frame_count(const struct qcrgb_scheme *sch);
+size_t qcrgb_frame_size(const struct qcrgb_scheme *sch);
+int qcrgb_render(const struct qcrgb_scheme *sch, unsigned int frame,
+                                           unsigned char *buf, size_t size);
+
+/* Output */
+int qcrgb_send(struct qcrgb_dev *dev, const struct qcrgb_scheme *sch,
+                                                      unsigned int frame);
+int qcrgb_show(struct qcrgb_dev *dev, const unsigned char *frame);
+/* percent 0-100 of the brightness, reached in ramp_ms (0 - at once) */
+int qcrgb_dim(struct qcrgb_dev *dev, int percent, unsigned long ramp_ms);
+
+const char *qcrgb_strerror(int status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
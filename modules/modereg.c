@@ -0,0 +1,152 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File modereg.c
+ *
+  * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include <dlfcn.h>
+#include <stdio.h> /* for fprintf & sprintf */
+#include <string.h> /* for strlen */
+
+#include "locale_macros.h"
+#include "argparser.h" /* for strequ & the colors */
+#include "modereg.h"
+
+/* Palettes */
+const int red_colors[] = { red, nocolor };
+const int random_colors[] = { nocolor }; /* drawn by the mode */
+const int rainbow_colors[] = {
+    0xff0000, 0xff009e, 0xcd00ff,
+    0x2b00ff, 0x0068ff, 0x00ffff,
+    0x00ff67, 0x32ff00, 0xceff00,
+    nocolor
+};
+const int fire_colors[] = {
+    0x000000, 0x801000, 0xff3000, 0xff8000, 0xffd040, nocolor
+};
+
+/* The built-in modes come first, a new one only has to be listed here.
+ * The help and the errors name them in this order, the plug-ins follow.
+ * The slots left are NULL */
+static const struct rgb_mode *registry[MODEREG_MAX_MODES] = {
+    &solid_mode, &blink_mode, &cycle_mode, &wave_mode, &lightning_mode,
+    &pulse_mode, &visualizer_mode, &breathe_mode, &noise_mode, &fire_mode
+};
+
+static int registered_cnt();
+static int is_registered(const struct rgb_mode *md);
+static int can_register(const struct rgb_mode *md);
+
+/* Functions */
+/* Returns NULL if there is no such mode */
+const struct rgb_mode *mode_find(const char *name)
+{
+    int i, cnt = registered_cnt();
+    for(i = 0; i < cnt; i++) {
+        if(strequ(registry[i]->name, name))
+            return registry[i];
+    }
+    return NULL;
+}
+
+/* Writes the names of the modes that work with some device to buf,
+ * separated by sep; the ones that don't fit in size are left out */
+void mode_names(char *buf, size_t size, const char *sep)
+{
+    size_t len = 0, add;
+    int i, cnt = registered_cnt();
+    if(!size)
+        return;
+    *buf = '\0';
+    for(i = 0; i < cnt; i++) {
+        if(!registry[i]->caps) /* not supported yet */
+            continue;
+        add = (len ? strlen(sep) : 0) + strlen(registry[i]->name);
+        if(len + add >= size)
+            break;
+        sprintf(buf + len, "%s%s", len ? sep : "", registry[i]->name);
+        len += add;
+    }
+}
+
+/* Adds the modes of the plug-in, all of them or none. A plug-in that is
+ * loaded again adds nothing. Returns 0 or 1, the reason is printed */
+int mode_load_plugin(const char *path)
+{
+    const struct rgb_mode *const *table, *const *md;
+    const int *abi;
+    int cnt = registered_cnt(), added = cnt;
+    void *dl;
+    dl = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if(!dl) {
+        fprintf(stderr, PLUGIN_OPEN_ERR_MSG, path, dlerror());
+        return 1;
+    }
+    abi = dlsym(dl, MODE_ABI_SYMBOL);
+    table = dlsym(dl, MODE_TABLE_SYMBOL);
+    if(!abi || *abi != MODE_ABI || !table) {
+        fprintf(stderr, PLUGIN_ABI_ERR_MSG, path, MODE_ABI);
+        dlclose(dl);
+        return 1;
+    }
+    for(md = table; *md; md++) {
+        if(is_registered(*md))
+            continue;
+        if(!can_register(*md) || added >= MODEREG_MAX_MODES) {
+            fprintf(stderr, PLUGIN_MODE_ERR_MSG, path,
+                                         (*md)->name ? (*md)->name : "");
+            dlclose(dl);
+            return 1;
+        }
+        added++;
+    }
+    for(md = table; *md; md++) {
+        if(!is_registered(*md))
+            registry[cnt++] = *md;
+    }
+    return 0;
+}
+
+static int registered_cnt()
+{
+    int cnt = 0;
+    while(cnt < MODEREG_MAX_MODES && registry[cnt])
+        cnt++;
+    return cnt;
+}
+
+static int is_registered(const struct rgb_mode *md)
+{
+    int i, cnt = registered_cnt();
+    for(i = 0; i < cnt; i++) {
+        if(registry[i] == md)
+            return 1;
+    }
+    return 0;
+}
+
+/* Of two modes of a plug-in with the same name, mode_find takes the first */
+static int can_register(const struct rgb_mode *md)
+{
+    return md->name && !mode_find(md->name) && md->step && md->defaults &&
+                                       md->min_ms && md->max_ms >= md->min_ms;
+}
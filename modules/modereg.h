@@ -0,0 +1,97 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File modereg.h
+ * The mode registry. Every mode is a descriptor of the protocols it works
+ * with, its default colors and the functions that give its frames. The
+ * name given on the command line is looked up once, by parse_arg, and
+ * the rest of the program only goes through the descriptor. A mode gives
+ * its frames in one of two ways:
+ *     size, sequence   the color commands of a group of Quadcast S are
+ *                      counted, then put on a timeline (see timeline.h)
+ *     step             the color of an LED is computed from the time and
+ *                      the LED alone, like the effects (see effects.h);
+ *                      the frames are rendered pass by pass
+ * On Quadcast 2S, a mode that doesn't step shows its first color still.
+ *
+ * More modes can be loaded from plug-ins: shared objects that export
+ * MODE_ABI_SYMBOL, an int equal to MODE_ABI, and MODE_TABLE_SYMBOL, a
+ * NULL-ended array of pointers to their descriptors. The timelines are
+ * internal to the program, so the modes of a plug-in must step. A
+ * plug-in stays loaded until the program ends.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#ifndef MODEREG_SENTRY
+#define MODEREG_SENTRY
+
+#include <stddef.h> /* for size_t */
+#include <stdint.h> /* for uint32_t */
+
+/* Constants */
+#define MODE_ABI 1
+#define MODE_ABI_SYMBOL "quadcastrgb_mode_abi"
+#define MODE_TABLE_SYMBOL "quadcastrgb_modes"
+#define MODEREG_MAX_MODES 64
+#define MODE_NAMES_LEN 512 /* enough for the names of the built-in ones */
+
+/* Messages */
+#define PLUGIN_OPEN_ERR_MSG _("Couldn't load the plug-in %s: %s\n")
+#define PLUGIN_ABI_ERR_MSG _("%s: not a plug-in of version %d\n")
+#define PLUGIN_MODE_ERR_MSG _("%s: the mode \"%s\" is taken, doesn't " \
+                              "step or is one too many\n")
+
+/* Types */
+enum mode_caps { cap_qs = 1, cap_qs2s = 2 }; /* the protocols it works with */
+
+struct colscheme; /* see argparser.h */
+struct colorpipe; /* see colorpipe.h */
+struct timeline;  /* see timeline.h */
+struct effect;    /* see effects.h */
+
+struct rgb_mode {
+    const char *name;
+    unsigned int caps;   /* enum mode_caps */
+    const int *defaults; /* the colors if none are given, nocolor-ended */
+    /* data packets of a group of Quadcast S, the colors that don't fit in
+     * them may be stripped */
+    int (*size)(struct colscheme *colsch, int dither);
+    void (*sequence)(struct colscheme *colsch, int group,
+                     const struct colorpipe *pipe, struct timeline *tl);
+    /* the color of led ms milliseconds in, NULL if the mode doesn't step */
+    int (*step)(const struct effect *fx, uint32_t ms, int led);
+    uint32_t min_ms, max_ms; /* a period of step at the top & low speed */
+};
+
+/* Descriptors & palettes of the built-in modes */
+extern const struct rgb_mode solid_mode, blink_mode, cycle_mode,
+                             wave_mode, lightning_mode, pulse_mode,
+                             visualizer_mode, breathe_mode, noise_mode,
+                             fire_mode;
+extern const int red_colors[], random_colors[], rainbow_colors[],
+                 fire_colors[];
+
+/* Functions */
+const struct rgb_mode *mode_find(const char *name);
+void mode_names(char *buf, size_t size, const char *sep);
+int mode_load_plugin(const char *path);
+
+#endif
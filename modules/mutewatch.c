@@ -0,0 +1,271 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File mutewatch.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include <stdlib.h> /* for malloc */
+
+#include "locale_macros.h"
+
+#include "devio.h" /* for libusb, QUADCAST_2S_PID */
+#include "scene.h"
+#include "mutewatch.h"
+
+#define STOP_WAIT (100*1000) /* microsec for a cancelled transfer to end */
+#define STOP_TRIES 10
+
+static int load_muted(struct mute_watch *mw, const char *path,
+                                                   unsigned short pid);
+static int alloc_transfer(struct mute_watch *mw);
+static void LIBUSB_CALL report_done(struct libusb_transfer *xfer);
+
+/* Loads the muted colorscheme, the transfer is submitted with the first
+ * frame (the program may fork before). Without path nothing is watched.
+ * Returns 0 or muteerr */
+int mute_watch_open(struct mute_watch *mw, const char *path,
+                                                    unsigned short pid)
+{
+    mw->xfer = NULL;
+    mw->report = NULL;
+    mw->armed = mw->pending = 0;
+    mw->fails = 0;
+    mw->muted = mw->shown = 0;
+    mw->sc = NULL;
+    mw->step = NULL;
+    mw->frame = 0;
+    if(!path)
+        return 0;
+    if(pid == QUADCAST_2S_PID) {
+        fputs(MUTE_NOSUPPORT_MSG, stderr);
+        return 0;
+    }
+    if(load_muted(mw, path, pid))
+        return muteerr;
+    if(alloc_transfer(mw)) {
+        mute_watch_close(mw);
+        return muteerr;
+    }
+    mw->armed = 1;
+    return 0;
+}
+
+/* Submits the transfer on the handle, the microphone counts as live
+ * until it reports otherwise. Returns 0 or a libusb error */
+int mute_watch_start(struct mute_watch *mw,
+                     struct libusb_device_handle *handle)
+{
+    int errcode;
+    mw->armed = 0;
+    if(!mw->sc || mw->pending)
+        return 0;
+    mw->muted = 0;
+    mw->fails = 0;
+    if(!mw->xfer && alloc_transfer(mw))
+        return LIBUSB_ERROR_NO_MEM;
+    libusb_fill_interrupt_transfer(mw->xfer, handle, INTR_EP_IN,
+                                   mw->report->data, INTR_LENGTH,
+                                   report_done, mw->report, 0);
+    errcode = libusb_submit_transfer(mw->xfer);
+    if(errcode) {
+        fprintf(stderr, MUTE_WATCH_ERR_MSG, libusb_strerror(errcode));
+        return errcode;
+    }
+    mw->pending = 1;
+    return 0;
+}
+
+/* Cancels the transfer, e.g. before the handle is closed. One that
+ * doesn't end in time is left to free itself (see report_done), the
+ * next start makes another */
+void mute_watch_stop(struct mute_watch *mw)
+{
+    struct timeval tv;
+    int tries;
+    if(!mw->pending)
+        return;
+    libusb_cancel_transfer(mw->xfer); /* fails if it's over already */
+    for(tries = 0; mw->pending && tries < STOP_TRIES; tries++) {
+        tv.tv_sec = 0;
+        tv.tv_usec = STOP_WAIT;
+        libusb_handle_events_timeout_completed(NULL, &tv, NULL);
+    }
+    if(!mw->pending)
+        return;
+    mw->report->mw = NULL;
+    mw->xfer = NULL;
+    mw->report = NULL;
+    mw->pending = 0;
+    mw->muted = 0;
+}
+
+void mute_watch_close(struct mute_watch *mw)
+{
+    mute_watch_stop(mw);
+    if(mw->xfer)
+        libusb_free_transfer(mw->xfer);
+    free(mw->report);
+    mw->xfer = NULL;
+    mw->report = NULL;
+    mw->armed = mw->pending = 0;
+    if(mw->sc) {
+        scene_free(mw->sc);
+        free(mw->sc);
+        mw->sc = NULL;
+    }
+}
+
+/* Handles the events of libusb that have come without waiting, tells if
+ * the state differs from the one of the last frame */
+int mute_watch_changed(struct mute_watch *mw)
+{
+    struct timeval tv = { 0, 0 };
+    if(mw->pending)
+        libusb_handle_events_timeout_completed(NULL, &tv, NULL);
+    return mw->muted != mw->shown;
+}
+
+int mute_watch_muted(const struct mute_watch *mw)
+{
+    return mw->sc && mw->muted;
+}
+
+/* The frame to show instead of frame, the muted colorscheme starts from
+ * its first frame with each press */
+const byte_t *mute_watch_frame(struct mute_watch *mw,
+                               struct libusb_device_handle *handle,
+                               const byte_t *frame)
+{
+    if(!mw->sc)
+        return frame;
+    if(mw->armed)
+        mute_watch_start(mw, handle);
+    if(mute_watch_changed(mw) && mw->muted)
+        mw->frame = 0;
+    mw->shown = mw->muted;
+    if(!mw->shown)
+        return frame;
+    return scene_frame(mw->sc, mw->step, mw->frame++);
+}
+/* Fills pfds with at most max file descriptors of libusb to sleep on,
+ * returns their count */
+int mute_watch_pollfds(const struct mute_watch *mw, struct pollfd *pfds,
+                                                                  int max)
+{
+    int cnt = 0;
+    const struct libusb_pollfd **fds;
+    if(!mw->pending)
+        return 0;
+    fds = libusb_get_pollfds(NULL);
+    if(!fds)
+        return 0;
+    for(; fds[cnt] && cnt < max; cnt++) {
+        pfds[cnt].fd = fds[cnt]->fd;
+        pfds[cnt].events = fds[cnt]->events;
+        pfds[cnt].revents = 0;
+    }
+    libusb_free_pollfds(fds);
+    return cnt;
+}
+
+/* 1 - muted, 0 - live, -1 - the report isn't about the state */
+int mute_report_state(const byte_t *report, int len)
+{
+    if(len <= MUTE_STATE_BYTE || report[0] != MUTE_REPORT_CODE)
+        return -1;
+    return report[MUTE_STATE_BYTE] != 0;
+}
+
+/* The first step to play of the scene is the muted colorscheme */
+static int load_muted(struct mute_watch *mw, const char *path,
+                                                   unsigned short pid)
+{
+    unsigned int i;
+    mw->sc = malloc(sizeof(*mw->sc));
+    if(!mw->sc) {
+        perror("malloc");
+        return 1;
+    }
+    if(scene_load(mw->sc, path, pid)) {
+        free(mw->sc);
+        mw->sc = NULL;
+        return 1;
+    }
+    for(i = 0; i < mw->sc->hdr->step_cnt && !mw->step; i++) {
+        if(mw->sc->steps[i].type == step_play &&
+                                             mw->sc->steps[i].frame_cnt)
+            mw->step = mw->sc->steps + i;
+    }
+    if(mw->step)
+        return 0;
+    fprintf(stderr, MUTE_NOPLAY_ERR_MSG, path);
+    mute_watch_close(mw);
+    return 1;
+}
+
+/* The transfer and its report buffer, which outlives the watch if the
+ * transfer is left. Returns 0 or 1 */
+static int alloc_transfer(struct mute_watch *mw)
+{
+    mw->report = malloc(sizeof(*mw->report));
+    mw->xfer = mw->report ? libusb_alloc_transfer(0) : NULL;
+    if(!mw->xfer) {
+        fprintf(stderr, MUTE_WATCH_ERR_MSG,
+                        libusb_strerror(LIBUSB_ERROR_NO_MEM));
+        free(mw->report);
+        mw->report = NULL;
+        return 1;
+    }
+    mw->report->mw = mw;
+    return 0;
+}
+
+/* Runs within the event handling of libusb, the transfer waits for the
+ * next report at once. A lost microphone stops it, see recover_mic, and
+ * so do MUTE_MAX_FAILS failures in a row: an endpoint that stalls would
+ * fail again at once */
+static void LIBUSB_CALL report_done(struct libusb_transfer *xfer)
+{
+    struct mute_report *report = xfer->user_data;
+    struct mute_watch *mw = report->mw;
+    int state;
+    if(!mw) { /* see mute_watch_stop */
+        libusb_free_transfer(xfer);
+        free(report);
+        return;
+    }
+    mw->pending = 0;
+    if(xfer->status == LIBUSB_TRANSFER_CANCELLED ||
+                               xfer->status == LIBUSB_TRANSFER_NO_DEVICE)
+        return;
+    if(xfer->status == LIBUSB_TRANSFER_COMPLETED) {
+        mw->fails = 0;
+        state = mute_report_state(report->data, xfer->actual_length);
+        if(state >= 0)
+            mw->muted = state;
+    } else if(++mw->fails >= MUTE_MAX_FAILS) {
+        fputs(MUTE_LOST_MSG, stderr);
+        mw->muted = 0;
+        return;
+    }
+    mw->pending = !libusb_submit_transfer(xfer);
+}
@@ -0,0 +1,109 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File mutewatch.h
+ * Following the mute button. Quadcast S and DuoCast tell the state of
+ * the microphone in the reports of their interrupt endpoint; a transfer
+ * waits there all along, libusb completes it among the events of the
+ * frame sender and the next frame is already taken from the "muted"
+ * colorscheme (--muted, a scene of which the first step is played).
+ * Nothing polls the device and no thread is started: the sender handles
+ * the events before each frame without waiting and sleeps on the file
+ * descriptors of libusb when it holds a frame (see hold_frames), so the
+ * colors change within a frame period of the press.
+ *
+ * The microphone counts as live until it has sent its first report, and
+ * again once MUTE_MAX_FAILS transfers in a row have failed: the watch
+ * stops then till the microphone is opened again. The report buffer
+ * belongs to the transfer, so a transfer that won't end when it's
+ * cancelled is left to free itself in its callback. The
+ * layout of a report is given by the constants below. Quadcast 2S
+ * answers its commands on the only IN endpoint it has, so it isn't
+ * watched.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#ifndef MUTEWATCH_SENTRY
+#define MUTEWATCH_SENTRY
+
+#include <poll.h> /* for struct pollfd */
+#include "rgbmodes.h" /* for byte_t */
+
+/* Constants */
+#define INTR_EP_IN 0x82
+#define INTR_LENGTH 8
+#define MUTE_REPORT_CODE 0x01 /* the first byte of a report of the state */
+#define MUTE_STATE_BYTE 1     /* 0 - live, anything else - muted */
+#define MUTE_MAX_POLLFDS 8    /* of libusb to sleep on */
+#define MUTE_MAX_FAILS 3      /* transfers in a row before it stops */
+
+/* Messages */
+#define MUTE_NOPLAY_ERR_MSG _("%s: no step to play when muted\n")
+#define MUTE_WATCH_ERR_MSG _("Couldn't listen to the mute button: %s\n")
+#define MUTE_NOSUPPORT_MSG _("The microphone doesn't report the mute " \
+                             "button, --muted is ignored.\n")
+#define MUTE_LOST_MSG _("The mute button doesn't report any more, --muted " \
+                        "waits for the microphone to be opened again.\n")
+
+enum mute_exitcodes { muteerr = 11 }; /* exitcode, after captureerr */
+
+/* Types */
+struct libusb_transfer;
+struct libusb_device_handle;
+struct scene;
+struct scene_step;
+struct mute_watch;
+
+struct mute_report {              /* the user data of the transfer */
+    byte_t data[INTR_LENGTH];
+    struct mute_watch *mw;        /* NULL - the transfer was left */
+};
+
+struct mute_watch {
+    struct libusb_transfer *xfer; /* NULL - none yet or it was left */
+    struct mute_report *report;   /* goes with xfer */
+    int armed;                    /* to submit it at the next frame */
+    int pending;                  /* the transfer is submitted */
+    int fails;                    /* of the transfers, in a row */
+    int muted;                    /* as the microphone reported */
+    int shown;                    /* what the last frame was taken for */
+    struct scene *sc;             /* the muted one, NULL - no watch */
+    const struct scene_step *step;
+    unsigned int frame;           /* of the step, to show next */
+};
+
+/* Functions */
+int mute_watch_open(struct mute_watch *mw, const char *path,
+                                                   unsigned short pid);
+int mute_watch_start(struct mute_watch *mw,
+                     struct libusb_device_handle *handle);
+void mute_watch_stop(struct mute_watch *mw);
+void mute_watch_close(struct mute_watch *mw);
+int mute_watch_changed(struct mute_watch *mw);
+int mute_watch_muted(const struct mute_watch *mw);
+const byte_t *mute_watch_frame(struct mute_watch *mw,
+                               struct libusb_device_handle *handle,
+                               const byte_t *frame);
+int mute_watch_pollfds(const struct mute_watch *mw, struct pollfd *pfds,
+                                                                 int max);
+int mute_report_state(const byte_t *report, int len);
+
+#endif
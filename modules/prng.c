@@ -0,0 +1,54 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File prng.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include "prng.h"
+
+#define PCG_MULT 6364136223846793005ULL
+
+void prng_seed(struct prng *rng, unsigned long seed, unsigned int stream)
+{
+    rng->state = 0;
+    rng->inc = ((uint64_t)stream << 1) | 1;
+    prng_next(rng);
+    rng->state += seed;
+    prng_next(rng);
+}
+
+/* XSH RR output of the PCG family */
+uint32_t prng_next(struct prng *rng)
+{
+    uint64_t old = rng->state;
+    uint32_t xorshifted, rot;
+    rng->state = old*PCG_MULT + rng->inc;
+    xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+    rot = (uint32_t)(old >> 59);
+    return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+}
+
+/* A hexcolor from 0x1 to 0xffffff, never black */
+int prng_color(struct prng *rng)
+{
+    return 1 + (int)(((uint64_t)prng_next(rng) * 0xffffff) >> 32);
+}
@@ -0,0 +1,47 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File prng.h
+ * A small pseudorandom generator (PCG32) for the random colors. Every
+ * user keeps a generator of its own, so the colors depend only on the
+ * seed and the stream, not on the order things are compiled in or on
+ * the threads they are compiled by. The same seed gives the same colors
+ * on any system, unlike rand().
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#ifndef PRNG_SENTRY
+#define PRNG_SENTRY
+
+#include <stdint.h> /* for the 64-bit state */
+
+/* Types */
+struct prng {
+    uint64_t state;
+    uint64_t inc; /* odd, selects one of 2^63 independent streams */
+};
+
+/* Functions */
+void prng_seed(struct prng *rng, unsigned long seed, unsigned int stream);
+uint32_t prng_next(struct prng *rng);
+int prng_color(struct prng *rng);
+
+#endif
@@ -0,0 +1,173 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File reporter.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include <stdio.h> /* for snprintf, puts & fputs */
+#include <string.h> /* for memset */
+#include <time.h> /* for nanosleep */
+#include <pthread.h>
+#include <sched.h> /* for SCHED_OTHER */
+
+#include "service.h" /* for service_notify */
+#include "reporter.h"
+
+/* Types */
+struct reporter { /* one producer, the send loop, and one consumer */
+    struct report ring[REPORT_RING];
+    unsigned int head, tail; /* posted & written, they only go up */
+    int running, stop, verbose;
+    pthread_t tid;
+    void (*drain)(void *); /* see reporter_drain */
+    void *drain_arg;
+};
+
+static struct reporter rep;
+static pthread_mutex_t drain_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *reporter_main(void *arg);
+static void flush_reports();
+static void run_drain();
+static void write_report(const struct report *r);
+
+/* Functions */
+void report_init(struct report *r, const char *fmt)
+{
+    memset(r, 0, sizeof(*r));
+    r->fmt = fmt;
+}
+
+/* The thread doesn't take the real-time profile of the process even if
+ * it is started after rt_enter */
+void reporter_start(int verbose)
+{
+    pthread_attr_t attr;
+    struct sched_param param;
+    if(rep.running)
+        return;
+    rep.verbose = verbose;
+    rep.stop = 0;
+    memset(&param, 0, sizeof(param));
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+    pthread_attr_setschedparam(&attr, &param);
+    rep.running = !pthread_create(&rep.tid, &attr, reporter_main, NULL);
+    pthread_attr_destroy(&attr);
+}
+
+/* Copies r to the ring, nothing else happens in the send loop */
+void reporter_post(const struct report *r)
+{
+    unsigned int head = rep.head;
+    if(!rep.running) {
+        write_report(r);
+        return;
+    }
+    if(head - __atomic_load_n(&rep.tail, __ATOMIC_ACQUIRE) >= REPORT_RING)
+        return;
+    rep.ring[head % REPORT_RING] = *r;
+    __atomic_store_n(&rep.head, head + 1, __ATOMIC_RELEASE);
+}
+
+/* Hooks drain (NULL - none) to the thread, it is called with arg every
+ * tick and at the stop. Once another one is hooked, the old one isn't
+ * running and won't be called again. Returns 0 or 1 if there is no
+ * thread to call it */
+int reporter_drain(void (*drain)(void *), void *arg)
+{
+    pthread_mutex_lock(&drain_lock);
+    rep.drain = rep.running ? drain : NULL;
+    rep.drain_arg = arg;
+    pthread_mutex_unlock(&drain_lock);
+    return drain && !rep.running;
+}
+
+/* Writes what is left in the ring */
+void reporter_stop()
+{
+    if(!rep.running)
+        return;
+    __atomic_store_n(&rep.stop, 1, __ATOMIC_RELEASE);
+    pthread_join(rep.tid, NULL);
+    rep.running = 0;
+    reporter_drain(NULL, NULL);
+}
+
+static void *reporter_main(void *arg)
+{
+    struct timespec tick;
+    int stop;
+    tick.tv_sec = 0;
+    tick.tv_nsec = REPORT_TICK*1000000L;
+    do {
+        stop = __atomic_load_n(&rep.stop, __ATOMIC_ACQUIRE);
+        flush_reports();
+        run_drain();
+        if(!stop)
+            nanosleep(&tick, NULL);
+    } while(!stop);
+    return NULL;
+}
+
+/* A slot is given back once its report is written */
+static void flush_reports()
+{
+    unsigned int tail = rep.tail;
+    while(tail != __atomic_load_n(&rep.head, __ATOMIC_ACQUIRE)) {
+        write_report(&rep.ring[tail % REPORT_RING]);
+        tail++;
+        __atomic_store_n(&rep.tail, tail, __ATOMIC_RELEASE);
+    }
+}
+
+/* The loop never takes the lock, only the ones who hook a drain */
+static void run_drain()
+{
+    pthread_mutex_lock(&drain_lock);
+    if(rep.drain)
+        rep.drain(rep.drain_arg);
+    pthread_mutex_unlock(&drain_lock);
+}
+
+/* Status reports go to the service manager and, if verbose, to the user;
+ * warnings to stderr */
+static void write_report(const struct report *r)
+{
+    char msg[STATUS_REPORT_LEN], state[STATUS_REPORT_LEN+sizeof("STATUS=")];
+    const unsigned long *n = r->num;
+    if(r->str)
+        snprintf(msg, sizeof(msg), r->fmt, r->str,
+                 n[0], n[1], n[2], n[3], n[4], n[5]);
+    else
+        snprintf(msg, sizeof(msg), r->fmt,
+                 n[0], n[1], n[2], n[3], n[4], n[5]);
+    if(r->warn) {
+        fputs(msg, stderr);
+        return;
+    }
+    snprintf(state, sizeof(state), "STATUS=%s", msg);
+    service_notify(state);
+    if(rep.verbose)
+        puts(msg);
+}
@@ -0,0 +1,65 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File reporter.h
+ * The reports of the send loop (the governor, the jitter, the skew of
+ * the clock, the latency of a stream, the retried transfers) leave the
+ * loop as numbers: it puts the message and its counters in a ring that
+ * is allocated beforehand, and a thread of the normal scheduling class
+ * formats them and hands them to the service manager and the user every
+ * REPORT_TICK millisec. So the loop under SCHED_FIFO (see rtprofile.h)
+ * never formats, prints or sends a thing. Reports that find the ring
+ * full are dropped.
+ *
+ * Before reporter_start and after reporter_stop the reports are
+ * written at once, there is no frame loop to keep then.
+ *
+ * Other data the loop leaves in a ring of its own, such as the records
+ * of a capture, are written by the same thread: reporter_drain hooks a
+ * function that it calls every tick.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#ifndef REPORTER_SENTRY
+#define REPORTER_SENTRY
+
+/* Constants */
+#define STATUS_REPORT_LEN 128 /* of the reports for the service manager */
+#define REPORT_NUMS 6
+#define REPORT_RING 16
+#define REPORT_TICK 200 /* millisec */
+
+/* Types */
+struct report {
+    const char *fmt;                 /* takes str if any, then num */
+    const char *str;                 /* a static string or NULL */
+    unsigned long num[REPORT_NUMS];  /* as %lu */
+    int warn;                        /* to stderr, not to the manager */
+};
+
+/* Functions */
+void report_init(struct report *r, const char *fmt);
+void reporter_start(int verbose);
+void reporter_post(const struct report *r);
+int reporter_drain(void (*drain)(void *), void *arg);
+void reporter_stop();
+
+#endif
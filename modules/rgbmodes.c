@@ -24,53 +24,114 @@
  * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
  */
 #include <stdio.h> /* for fprintf & fputs */
-#include <stdlib.h> /* for srand & rand */
-#include <time.h> /* for time */
+#include <stdlib.h> /* for calloc & realloc */
 
 #include "devio.h" /* for QUADCAST_2S_PID */
+#include "timeline.h"
+#include "colorpipe.h"
+#include "ledmap.h"
+#include "prng.h"
+#include "effects.h"
+#include "workpool.h"
+#include "modereg.h"
+#include "dimmer.h"
 
 #include "rgbmodes.h"
 
+#define RENDER_SLICE 128 /* color commands a render task takes at most */
+#define MAX_RENDER_TASKS (2*DIV_CEIL(MAX_COLPAIR_COUNT, RENDER_SLICE))
+#define PARALLEL_MIN_COUNT 512 /* fewer commands render faster in a row */
+#define QS2S_FX_FRAMES 200 /* an effect pass of Quadcast 2S, about 1 s */
+#define QS2S_RENDER_SLICE 32 /* frames */
 
+struct render_task { /* a slice of the frames of a job */
+    const struct render_job *job;
+    int group;           /* upper or lower, all for Quadcast 2S */
+    unsigned long first; /* the first frame of the slice */
+    unsigned long cnt;
+};
 
-static void get_mode_sizes(struct colschemes *cs, int *seq_upper,
-                                                               int *seq_lower);
-static int count_data(struct colscheme *colsch, int pid);
-static int count_2s_data(const struct colscheme *colsch);
-static void fill_data(struct colscheme *colsch, byte_t *da, int pckcnt,
-                                                                    int group);
+struct render_job {
+    struct colschemes cs;
+    struct timeline tls[2];
+    struct prng rngs[2]; /* the random colors of each group */
+    struct effect fxs[2]; /* no step for the groups of timelines */
+    unsigned long pass[2]; /* effect frames shown before the packets */
+    struct colorpipe pipes[2];
+    int has_pipes;
+    int qs2s; /* only effects & solid colors, LED by LED */
+    datpack *da;
+    int pckcnt;
+    unsigned long lower_at; /* bytes before the lower commands, QS only */
+};
+
+
+
+static int get_mode_sizes(struct colschemes *cs, int *seq_upper,
+                                                              int *seq_lower);
+static int count_data(struct colscheme *colsch, int pid, int dither);
+static int count_2s_data(const struct colscheme *colsch, int dither);
+static int queue_render(struct colschemes *cs, datpack **da, int *pckcnt,
+                  const struct colorpipe *pipes, struct render_batch *b);
+static int render_jobs(struct render_batch *b, int group, int threads);
+static void build_timeline(struct colscheme *colsch, int group,
+                      const struct colorpipe *pipe, struct timeline *tl);
 static void fill_qs2s_data(const struct colscheme *colsch, byte_t *da,
-                                                        int pckcnt, int group);
-static void equalize(int upper_size, int lower_size, datpack *da);
-static void fillup_to(size_t copy_size, byte_t *curr, byte_t *finish);
+                    int pckcnt, int group, const struct colorpipe *pipe);
 static void set_brightness(int *color, int br);
+static int levels_at_send(const struct colschemes *cs);
+static int is_effect(const struct colscheme *colsch);
+static unsigned long render_length(const struct render_job *job, int group);
+static int plan_render(const struct render_job *job, int group,
+                                         struct render_task *tasks, int cnt);
+static void render_slice(void *task);
+static void render_qs_slice(const struct render_task *rt);
+static void render_qs2s_slice(const struct render_task *rt);
+static int pipe_color(const struct colorpipe *pipe, int color);
+static void put_ranges(const struct colschemes *cs, byte_t *da, int pckcnt,
+                                         const struct colorpipe *pipe);
+static unsigned int count_group(const byte_t *cmd, const byte_t *end);
+static unsigned long gcd(unsigned long a, unsigned long b);
 
 /* Solid */
-static void sequence_solid(const int *colors, byte_t *da);
-static void sequence_solid_qs2s(const int *colors, byte_t *da, int group);
+static int count_solid_data(struct colscheme *colsch, int dither);
+static void build_solid(struct colscheme *colsch, int group,
+                        const struct colorpipe *pipe, struct timeline *tl);
+static void sequence_solid(const int *colors, int length,
+                                                        struct timeline *tl);
+static void sequence_solid_qs2s(int color, byte_t *da, int group);
+static void sequence_solid_qs2s_dither(int color, byte_t *da, int group,
+                                          const struct colorpipe *pipe);
 static void fill_qs2s_packets_with_color(byte_t *start, int clr, int offset,
                                                                       int cnt);
 /* Blink */
-static unsigned int count_blink_data(struct colscheme *colsch);
-static void sequence_blink_random(int speed, int dly_seg, byte_t *da);
-static void sequence_blink(const struct colscheme *colsch, byte_t *da,
-                                                                   int pckcnt);
-static void blink_segment_fill(int col, int col_seg, int dly_seg, byte_t **da);
-static void color_fill(int color, int size, byte_t **da);
-static int random_color();
+static int count_blink_data(struct colscheme *colsch, int dither);
+static void build_blink(struct colscheme *colsch, int group,
+                        const struct colorpipe *pipe, struct timeline *tl);
+static void sequence_blink_random(int speed, int dly_seg,
+                                                       struct timeline *tl);
+static void sequence_blink(const struct colscheme *colsch,
+                                                       struct timeline *tl);
 /* Cycle */
-static unsigned int count_cycle_data(const struct colscheme *colsch);
+static int count_cycle_data(struct colscheme *colsch, int dither);
+static void build_cycle(struct colscheme *colsch, int group,
+                        const struct colorpipe *pipe, struct timeline *tl);
 static int get_gradient_length(const int *color, int spd);
-static void sequence_cycle(const int *color, int spd, byte_t *da);
-static void write_gradient(byte_t **da, int start_col, int end_col,
-                                                                   int length);
+static void sequence_cycle(const int *color, int spd, struct timeline *tl);
 /* Wave */
-static void sequence_wave(int *color, int spd, int group, byte_t *da);
+static void build_wave(struct colscheme *colsch, int group,
+                       const struct colorpipe *pipe, struct timeline *tl);
+static void sequence_wave(int *color, int spd, int group,
+                                                       struct timeline *tl);
 static void wave_array_shift(int *color);
 /* Lightning & Pulse */
-static unsigned int count_lightning_data(struct colscheme *colsch);
+static int count_lightning_data(struct colscheme *colsch, int dither);
+static void build_lightning(struct colscheme *colsch, int group,
+                        const struct colorpipe *pipe, struct timeline *tl);
+static void build_pulse(struct colscheme *colsch, int group,
+                        const struct colorpipe *pipe, struct timeline *tl);
 static void sequence_lightning(const int *color, int spd, int group,
-                                                  int synchronous, byte_t *da);
+                                       int synchronous, struct timeline *tl);
 static int next_gradient_color(int color, int endcolor, unsigned int size);
 
 /* Shared */
@@ -82,106 +143,418 @@ static unsigned int sizeof_frames(int *color, unsigned int framesize);
 static void print_datpack(datpack *da, int pck_cnt);
 #endif
 
-datpack *parse_colorscheme(struct colschemes *cs, int *pck_cnt)
-{
-    datpack *data_arr = NULL;
-    int seq_upper, seq_lower;
+/* Modes, see modereg.h. The effects are in effects.c */
+const struct rgb_mode solid_mode = {
+    "solid", cap_qs | cap_qs2s, red_colors, count_solid_data, build_solid,
+    NULL, 0, 0
+};
+const struct rgb_mode blink_mode = {
+    "blink", cap_qs, random_colors, count_blink_data, build_blink,
+    NULL, 0, 0
+};
+const struct rgb_mode cycle_mode = {
+    "cycle", cap_qs, rainbow_colors, count_cycle_data, build_cycle,
+    NULL, 0, 0
+};
+const struct rgb_mode wave_mode = {
+    "wave", cap_qs, rainbow_colors, count_cycle_data, build_wave,
+    NULL, 0, 0
+};
+const struct rgb_mode lightning_mode = {
+    "lightning", cap_qs, red_colors, count_lightning_data, build_lightning,
+    NULL, 0, 0
+};
+const struct rgb_mode pulse_mode = {
+    "pulse", cap_qs, red_colors, count_lightning_data, build_pulse,
+    NULL, 0, 0
+};
+const struct rgb_mode visualizer_mode = { /* not supported yet */
+    "visualizer", 0, red_colors, NULL, NULL, NULL, 0, 0
+};
 
-    set_brightness(cs->upper.colors, cs->upper.br);
-    set_brightness(cs->lower.colors, cs->lower.br);
+datpack *parse_colorscheme(const struct colschemes *cs, int *pck_cnt)
+{
+    struct render_batch b;
+    datpack *data_arr;
+    data_arr = stream_colorscheme(cs, pck_cnt, &b);
+    render_batch_free(&b);
+    return data_arr;
+}
 
-    get_mode_sizes(cs, &seq_upper, &seq_lower);
-    *pck_cnt = seq_upper >= seq_lower ? seq_upper : seq_lower;
-    data_arr = calloc(sizeof(datpack), *pck_cnt);
+/* Same as parse_colorscheme, but b keeps what render_batch_redraw needs
+ * to give the packets new random colors; free it with render_batch_free */
+datpack *stream_colorscheme(const struct colschemes *cs, int *pck_cnt,
+                                                struct render_batch *b)
+{
+    datpack *data_arr;
 
-    if(cs->pid == QUADCAST_2S_PID) {
-        fill_qs2s_data(&cs->upper, *data_arr, *pck_cnt, upper);
-        fill_qs2s_data(&cs->lower, *data_arr, *pck_cnt, lower);
-    } else {
-        fill_data(&cs->upper, *data_arr, *pck_cnt, upper);
-        fill_data(&cs->lower, *data_arr+BYTE_STEP, *pck_cnt, lower);
-        equalize(seq_upper, seq_lower, data_arr);
+    render_batch_init(b);
+    data_arr = plan_colorscheme(cs, pck_cnt, b);
+    if(data_arr && render_batch_run(b)) {
+        free(data_arr);
+        *pck_cnt = 0;
+        return NULL;
     }
 
     #ifdef DEBUG
-    print_datpack(data_arr, *pck_cnt);
+    if(data_arr)
+        print_datpack(data_arr, *pck_cnt);
     #endif
 
     return data_arr;
 }
 
-static void get_mode_sizes(struct colschemes *cs, int *seq_upper,
-                                                                int *seq_lower)
+/* Sizes the packets and plans the colorscheme; the packets are complete
+ * only after render_batch_run, so that the colorschemes of a scene are
+ * rendered on the pool all together. The brightness and the sizing work
+ * on a copy of src */
+datpack *plan_colorscheme(const struct colschemes *src, int *pck_cnt,
+                                                struct render_batch *b)
+{
+    datpack *data_arr = NULL;
+    int seq_upper, seq_lower;
+    struct colorpipe pipes[2], *upper_pipe = NULL, *lower_pipe = NULL;
+    struct colschemes copy = *src, *cs = &copy;
+
+    if(levels_at_send(cs)) /* see frame_seq_levels */
+        cs->upper.br = cs->lower.br = MAX_BR_SPD_DLY;
+    if(cs->gamma) { /* brightness is a part of the pipeline */
+        colorpipe_init(pipes, cs->upper.br, cs->wb, cs->dither);
+        colorpipe_init(pipes+1, cs->lower.br, cs->wb, cs->dither);
+        upper_pipe = pipes;
+        lower_pipe = pipes+1;
+    } else {
+        set_brightness(cs->upper.colors, cs->upper.br);
+        set_brightness(cs->lower.colors, cs->lower.br);
+    }
+
+    *pck_cnt = 0;
+    if(get_mode_sizes(cs, &seq_upper, &seq_lower)) {
+        *pck_cnt = -1;
+        return NULL;
+    }
+    if(cs->pid == QUADCAST_2S_PID) {
+        *pck_cnt = seq_upper >= seq_lower ? seq_upper : seq_lower;
+        data_arr = calloc(sizeof(datpack), *pck_cnt);
+        if(!data_arr) {
+            *pck_cnt = 0;
+            return NULL;
+        }
+        fill_qs2s_data(&cs->upper, *data_arr, *pck_cnt, upper, upper_pipe);
+        fill_qs2s_data(&cs->lower, *data_arr, *pck_cnt, lower, lower_pipe);
+        /* effects are rendered later, the ranges go over them then */
+        if(!is_effect(&cs->upper) && !is_effect(&cs->lower)) {
+            put_ranges(cs, *data_arr, *pck_cnt, upper_pipe);
+            return data_arr;
+        }
+    } else if(cs->range_cnt) {
+        fputs(RANGES_NOSUPPORT_MSG, stderr);
+    }
+    /* the commands of Quadcast S are sized by their timelines */
+    if(queue_render(cs, &data_arr, pck_cnt, upper_pipe, b)) {
+        free(data_arr);
+        *pck_cnt = 0;
+        return NULL;
+    }
+    return data_arr;
+}
+
+void render_batch_init(struct render_batch *b)
+{
+    b->jobs = NULL;
+    b->cnt = 0;
+    b->tasks = NULL;
+    b->task_jobs = 0;
+}
+
+/* Renders the frames of every planned colorscheme on the pool. The tasks
+ * are allocated here once for the redraws as well */
+int render_batch_run(struct render_batch *b)
+{
+    struct render_task *tmp;
+    if(b->cnt > b->task_jobs) { /* planned after the last run */
+        tmp = realloc(b->tasks, sizeof(*tmp) * MAX_RENDER_TASKS * b->cnt);
+        if(!tmp)
+            return 1;
+        b->tasks = tmp;
+        b->task_jobs = b->cnt;
+    }
+    return render_jobs(b, all, 0);
+}
+
+/* The groups of Quadcast 2S are rendered together, so group is all;
+ * threads is the one of workpool_run. Allocates nothing */
+static int render_jobs(struct render_batch *b, int group, int threads)
+{
+    struct render_task *tasks = b->tasks;
+    unsigned long total = 0;
+    int cnt = 0, i;
+
+    if(b->cnt > b->task_jobs) /* not run yet */
+        return 1;
+    for(i = 0; i < b->cnt; i++) {
+        if(b->jobs[i]->qs2s) {
+            cnt = plan_render(b->jobs[i], all, tasks, cnt);
+        } else {
+            if(group != lower)
+                cnt = plan_render(b->jobs[i], upper, tasks, cnt);
+            if(group != upper)
+                cnt = plan_render(b->jobs[i], lower, tasks, cnt);
+        }
+    }
+    for(i = 0; i < cnt; i++) /* a 2S frame is worth a command per LED */
+        total += tasks[i].cnt * (tasks[i].job->qs2s ? 2*QS2S_GROUP_LEDS : 1);
+    if(total < PARALLEL_MIN_COUNT)
+        threads = 1;
+    workpool_run(render_slice, tasks, sizeof(*tasks), cnt, threads);
+    for(i = 0; i < b->cnt; i++) {
+        struct render_job *job = b->jobs[i];
+        if(job->qs2s)
+            put_ranges(&job->cs, *job->da, job->pckcnt,
+                                       job->has_pipes ? job->pipes : NULL);
+    }
+    return 0;
+}
+
+/* Draws the random colors and the effects of the pass of group that
+ * comes passes passes after the rendered one (1 - the next pass) and
+ * renders them; the generators and effects go on from where they
+ * stopped, so the colors never repeat. The groups of Quadcast S have
+ * passes of their own, those of 2S are redrawn with group all. Returns 0
+ * if there is nothing to redraw or the commands couldn't be rendered
+ * (they stay the same then). It's called by the send loop, which may run
+ * under SCHED_FIFO (see rtprofile.h), so it renders in the calling
+ * thread with the tasks of render_batch_run: no thread is started and
+ * nothing is allocated */
+int render_batch_redraw(struct render_batch *b, int group,
+                                             unsigned long passes)
 {
-    *seq_upper = count_data(&cs->upper, cs->pid);
-    *seq_lower = count_data(&cs->lower, cs->pid);
+    unsigned long pass;
+    int i, g, drawn = 0;
+    for(i = 0; i < b->cnt; i++) {
+        struct render_job *job = b->jobs[i];
+        for(g = 0; g < 2; g++) {
+            int grp = job->qs2s ? all : (g ? lower : upper);
+            if(group != all && group != grp)
+                continue;
+            if(job->fxs[g].step) {
+                job->pass[g] += passes * render_length(job, grp);
+                drawn++;
+            }
+            if(job->qs2s)
+                continue;
+            for(pass = 0; pass < passes; pass++) {
+                int cnt = timeline_draw(job->tls + g,
+                                  render_length(job, grp), job->rngs + g);
+                if(!cnt) /* nothing random */
+                    break;
+                drawn += cnt;
+            }
+        }
+    }
+    return drawn && !render_jobs(b, group, 1);
+}
+
+/* Whether render_batch_redraw gives other frames, so that a pass can't be
+ * told from the one before it */
+int render_batch_varies(const struct render_batch *b)
+{
+    unsigned int seg;
+    int i, g;
+    for(i = 0; i < b->cnt; i++) {
+        const struct render_job *job = b->jobs[i];
+        for(g = 0; g < 2; g++) {
+            if(job->fxs[g].step)
+                return 1;
+            for(seg = 0; seg < job->tls[g].seg_cnt; seg++) {
+                if(job->tls[g].segs[seg].type == seg_random)
+                    return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* The packets of the jobs stay with the callers of plan_colorscheme */
+void render_batch_free(struct render_batch *b)
+{
+    int i;
+    for(i = 0; i < b->cnt; i++)
+        free(b->jobs[i]);
+    free(b->jobs);
+    free(b->tasks);
+    render_batch_init(b);
+}
+
+static int get_mode_sizes(struct colschemes *cs, int *seq_upper,
+                                                               int *seq_lower)
+{
+    *seq_upper = count_data(&cs->upper, cs->pid, cs->dither);
+    *seq_lower = count_data(&cs->lower, cs->pid, cs->dither);
     if(*seq_upper < 1 || *seq_lower < 1) {
         if (cs->pid == QUADCAST_2S_PID)
-            printf(QS_2S_NOSUPPORT_MSG, cs->upper.mode);
+            printf(QS_2S_NOSUPPORT_MSG, cs->upper.mode->name);
         else
             puts(NOSUPPORT_MSG);
-        exit(254);
+        return 1;
     }
+    return 0;
 }
 
-short count_color_commands(const datpack *data_arr, int pck_cnt, int colgroup)
+/* Reads the frames of data_arr, see struct frame_seq */
+void frame_seq_init(struct frame_seq *seq, const datpack *data_arr,
+                                       int pck_cnt, unsigned short pid)
 {
-    short cnt, step = 0;
-    const byte_t *b;
-    if(colgroup) /* case of lower color commands */
-        step = BYTE_STEP;
-    cnt = (pck_cnt-1)*8;
-    for(b = data_arr[pck_cnt-1]; b < data_arr[pck_cnt-1]+DATA_PACKET_SIZE;
-                                                         b += 2*BYTE_STEP) {
-        if(*(b+step) != RGB_CODE)
-            break;
-        cnt++;
+    const byte_t *end = *data_arr + pck_cnt*DATA_PACKET_SIZE;
+    if(pid == QUADCAST_2S_PID) {
+        frame_seq_whole(seq, *data_arr, pck_cnt / QS2S_SOLID_PKT_CNT, pid);
+        return;
     }
-    return cnt;
+    seq->data = *data_arr;
+    seq->len[0] = count_group(seq->data, end);
+    seq->lower = seq->data + (seq->len[0]+1)*BYTE_STEP;
+    seq->len[1] = count_group(seq->lower, end);
+    seq->period = (unsigned long)seq->len[0] / gcd(seq->len[0], seq->len[1])
+                                                             * seq->len[1];
+    seq->frame_size = QS_FRAME_SIZE;
+    seq->leveled = 0;
 }
 
-static int count_data(struct colscheme *colsch, int pid)
+/* Frames that follow one another, e.g. the ones of a scene */
+void frame_seq_whole(struct frame_seq *seq, const byte_t *frames,
+                                    unsigned int cnt, unsigned short pid)
 {
-    if(pid == QUADCAST_2S_PID) /* the protocol is different for this one */
-        return count_2s_data(colsch);
+    seq->data = frames;
+    seq->lower = NULL;
+    seq->len[0] = seq->len[1] = cnt;
+    seq->period = cnt;
+    seq->frame_size = FRAME_SIZE(pid);
+    seq->leveled = 0;
+}
 
-    if(strequ(colsch->mode, "solid")) {
-        return 1;
-    } else if(strequ(colsch->mode, "blink")) {
-        return count_blink_data(colsch);
-    } else if(strequ(colsch->mode, "cycle") || strequ(colsch->mode, "wave")) {
-        return count_cycle_data(colsch);
-    } else if(strequ(colsch->mode, "lightning") ||
-              strequ(colsch->mode, "pulse")) {
-        return count_lightning_data(colsch);
+/* The -b of a colorscheme planned with br_at_send: frame_seq_get puts
+ * the table of each group over its own command, so one plan serves any
+ * level. Quadcast 2S keeps -b in its frames, as the ranges there go over
+ * both groups with the level of the upper one; so does --dither, whose
+ * carried errors would be cut anew by a table */
+void frame_seq_levels(struct frame_seq *seq, const struct colschemes *cs)
+{
+    if(!seq->lower || !levels_at_send(cs))
+        return;
+    dimmer_level(seq->levels[0], cs->upper.br, cs->gamma);
+    dimmer_level(seq->levels[1], cs->lower.br, cs->gamma);
+    seq->leveled = 1;
+}
+
+/* Any frame number goes, the groups wrap around on their own. The frames
+ * of Quadcast S are put together in buf (QS_FRAME_SIZE bytes), each
+ * group at its own level once frame_seq_levels has set them */
+const byte_t *frame_seq_get(const struct frame_seq *seq,
+                            unsigned long long frame, byte_t *buf)
+{
+    unsigned int i;
+    if(!seq->lower)
+        return seq->data + (frame % seq->len[0])*seq->frame_size;
+    memcpy(buf, seq->data + (frame % seq->len[0])*BYTE_STEP, BYTE_STEP);
+    memcpy(buf+BYTE_STEP, seq->lower + (frame % seq->len[1])*BYTE_STEP,
+                                                               BYTE_STEP);
+    for(i = 0; seq->leveled && i < QS_FRAME_SIZE; i++) {
+        if(i % BYTE_STEP != 0) /* skip RGB_CODE */
+            buf[i] = seq->levels[i / BYTE_STEP][buf[i]];
     }
-    return -1;
+    return buf;
+}
+
+void frame_seq_copy(const struct frame_seq *seq, unsigned long long frame,
+                                                               byte_t *out)
+{
+    const byte_t *src = frame_seq_get(seq, frame, out);
+    if(src != out)
+        memcpy(out, src, seq->frame_size);
 }
 
-static int count_2s_data(const struct colscheme *colsch)
+/* Mixes the colors of two frames in fixed point, weight is the part of to
+ * in 1/256ths (0-256); the codes are taken from to. The groups of
+ * Quadcast S and the LEDs of 2S are mixed each on their own */
+void frame_blend(const byte_t *from, const byte_t *to, unsigned int weight,
+                 byte_t *out, unsigned short pid)
 {
-    if(strequ(colsch->mode, "solid")) {
-        /* 6 packets for theoretical 140 LEDs where 108 are actually used */
-        return 6;
+    unsigned int i, size, color;
+    size = pid == QUADCAST_2S_PID ? QS2S_FRAME_SIZE : QS_FRAME_SIZE;
+    if(weight > FRAME_BLEND_ONE)
+        weight = FRAME_BLEND_ONE;
+    for(i = 0; i < size; i++) {
+        color = pid == QUADCAST_2S_PID ?
+                i % DATA_PACKET_SIZE >= QS2S_PCT_HEADER : i % BYTE_STEP != 0;
+        out[i] = !color ? to[i] : (from[i]*(FRAME_BLEND_ONE - weight) +
+                                   to[i]*weight + FRAME_BLEND_ONE/2) >> 8;
     }
-    return -1;
 }
 
-static unsigned int count_blink_data(struct colscheme *colsch)
+/* Frames to store for a sequence that must follow one another (scenes,
+ * --save): both groups loop in them unless that takes more than
+ * MAX_FLAT_FRAMES, then the shorter group is cut off at the end of the
+ * longer one */
+unsigned int frame_seq_flat_count(const struct frame_seq *seq)
+{
+    if(seq->period <= MAX_FLAT_FRAMES)
+        return seq->period;
+    return seq->len[0] > seq->len[1] ? seq->len[0] : seq->len[1];
+}
+
+void frame_seq_flatten(const struct frame_seq *seq, byte_t *out,
+                                                    unsigned int cnt)
+{
+    unsigned int frame;
+    for(frame = 0; frame < cnt; frame++)
+        frame_seq_copy(seq, frame, out + frame*seq->frame_size);
+}
+
+/* Returns -1 if the mode doesn't work with the protocol of pid */
+static int count_data(struct colscheme *colsch, int pid, int dither)
+{
+    const struct rgb_mode *md = colsch->mode;
+    if(pid == QUADCAST_2S_PID) /* the protocol is different for this one */
+        return count_2s_data(colsch, dither);
+    if(!(md->caps & cap_qs))
+        return -1;
+    if(md->step) /* a pass, the next ones are redrawn */
+        return MAX_PCT_COUNT;
+    return md->size(colsch, dither);
+}
+
+static int count_2s_data(const struct colscheme *colsch, int dither)
+{
+    const struct rgb_mode *md = colsch->mode;
+    if(!(md->caps & cap_qs2s))
+        return -1;
+    if(md->step)
+        return QS2S_SOLID_PKT_CNT * QS2S_FX_FRAMES;
+    /* a still color; 6 packets for theoretical 140 LEDs where 108 are
+     * actually used */
+    return QS2S_SOLID_PKT_CNT * (dither ? DITHER_FRAMES : 1);
+}
+
+static int count_solid_data(struct colscheme *colsch, int dither)
+{
+    if(dither) /* a still color needs frames to be dithered over */
+        return DIV_CEIL(DITHER_FRAMES, COLPAIR_PER_PCT);
+    return 1;
+}
+
+static int count_blink_data(struct colscheme *colsch, int dither)
 {
     unsigned int frame, size = 0;
 
-    if(colsch->colors[0] == nocolor) { /* case of random colors */
-        srand(time(NULL)); /* random seed (must be done only once) */
+    if(colsch->colors[0] == nocolor) /* case of random colors */
         return MAX_PCT_COUNT;
-    }
 
     frame = 101-colsch->spd + colsch->dly;
     size = sizeof_frames(colsch->colors, frame);
     return DIV_CEIL(size, COLPAIR_PER_PCT);
 }
 
-static unsigned int count_cycle_data(const struct colscheme *colsch)
+static int count_cycle_data(struct colscheme *colsch, int dither)
 {
     unsigned int size;
     /* The size of one gradient: */
@@ -193,7 +566,7 @@ static unsigned int count_cycle_data(const struct colscheme *colsch)
     return DIV_CEIL(size, COLPAIR_PER_PCT);
 }
 
-static unsigned int count_lightning_data(struct colscheme *colsch)
+static int count_lightning_data(struct colscheme *colsch, int dither)
 {
     unsigned int frame, size = 0;
     frame = SPEED_RANGE(MIN_LGHT_BL, MAX_LGHT_BL, colsch->spd) +
@@ -220,40 +593,239 @@ static unsigned int colarr_len(const int *arr)
     return cnt;
 }
 
-static void fill_data(struct colscheme *colsch, byte_t *da, int pckcnt,
-                                                                     int group)
+/* The timelines of both groups are built and their random colors are
+ * drawn right away; each group has its own generator, seeded from the
+ * colorscheme, and so do the effects */
+static int queue_render(struct colschemes *cs, datpack **da, int *pckcnt,
+                   const struct colorpipe *pipes, struct render_batch *b)
 {
-    if(strequ(colsch->mode, "solid")) {
-        sequence_solid(colsch->colors, da);
-    } else if(strequ(colsch->mode, "blink")) {
-        if(colsch->colors[0] == nocolor)
-            sequence_blink_random(colsch->spd, colsch->dly, da);
-        else
-            sequence_blink(colsch, da, pckcnt);
-    } else if(strequ(colsch->mode, "cycle")) {
-        sequence_cycle(colsch->colors, colsch->spd, da);
-    } else if(strequ(colsch->mode, "wave")) {
-        sequence_wave(colsch->colors, colsch->spd, group, da);
-    } else if(strequ(colsch->mode, "lightning")) {
-        sequence_lightning(colsch->colors, colsch->spd, group, 0, da);
-    } else if(strequ(colsch->mode, "pulse")) {
-        sequence_lightning(colsch->colors, colsch->spd, group, 1, da);
+    struct render_job *job, **tmp;
+    tmp = realloc(b->jobs, sizeof(*tmp) * (b->cnt+1));
+    if(!tmp)
+        return 1;
+    b->jobs = tmp;
+    job = malloc(sizeof(*job));
+    if(!job)
+        return 1;
+    job->cs = *cs;
+    job->has_pipes = pipes != NULL;
+    if(pipes) {
+        job->pipes[0] = pipes[0];
+        job->pipes[1] = pipes[1];
     }
+    job->qs2s = cs->pid == QUADCAST_2S_PID;
+    job->pckcnt = *pckcnt;
+    job->pass[0] = job->pass[1] = 0;
+    job->fxs[0].step = job->fxs[1].step = NULL;
+    if(is_effect(&cs->upper))
+        effect_init(job->fxs, &cs->upper, cs->seed, upper,
+                                                    FRAME_PERIOD(cs->pid));
+    if(is_effect(&cs->lower))
+        effect_init(job->fxs+1, &cs->lower, cs->seed, lower,
+                                                    FRAME_PERIOD(cs->pid));
+    if(!job->qs2s) {
+        build_timeline(&cs->upper, upper,
+                            job->has_pipes ? job->pipes : NULL, job->tls);
+        build_timeline(&cs->lower, lower,
+                        job->has_pipes ? job->pipes+1 : NULL, job->tls+1);
+        prng_seed(job->rngs, cs->seed, upper);
+        prng_seed(job->rngs+1, cs->seed, lower);
+        timeline_draw(job->tls, render_length(job, upper), job->rngs);
+        timeline_draw(job->tls+1, render_length(job, lower), job->rngs+1);
+        /* the upper commands, a blank one, the lower commands */
+        job->lower_at = (render_length(job, upper) + 1)*BYTE_STEP;
+        job->pckcnt = DIV_CEIL(job->lower_at +
+                   render_length(job, lower)*BYTE_STEP, DATA_PACKET_SIZE);
+        *da = calloc(sizeof(datpack), job->pckcnt);
+        if(!*da) {
+            free(job);
+            return 1;
+        }
+        *pckcnt = job->pckcnt;
+    }
+    job->da = *da;
+    b->jobs[b->cnt++] = job;
+    return 0;
+}
+
+static void build_timeline(struct colscheme *colsch, int group,
+                       const struct colorpipe *pipe, struct timeline *tl)
+{
+    timeline_init(tl);
+    if(colsch->mode->sequence) /* the modes that step have none */
+        colsch->mode->sequence(colsch, group, pipe, tl);
+}
+
+static int is_effect(const struct colscheme *colsch)
+{
+    return colsch->mode->step != NULL;
+}
+
+/* Frames of a group to render, an effect pass is the longest a group
+ * of Quadcast S may get */
+static unsigned long render_length(const struct render_job *job, int group)
+{
+    unsigned long len;
+    if(job->qs2s)
+        return job->pckcnt / QS2S_SOLID_PKT_CNT;
+    if(job->fxs[group == lower].step)
+        return MAX_COLPAIR_COUNT;
+    len = timeline_length(job->tls + (group == lower));
+    return len > MAX_COLPAIR_COUNT ? MAX_COLPAIR_COUNT : len;
+}
+
+/* Adds the slices of a group to tasks[cnt] on, returns the new count.
+ * Dithering carries the error from frame to frame, so such a group
+ * isn't split */
+static int plan_render(const struct render_job *job, int group,
+                                         struct render_task *tasks, int cnt)
+{
+    unsigned long len, first, slice;
+    len = render_length(job, group);
+    if(job->qs2s)
+        slice = QS2S_RENDER_SLICE;
+    else if(job->has_pipes && job->pipes[group == lower].dither)
+        slice = len;
+    else
+        slice = RENDER_SLICE;
+    for(first = 0; first < len; first += slice, cnt++) {
+        tasks[cnt].job = job;
+        tasks[cnt].group = group;
+        tasks[cnt].first = first;
+        tasks[cnt].cnt = (len - first < slice) ? len - first : slice;
+    }
+    return cnt;
+}
+
+static void render_slice(void *task)
+{
+    const struct render_task *rt = task;
+    if(rt->job->qs2s)
+        render_qs2s_slice(rt);
+    else
+        render_qs_slice(rt);
+}
+
+static void render_qs_slice(const struct render_task *rt)
+{
+    const struct render_job *job = rt->job;
+    const struct colorpipe *pipe = NULL;
+    const struct effect *fx = NULL;
+    struct tl_cursor cur;
+    struct dither dth;
+    unsigned long frame;
+    unsigned short lin[3];
+    int g = (rt->group == lower), color = 0;
+    byte_t *da = *job->da + (g ? job->lower_at : 0) + rt->first*BYTE_STEP;
+    if(job->has_pipes)
+        pipe = job->pipes + g;
+    if(job->fxs[g].step) {
+        fx = job->fxs + g;
+    } else {
+        tl_cursor_init(&cur, job->tls + g);
+        tl_cursor_seek(&cur, rt->first);
+    }
+    dither_init(&dth, 0); /* dithered groups are a single slice */
+    for(frame = rt->first; frame < rt->first + rt->cnt; frame++) {
+        if(fx) {
+            color = effect_color(fx, job->pass[g] + frame, 0);
+            if(pipe)
+                colorpipe_decode(color, lin);
+        } else if(pipe) {
+            tl_cursor_next_lin(&cur, lin);
+        } else {
+            color = tl_cursor_next(&cur);
+        }
+        if(pipe && pipe->dither)
+            color = colorpipe_encode_dither(pipe, lin, &dth);
+        else if(pipe)
+            color = colorpipe_encode(pipe, lin);
+        *da = RGB_CODE;
+        write_hexcolor(color, da+1);
+        da += BYTE_STEP;
+    }
+}
+
+/* Both groups frame by frame, the lower one goes over the LEDs they
+ * share. Solid colors aren't dithered next to an effect */
+static void render_qs2s_slice(const struct render_task *rt)
+{
+    const struct render_job *job = rt->job;
+    const struct colscheme *colsch;
+    const struct colorpipe *pipe;
+    unsigned long frame;
+    int g, led, first, color;
+    for(frame = rt->first; frame < rt->first + rt->cnt; frame++) {
+        byte_t *frame_start = *job->da + frame*QS2S_FRAME_SIZE;
+        for(g = 0; g < 2; g++) {
+            colsch = g ? &job->cs.lower : &job->cs.upper;
+            pipe = job->has_pipes ? job->pipes + g : NULL;
+            first = g ? QS2S_LOWER_FIRST : QS2S_UPPER_FIRST;
+            for(led = first; led < first + QS2S_GROUP_LEDS; led++) {
+                if(job->fxs[g].step)
+                    color = effect_color(job->fxs + g,
+                                             job->pass[g] + frame, led);
+                else
+                    color = colsch->colors[0];
+                write_hexcolor(pipe_color(pipe, color),
+                                          qs2s_led(frame_start, led));
+            }
+        }
+    }
+}
+
+static int pipe_color(const struct colorpipe *pipe, int color)
+{
+    unsigned short lin[3];
+    if(!pipe)
+        return color;
+    colorpipe_decode(color, lin);
+    return colorpipe_encode(pipe, lin);
 }
 
 static void fill_qs2s_data(const struct colscheme *colsch, byte_t *da,
-                                                         int pckcnt, int group)
+                    int pckcnt, int group, const struct colorpipe *pipe)
 {
     int pcknum = 0;
 
-    for(; pcknum < pckcnt; pcknum++) {
-        da[pcknum*DATA_PACKET_SIZE] = QS2S_DISPLAY_CODE;
-        da[pcknum*DATA_PACKET_SIZE+1] = QS2S_RGB_PACKET_CODE;
-        da[pcknum*DATA_PACKET_SIZE+2] = pcknum;
+    for(; pcknum < pckcnt; pcknum += QS2S_SOLID_PKT_CNT) /* frames */
+        qs2s_frame_headers(da + pcknum*DATA_PACKET_SIZE);
+
+    if(!is_effect(colsch)) { /* a still color */
+        if(pipe && pipe->dither)
+            sequence_solid_qs2s_dither(colsch->colors[0], da, group, pipe);
+        else
+            sequence_solid_qs2s(pipe_color(pipe, colsch->colors[0]), da,
+                                                                     group);
     }
+}
+
+/* Ranges take the brightness of the upper group; the effects of 2S put
+ * them over each pass again, so the stored colors stay as they are */
+static void put_ranges(const struct colschemes *cs, byte_t *da, int pckcnt,
+                                          const struct colorpipe *pipe)
+{
+    struct ledframe lf;
+    const struct ledrange *rng;
+    int pcknum, cols[MAX_RANGES][3];
 
-    if(strequ(colsch->mode, "solid"))
-        sequence_solid_qs2s(colsch->colors, da, group);
+    for(rng = cs->ranges; rng < cs->ranges+cs->range_cnt; rng++) {
+        int *c = cols[rng - cs->ranges];
+        c[0] = rng->start; c[1] = rng->end; c[2] = nocolor;
+        if(!pipe)
+            set_brightness(c, cs->upper.br);
+    }
+    for(pcknum = 0; pcknum < pckcnt; pcknum += QS2S_SOLID_PKT_CNT) {
+        lf.data = da + pcknum*DATA_PACKET_SIZE;
+        lf.dirty = 0;
+        for(rng = cs->ranges; rng < cs->ranges+cs->range_cnt; rng++) {
+            const int *c = cols[rng - cs->ranges];
+            if(rng->end == nocolor)
+                led_fill(&lf, rng->first, rng->last, pipe_color(pipe, c[0]));
+            else
+                led_gradient(&lf, rng->first, rng->last, c[0], c[1], pipe);
+        }
+    }
 }
 
 static void set_brightness(int *color, int br) 
@@ -269,46 +841,71 @@ static void set_brightness(int *color, int br)
     }
 }
 
-static void equalize(int upper_size, int lower_size, datpack *da)
+static int levels_at_send(const struct colschemes *cs)
 {
-    enum { upper = 0, lower };
-    byte_t *upper_end, *lower_end;
-    upper_size = count_color_commands(da, upper_size, upper);
-    lower_size = count_color_commands(da, lower_size, lower);
-    upper_end = *da + 2*BYTE_STEP*(upper_size-1);
-    lower_end = *da + 2*BYTE_STEP*(lower_size-1) + BYTE_STEP;
+    return cs->br_at_send && cs->pid != QUADCAST_2S_PID && !cs->dither;
+}
 
-    if(upper_size < lower_size) {
-        fillup_to(upper_size, upper_end+2*BYTE_STEP, lower_end-BYTE_STEP);
-    } else if(lower_size < upper_size) {
-        fillup_to(lower_size, lower_end+2*BYTE_STEP, upper_end+BYTE_STEP);
-    } /* else equalizing isn't needed */
+/* Color commands of a group, they end with a blank one */
+static unsigned int count_group(const byte_t *cmd, const byte_t *end)
+{
+    unsigned int cnt = 0;
+    for(; cmd < end && *cmd == RGB_CODE; cmd += BYTE_STEP)
+        cnt++;
+    return cnt;
 }
 
-static void fillup_to(size_t copy_size, byte_t *curr, byte_t *finish)
+static unsigned long gcd(unsigned long a, unsigned long b)
 {
-    while(curr <= finish) {
-        memcpy(curr, curr-(2*BYTE_STEP*copy_size), BYTE_STEP);
-        curr += 2*BYTE_STEP;
+    while(b) {
+        unsigned long r = a % b;
+        a = b;
+        b = r;
     }
+    return a;
 }
 
 /* Mode-related functions */
-static void sequence_solid(const int *colors, byte_t *da)
+static void build_solid(struct colscheme *colsch, int group,
+                        const struct colorpipe *pipe, struct timeline *tl)
+{
+    sequence_solid(colsch->colors,
+                   (pipe && pipe->dither) ? DITHER_FRAMES : 1, tl);
+}
+
+static void sequence_solid(const int *colors, int length,
+                                                         struct timeline *tl)
 {
-    *da = RGB_CODE; /* write code to the first byte */
-    write_hexcolor(*colors, da+1); /* write RGB */
+    timeline_add(tl, seg_hold, *colors, *colors, length);
 }
 
-static void sequence_solid_qs2s(const int *colors, byte_t *da, int group)
+static void sequence_solid_qs2s(int color, byte_t *da, int group)
 {
     if(group == upper)
-        fill_qs2s_packets_with_color(da, colors[0], 0, QS2S_LED_CNT/2);
+        fill_qs2s_packets_with_color(da, color, 0, QS2S_LED_CNT/2);
     else if(group == lower)
-        fill_qs2s_packets_with_color(da+2*DATA_PACKET_SIZE, colors[0], 14,
+        fill_qs2s_packets_with_color(da+2*DATA_PACKET_SIZE, color, 14,
                                                                QS2S_LED_CNT/2);
 }
 
+static void sequence_solid_qs2s_dither(int color, byte_t *da, int group,
+                                           const struct colorpipe *pipe)
+{
+    struct dither dth;
+    unsigned short lin[3];
+    int first, led, frame;
+    first = (group == upper) ? QS2S_UPPER_FIRST : QS2S_LOWER_FIRST;
+    colorpipe_decode(color, lin);
+    for(led = first; led < first + QS2S_GROUP_LEDS; led++) {
+        dither_init(&dth, led);
+        for(frame = 0; frame < DITHER_FRAMES; frame++) {
+            byte_t *frame_start = da + frame*QS2S_FRAME_SIZE;
+            write_hexcolor(colorpipe_encode_dither(pipe, lin, &dth),
+                                                qs2s_led(frame_start, led));
+        }
+    }
+}
+
 static void fill_qs2s_packets_with_color(byte_t *start, int clr, int offset,
                                                                        int cnt)
 {
@@ -323,7 +920,16 @@ static void fill_qs2s_packets_with_color(byte_t *start, int clr, int offset,
     }
 }
 
-static void sequence_blink_random(int speed, int delay, byte_t *da)
+static void build_blink(struct colscheme *colsch, int group,
+                        const struct colorpipe *pipe, struct timeline *tl)
+{
+    if(colsch->colors[0] == nocolor)
+        sequence_blink_random(colsch->spd, colsch->dly, tl);
+    else
+        sequence_blink(colsch, tl);
+}
+
+static void sequence_blink_random(int speed, int delay, struct timeline *tl)
 {
     int colpair = 0;
     int col_seg, dly_seg;
@@ -337,26 +943,29 @@ static void sequence_blink_random(int speed, int delay, byte_t *da)
         colpair += col_seg + dly_seg;
         if(colpair > MAX_COLPAIR_COUNT) /* strip color segment if overflow */
             col_seg -= colpair - MAX_COLPAIR_COUNT;
-        blink_segment_fill(random_color(), col_seg, dly_seg, &da);
+        timeline_add(tl, seg_random, black, black, col_seg);
+        timeline_add(tl, seg_hold, black, black, dly_seg);
     }
 }
 
-static void sequence_blink(const struct colscheme *colsch, byte_t *da,
-                           int pckcnt)
+static void sequence_blink(const struct colscheme *colsch,
+                                                        struct timeline *tl)
 {
     const int *col;
     int col_seg = 101 - colsch->spd;
-    for(col = colsch->colors; *col != nocolor; col++)
-        blink_segment_fill(*col, col_seg, colsch->dly, &da);
+    for(col = colsch->colors; *col != nocolor; col++) {
+        timeline_add(tl, seg_hold, *col, *col, col_seg);
+        timeline_add(tl, seg_hold, black, black, colsch->dly);
+    }
 }
 
-static void blink_segment_fill(int col, int col_seg, int dly_seg, byte_t **da)
+static void build_cycle(struct colscheme *colsch, int group,
+                        const struct colorpipe *pipe, struct timeline *tl)
 {
-    color_fill(col, col_seg, da);
-    color_fill(black, dly_seg, da);
+    sequence_cycle(colsch->colors, colsch->spd, tl);
 }
 
-static void sequence_cycle(const int *color, int spd, byte_t *da)
+static void sequence_cycle(const int *color, int spd, struct timeline *tl)
 {
     const int *first_col;
     int tr_length;
@@ -371,7 +980,7 @@ static void sequence_cycle(const int *color, int spd, byte_t *da)
         else
             tr_end = *(color+1);
 
-        write_gradient(&da, tr_start, tr_end, tr_length);
+        timeline_add(tl, seg_linear, tr_start, tr_end, tr_length);
     }
 }
 
@@ -388,36 +997,19 @@ static int get_gradient_length(const int *color, int spd)
     return tr_size;
 }
 
-static void write_gradient(byte_t **da, int start_col, int end_col, int length)
+static void build_wave(struct colscheme *colsch, int group,
+                       const struct colorpipe *pipe, struct timeline *tl)
 {
-    byte_t rgb_st[3], rgb_end[3], rgb_curr[3];
-    int shift, i;
-    /* Fill the arrays */
-    for(shift = 16, i = 0; shift >= 0; shift -= 8, i++) {
-        rgb_st[i] = (byte_t)((start_col >> shift) & 0xff);
-        rgb_end[i] = (byte_t)((end_col >> shift) & 0xff);
-        rgb_curr[i] = rgb_st[i]; /* the start is going to be the 1st rgb */
-    }
-    /* Write the transition to *da */
-    for(i = 1; i <= length; i++, *da += BYTE_STEP) {
-        int j;
-        **da = RGB_CODE;
-        (*da)++;
-        for(j = 0; j < 3; j++, (*da)++) {
-            **da = rgb_curr[j]; /* write R, G, or B */
-            /* Alter the first RGB depending on the second and the length */
-            rgb_curr[j] = (int)(rgb_st[j] +
-                          ((float)(i)/(length - 1))*(rgb_end[j] - rgb_st[j]));
-        }
-    }
+    sequence_wave(colsch->colors, colsch->spd, group, tl);
 }
 
-static void sequence_wave(int *color, int spd, int group, byte_t *da)
+static void sequence_wave(int *color, int spd, int group,
+                                                        struct timeline *tl)
 {
     if(group == lower)
         wave_array_shift(color);
     /* Just do the same as in the Cycle mode */
-    sequence_cycle(color, spd, da);
+    sequence_cycle(color, spd, tl);
 }
 
 static void wave_array_shift(int *color)
@@ -429,8 +1021,20 @@ static void wave_array_shift(int *color)
     *(tmp) = first;
 }
 
+static void build_lightning(struct colscheme *colsch, int group,
+                        const struct colorpipe *pipe, struct timeline *tl)
+{
+    sequence_lightning(colsch->colors, colsch->spd, group, 0, tl);
+}
+
+static void build_pulse(struct colscheme *colsch, int group,
+                        const struct colorpipe *pipe, struct timeline *tl)
+{
+    sequence_lightning(colsch->colors, colsch->spd, group, 1, tl);
+}
+
 static void sequence_lightning(const int *color, int spd, int group,
-                               int synchronous, byte_t *da)
+                               int synchronous, struct timeline *tl)
 {
     unsigned int bl_size, up, down; /* the sizes of sections */
     bl_size = SPEED_RANGE(MIN_LGHT_BL, MAX_LGHT_BL, spd);
@@ -438,12 +1042,12 @@ static void sequence_lightning(const int *color, int spd, int group,
     down = SPEED_RANGE(MIN_LGHT_DOWN, MAX_LGHT_DOWN, spd);
     for(; *color != nocolor; color++) {
         if(group == lower && !synchronous)
-            color_fill(black, bl_size, &da);
-        write_gradient(&da, black, *color, up);
-        write_gradient(&da, next_gradient_color(*color, black, down), black,
-                       down);
+            timeline_add(tl, seg_hold, black, black, bl_size);
+        timeline_add(tl, seg_linear, black, *color, up);
+        timeline_add(tl, seg_linear, next_gradient_color(*color, black, down),
+                     black, down);
         if(group == upper || synchronous)
-            color_fill(black, bl_size, &da);
+            timeline_add(tl, seg_hold, black, black, bl_size);
     }
 }
 
@@ -463,12 +1067,6 @@ static int next_gradient_color(int color, int endcolor, unsigned int size)
     return nextcolor;
 }
 
-static int random_color()
-{
-    /* Generates a pseudorandom number from 0x1 to 0xffffff */
-    return 1 + (int)(16777215.0*rand()/(RAND_MAX+1.0));
-}
-
 static void write_hexcolor(int color, byte_t *mem)
 {
     int n;
@@ -478,14 +1076,6 @@ static void write_hexcolor(int color, byte_t *mem)
     }
 }
 
-static void color_fill(int color, int size, byte_t **da)
-{
-    for(; size > 0; size--, *da += 2*BYTE_STEP) {
-        **da = RGB_CODE;
-        write_hexcolor(color, (*da)+1);
-    }
-}
-
 #ifdef DEBUG
 static void print_datpack(datpack *da, int pck_cnt)
 {
@@ -1,7 +1,11 @@
 /* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
  * File rgbmodes.h
  * Assembles data packets from "colorschemes" structure.
- * parse_colorscheme returns pointer to the array of data packets.
+ * parse_colorscheme returns pointer to the array of data packets or NULL
+ * if the mode isn't supported by the device (the user is told about it,
+ * the count of packets is then -1) or the memory couldn't be allocated
+ * (the count is 0). The colorschemes aren't changed,
+ * so the same ones can be assembled again, e.g. for another microphone.
  *
  * <----- License notice ----->
  * Copyright (C) 2022, 2023, 2024 Ors1mer
@@ -38,9 +42,18 @@
 #define DATA_PACKET_SIZE 64
 #define BYTE_STEP 4 /* used to skip some part of bytes in a packet */
 #define RGB_CODE 0x81
+#define QS_FRAME_SIZE (2*BYTE_STEP) /* one upper & lower color command */
+#define MAX_FLAT_FRAMES (16*MAX_COLPAIR_COUNT) /* see frame_seq_flat_count */
+#define FRAME_BLEND_ONE 256 /* the whole weight, see frame_blend */
 /* For Quadcast 2S */
 #define QS2S_RGB_PACKET_CODE 0x02
 #define QS2S_LED_CNT 108
+#define QS2S_PCT_HEADER 4 /* bytes of codes before the colors */
+#define QS2S_LEDS_PER_PCT 20
+#define QS2S_UPPER_FIRST 0 /* the LEDs each group sets */
+#define QS2S_LOWER_FIRST 54
+#define QS2S_GROUP_LEDS 56 /* 2 past the next group, like the solid fill */
+#define QS2S_FRAME_SIZE (6*DATA_PACKET_SIZE) /* QS2S_SOLID_PKT_CNT packets */
 /* Macros */
 #define DIV_CEIL(X, Y) (((X)/(Y)) + ((X)%(Y) != 0))
 #define SPEED_RANGE(MIN, MAX, SPD) MIN + (MAX - MIN)*(100-SPD)/100
@@ -65,13 +78,67 @@
 /* Messages */
 #define NOSUPPORT_MSG _("The mode is not supported yet.")
 #define QS_2S_NOSUPPORT_MSG _("No support for %s on Quadcast 2S yet\n")
+#define RANGES_NOSUPPORT_MSG _("LED ranges are for Quadcast 2S only, " \
+                               "ignoring them\n")
+#define NOMEM_MSG _("Couldn't allocate the memory for the frames.\n")
+
+enum rgbmodes_exitcodes { /* exitcodes */
+    nomemerr = 12, /* after muteerr */
+    nosupporterr = 254
+};
 
 /* Types */
 typedef unsigned char byte_t;
 typedef byte_t datpack[DATA_PACKET_SIZE];
 
+/* The frames of a data array. Quadcast S keeps the color commands of
+ * each group apart, upper ones first, then a blank command and the lower
+ * ones; the groups loop on their own, and a frame takes the current
+ * command of each. Other frames (2S, scenes) follow one another */
+struct frame_seq {
+    const byte_t *data;
+    const byte_t *lower;  /* the lower commands, NULL for whole frames */
+    unsigned int len[2];  /* the frames the upper & lower groups loop */
+    unsigned long period; /* frames until both groups start over */
+    size_t frame_size;
+    byte_t levels[2][256]; /* -b of the groups, see frame_seq_levels */
+    int leveled;
+};
+
+struct render_job; /* a planned colorscheme waiting for its frames */
+struct render_task; /* a slice of its frames */
+struct render_batch { /* colorschemes rendered together on the pool */
+    struct render_job **jobs;
+    int cnt;
+    struct render_task *tasks; /* allocated by the first run, reused */
+    int task_jobs; /* the jobs there is room for */
+};
+
 /* Functions */
-datpack *parse_colorscheme(struct colschemes *cs, int *pck_cnt);
-short count_color_commands(const datpack *data_arr, int pck_cnt, int colgroup);
+datpack *parse_colorscheme(const struct colschemes *cs, int *pck_cnt);
+datpack *stream_colorscheme(const struct colschemes *cs, int *pck_cnt,
+                                                struct render_batch *b);
+datpack *plan_colorscheme(const struct colschemes *cs, int *pck_cnt,
+                                               struct render_batch *b);
+void render_batch_init(struct render_batch *b);
+int render_batch_run(struct render_batch *b);
+int render_batch_redraw(struct render_batch *b, int group,
+                                             unsigned long passes);
+int render_batch_varies(const struct render_batch *b);
+void render_batch_free(struct render_batch *b);
+void frame_seq_init(struct frame_seq *seq, const datpack *data_arr,
+                                      int pck_cnt, unsigned short pid);
+void frame_seq_whole(struct frame_seq *seq, const byte_t *frames,
+                                   unsigned int cnt, unsigned short pid);
+void frame_seq_levels(struct frame_seq *seq, const struct colschemes *cs);
+const byte_t *frame_seq_get(const struct frame_seq *seq,
+                            unsigned long long frame, byte_t *buf);
+void frame_seq_copy(const struct frame_seq *seq, unsigned long long frame,
+                                                              byte_t *out);
+void frame_blend(const byte_t *from, const byte_t *to, unsigned int weight,
+                 byte_t *out, unsigned short pid);
+unsigned int frame_seq_flat_count(const struct frame_seq *seq);
+void frame_seq_flatten(const struct frame_seq *seq, byte_t *out,
+                                                   unsigned int cnt);
 
 #endif
@@ -0,0 +1,177 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File rtprofile.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#ifdef __linux__
+#define _GNU_SOURCE /* for sched_setaffinity */
+#endif
+#include <stdio.h> /* for fprintf */
+#include <string.h> /* for memset, strerror */
+#include <errno.h>
+#include <unistd.h> /* for sysconf */
+#include <sched.h>
+#include <sys/mman.h> /* for mlockall */
+
+#include "locale_macros.h"
+#include "frameclock.h"
+#include "rtprofile.h"
+#include "reporter.h"
+
+#define NSEC_PER_SEC 1000000000ULL
+
+static void set_scheduler(const struct rtprofile *rt);
+static void lock_memory(const void *data, size_t size);
+static void prefault_stack(void);
+static unsigned long percentile(const struct rt_jitter *jit, int pct);
+static void reset_stats(struct rt_jitter *jit);
+
+/* Once per process: the scheduler and the locks stay for good, a
+ * resident instance comes back here with each microphone */
+void rt_enter(const struct rtprofile *rt, const void *data, size_t size)
+{
+    static int entered = 0;
+    if(rt->priority < 1 || entered)
+        return;
+    entered = 1;
+    set_scheduler(rt);
+    lock_memory(data, size);
+}
+
+void rt_jitter_init(struct rt_jitter *jit, unsigned long period_us)
+{
+    jit->period = period_us;
+    jit->last = 0;
+    jit->periods = 1;
+    jit->report = frame_clock_now() + RT_REPORT*NSEC_PER_SEC;
+    reset_stats(jit);
+}
+
+/* now is when the frame was over, periods is how many frame periods it
+ * is meant to last (more than 1 for the frames held by the governor) */
+void rt_jitter_add(struct rt_jitter *jit, unsigned long long now,
+                                                   unsigned int periods)
+{
+    unsigned long interval, expected, jitter;
+    if(jit->last) {
+        interval = (now - jit->last) / 1000;
+        expected = jit->period * jit->periods;
+        jitter = interval > expected ? interval - expected :
+                                       expected - interval;
+        if(jitter > jit->max)
+            jit->max = jitter;
+        jitter /= RT_JITTER_STEP;
+        jit->hist[jitter < RT_JITTER_BUCKETS ? jitter :
+                                               RT_JITTER_BUCKETS-1]++;
+        jit->frames++;
+    }
+    jit->last = now;
+    jit->periods = periods;
+}
+
+/* Once in RT_REPORT seconds, writes the jitter since the last report to
+ * r and returns 1; the reporter formats it off the send path */
+int rt_jitter_report(struct rt_jitter *jit, struct report *r)
+{
+    unsigned long long now = frame_clock_now();
+    if(now < jit->report || !jit->frames)
+        return 0;
+    report_init(r, RT_REPORT_MSG);
+    r->num[0] = percentile(jit, 50);
+    r->num[1] = percentile(jit, 99);
+    r->num[2] = jit->max;
+    r->num[3] = jit->frames;
+    jit->report = now + RT_REPORT*NSEC_PER_SEC;
+    reset_stats(jit);
+    return 1;
+}
+
+static void set_scheduler(const struct rtprofile *rt)
+{
+    struct sched_param param;
+    #ifdef __linux__
+    cpu_set_t cpus;
+    if(rt->cpu >= CPU_SETSIZE) {
+        fprintf(stderr, RT_CPU_ERR_MSG, rt->cpu, strerror(EINVAL));
+    } else if(rt->cpu >= 0) {
+        CPU_ZERO(&cpus);
+        CPU_SET(rt->cpu, &cpus);
+        if(sched_setaffinity(0, sizeof(cpus), &cpus))
+            fprintf(stderr, RT_CPU_ERR_MSG, rt->cpu, strerror(errno));
+    }
+    #else
+    if(rt->cpu >= 0)
+        fprintf(stderr, RT_CPU_ERR_MSG, rt->cpu, strerror(ENOSYS));
+    #endif
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = rt->priority;
+    if(sched_setscheduler(0, SCHED_FIFO, &param))
+        fprintf(stderr, RT_SCHED_ERR_MSG, strerror(errno));
+}
+
+/* Whatever is mapped later is locked as well (MCL_FUTURE), the frames
+ * are touched anyway in case the lock wasn't allowed */
+static void lock_memory(const void *data, size_t size)
+{
+    const volatile unsigned char *p = data;
+    long page = sysconf(_SC_PAGESIZE);
+    size_t i;
+    if(mlockall(MCL_CURRENT | MCL_FUTURE))
+        fprintf(stderr, RT_LOCK_ERR_MSG, strerror(errno));
+    if(page <= 0)
+        page = 4096;
+    for(i = 0; p && i < size; i += page)
+        (void)p[i];
+    prefault_stack();
+}
+
+/* The frames and the transfer buffers of the loop live on the stack */
+static void prefault_stack(void)
+{
+    volatile unsigned char stack[RT_STACK_PREFAULT];
+    size_t i;
+    for(i = 0; i < sizeof(stack); i += 256)
+        stack[i] = 0;
+}
+
+/* In microseconds, the upper bound of the bucket */
+static unsigned long percentile(const struct rt_jitter *jit, int pct)
+{
+    unsigned long seen = 0, need;
+    int b;
+    need = (jit->frames * pct + 99) / 100;
+    for(b = 0; b < RT_JITTER_BUCKETS - 1; b++) {
+        seen += jit->hist[b];
+        if(seen >= need)
+            break;
+    }
+    if(b == RT_JITTER_BUCKETS - 1)
+        return jit->max;
+    return (unsigned long)(b + 1) * RT_JITTER_STEP;
+}
+
+static void reset_stats(struct rt_jitter *jit)
+{
+    memset(jit->hist, 0, sizeof(jit->hist));
+    jit->frames = jit->max = 0;
+}
@@ -0,0 +1,86 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File rtprofile.h
+ * The real-time profile of the send loop, for hosts where other work
+ * saturates the CPUs. The process is switched to SCHED_FIFO with the
+ * given priority, optionally pinned to one CPU, its memory is locked
+ * and the frames and the stack are touched beforehand, so the loop
+ * takes no page faults once it runs. What the process isn't allowed
+ * to do (no CAP_SYS_NICE, a small RLIMIT_MEMLOCK) is reported once and
+ * the program goes on without it.
+ *
+ * The jitter of the send loop (how far the interval between frames was
+ * from the frame period) is kept in a histogram of fixed size and its
+ * percentiles are reported every RT_REPORT seconds, priority 0 gives
+ * the report alone so that it can be compared with and without the
+ * profile.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#ifndef RTPROFILE_SENTRY
+#define RTPROFILE_SENTRY
+
+#include <stddef.h> /* for size_t */
+
+/* Constants */
+#define RT_MAX_PRIORITY 99
+#define RT_STACK_PREFAULT (64*1024) /* bytes */
+#define RT_JITTER_STEP 10 /* microsec per bucket of the histogram */
+#define RT_JITTER_BUCKETS 1000 /* the last one takes the rest */
+#define RT_REPORT 10 /* seconds between jitter reports */
+
+/* Messages */
+#define RT_SCHED_ERR_MSG _("Couldn't switch to real-time scheduling (%s), " \
+                           "going on without it\n")
+#define RT_CPU_ERR_MSG _("Couldn't pin the process to CPU %d (%s), going " \
+                         "on without it\n")
+#define RT_LOCK_ERR_MSG _("Couldn't lock the memory (%s), going on " \
+                          "without it\n")
+#define RT_REPORT_MSG _("Jitter: p50 %lu, p99 %lu, max %lu microsec; " \
+                        "%lu frames")
+
+/* Types */
+struct report; /* see reporter.h */
+
+struct rtprofile {
+    int priority; /* SCHED_FIFO 1-99, 0 - measure the jitter only, -1 - off */
+    int cpu;      /* to pin the process to, -1 - any */
+};
+
+struct rt_jitter {
+    unsigned long period;      /* microsec */
+    unsigned long long last;   /* nanosec, 0 - no frame yet */
+    unsigned int periods;      /* the last frame is meant to last */
+    unsigned long long report; /* nanosec of the monotonic clock */
+    /* Since the last report, in microseconds */
+    unsigned long hist[RT_JITTER_BUCKETS];
+    unsigned long frames, max;
+};
+
+/* Functions */
+void rt_enter(const struct rtprofile *rt, const void *data, size_t size);
+void rt_jitter_init(struct rt_jitter *jit, unsigned long period_us);
+void rt_jitter_add(struct rt_jitter *jit, unsigned long long now,
+                                                   unsigned int periods);
+int rt_jitter_report(struct rt_jitter *jit, struct report *r);
+
+#endif
@@ -0,0 +1,439 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File scene.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include <stdio.h> /* for fopen, fgets & fprintf */
+#include <stdlib.h> /* for malloc, realloc & strtoul */
+#include <string.h> /* for strtok, memcmp & memcpy */
+#include <fcntl.h> /* for open */
+#include <unistd.h> /* for close */
+#include <sys/mman.h> /* for mmap */
+#include <sys/stat.h> /* for fstat */
+
+#include "locale_macros.h"
+
+#include "scene.h"
+
+#define FRAMES_ALIGN DATA_PACKET_SIZE
+#define ALIGN_UP(X, A) (((X) + (A) - 1) / (A) * (A))
+#define TOKEN_DELIM " \t\r\n"
+#define SAVE_TMP_SUFFIX ".new"
+
+/* Text source compilation */
+struct scene_src {
+    struct scene_step steps[SCENE_MAX_STEPS];
+    unsigned int step_cnt;
+    unsigned int loop;
+    byte_t *frames;
+    unsigned int frame_cnt;
+    unsigned int frame_size;
+    unsigned short pid;
+    struct render_batch batch;              /* steps wait to be rendered */
+    datpack *step_data[SCENE_MAX_STEPS];    /* NULL for fades */
+    int step_pck_cnt[SCENE_MAX_STEPS];
+};
+
+static int compile_text(struct scene *sc, FILE *f, const char *path,
+                                                         unsigned short pid);
+static int compile_line(struct scene_src *src, char *line);
+static int compile_step(struct scene_src *src, char **tok, int tok_cnt);
+static int render_steps(struct scene_src *src);
+static int append_frames(struct scene_src *src,
+                                         const struct frame_seq *seq);
+static int build_image(struct scene *sc, const struct scene_src *src);
+/* Binary image */
+static int load_image(struct scene *sc, int fd, const char *path,
+                                                         unsigned short pid);
+static size_t frames_offset(unsigned int step_cnt);
+static void set_pointers(struct scene *sc);
+static int is_valid(const struct scene *sc);
+static int is_color_byte(const struct scene *sc, unsigned int i);
+
+/* Functions */
+int scene_load(struct scene *sc, const char *path, unsigned short pid)
+{
+    char magic[sizeof(SCENE_MAGIC)-1];
+    FILE *f;
+    int errcode;
+
+    f = fopen(path, "r");
+    if(!f) {
+        fprintf(stderr, SCENE_OPEN_ERR_MSG, path);
+        return 1;
+    }
+    if(fread(magic, 1, sizeof(magic), f) == sizeof(magic) &&
+                                !memcmp(magic, SCENE_MAGIC, sizeof(magic)))
+        errcode = load_image(sc, fileno(f), path, pid);
+    else
+        errcode = compile_text(sc, f, path, pid);
+    fclose(f);
+    return errcode;
+}
+
+/* A single endless step of the frames, i.e. a saved colorscheme */
+int scene_from_frames(struct scene *sc, const struct frame_seq *seq,
+                                                     unsigned short pid)
+{
+    struct scene_src src;
+    int errcode;
+
+    memset(&src, 0, sizeof(src));
+    src.pid = pid;
+    src.frame_size = FRAME_SIZE(pid);
+    src.steps[0].type = step_play;
+    src.steps[0].duration = 0;
+    src.steps[0].first_frame = 0;
+    src.step_cnt = 1;
+    errcode = append_frames(&src, seq);
+    src.steps[0].frame_cnt = src.frame_cnt;
+    if(!errcode)
+        errcode = build_image(sc, &src);
+    free(src.frames);
+    return errcode;
+}
+
+/* The file is replaced at once: a running instance may have it mapped */
+int scene_save(const struct scene *sc, const char *path)
+{
+    char *tmp;
+    FILE *f;
+    size_t written;
+
+    tmp = malloc(strlen(path) + sizeof(SAVE_TMP_SUFFIX));
+    if(!tmp) {
+        fprintf(stderr, SCENE_WRITE_ERR_MSG, path);
+        return 1;
+    }
+    sprintf(tmp, "%s" SAVE_TMP_SUFFIX, path);
+    f = fopen(tmp, "wb");
+    if(!f) {
+        fprintf(stderr, SCENE_WRITE_ERR_MSG, path);
+        free(tmp);
+        return 1;
+    }
+    written = fwrite(sc->image, 1, sc->image_size, f);
+    if(fclose(f) || written != sc->image_size || rename(tmp, path)) {
+        fprintf(stderr, SCENE_WRITE_ERR_MSG, path);
+        remove(tmp);
+        free(tmp);
+        return 1;
+    }
+    free(tmp);
+    return 0;
+}
+
+void scene_free(struct scene *sc)
+{
+    if(sc->mapped)
+        munmap(sc->image, sc->image_size);
+    else
+        free(sc->image);
+    sc->image = NULL;
+}
+
+const byte_t *scene_frame(const struct scene *sc, const struct scene_step *st,
+                                                          unsigned int frame)
+{
+    return sc->frames +
+           (st->first_frame + frame % st->frame_cnt) * sc->hdr->frame_size;
+}
+
+void scene_blend(const struct scene *sc, const byte_t *from, const byte_t *to,
+                 unsigned int part, unsigned int whole, byte_t *out)
+{
+    unsigned int i;
+    if(!whole)
+        part = whole = 1;
+    if(part > whole)
+        part = whole;
+    for(i = 0; i < sc->hdr->frame_size; i++) {
+        if(is_color_byte(sc, i))
+            out[i] = from[i] + ((int)to[i]-from[i]) * (int)part/(int)whole;
+        else
+            out[i] = to[i]; /* codes must stay intact */
+    }
+}
+
+static int compile_text(struct scene *sc, FILE *f, const char *path,
+                                                          unsigned short pid)
+{
+    struct scene_src src;
+    char line[SCENE_LINE_LEN];
+    int line_num = 0, errcode = 0;
+    unsigned int i;
+
+    rewind(f);
+    memset(&src, 0, sizeof(src));
+    render_batch_init(&src.batch);
+    src.pid = pid;
+    src.frame_size = (pid == QUADCAST_2S_PID) ? QS2S_FRAME_SIZE :
+                                                QS_FRAME_SIZE;
+    while(!errcode && fgets(line, sizeof(line), f)) {
+        line_num++;
+        errcode = compile_line(&src, line);
+        if(errcode == 1)
+            fprintf(stderr, SCENE_SYNTAX_ERR_MSG, path, line_num);
+        else if(errcode == 2)
+            fprintf(stderr, SCENE_STEPS_ERR_MSG, path, line_num);
+        else if(errcode == 3)
+            fprintf(stderr, SCENE_ENDLESS_ERR_MSG, path, line_num);
+    }
+    if(!errcode)
+        errcode = render_steps(&src);
+    if(!errcode) {
+        errcode = build_image(sc, &src);
+        if(errcode)
+            fprintf(stderr, SCENE_NOPLAY_ERR_MSG, path);
+    }
+    render_batch_free(&src.batch);
+    for(i = 0; i < src.step_cnt; i++)
+        free(src.step_data[i]);
+    free(src.frames);
+    return errcode;
+}
+
+/* Returns 1 on syntax errors, 2 if there are too many steps, 3 if a step
+ * follows an endless one */
+static int compile_line(struct scene_src *src, char *line)
+{
+    char *tok[SCENE_MAX_ARGS+1], *comment;
+    int tok_cnt = 0;
+
+    comment = strchr(line, '#');
+    if(comment)
+        *comment = '\0';
+    tok[0] = strtok(line, TOKEN_DELIM);
+    while(tok[tok_cnt] && tok_cnt < SCENE_MAX_ARGS) {
+        tok_cnt++;
+        tok[tok_cnt] = strtok(NULL, TOKEN_DELIM);
+    }
+    if(tok_cnt == 0) /* blank line */
+        return 0;
+    if(tok_cnt < 2 || strspn(tok[1], "0123456789") != strlen(tok[1]))
+        return 1;
+
+    if(strequ(tok[0], "loop") && tok_cnt == 2) {
+        src->loop = strtoul(tok[1], NULL, 10);
+        return 0;
+    }
+    if(src->step_cnt == SCENE_MAX_STEPS)
+        return 2;
+    if(src->step_cnt && src->steps[src->step_cnt-1].type == step_play &&
+                                   !src->steps[src->step_cnt-1].duration)
+        return 3;
+    if(strequ(tok[0], "fade") && tok_cnt == 2) {
+        struct scene_step *st = src->steps + src->step_cnt;
+        /* a fade needs a step to fade into */
+        if(src->step_cnt && src->steps[src->step_cnt-1].type == step_fade)
+            return 1;
+        st->type = step_fade;
+        st->duration = strtoul(tok[1], NULL, 10);
+        st->first_frame = st->frame_cnt = 0;
+        src->step_data[src->step_cnt] = NULL;
+        src->step_cnt++;
+        return 0;
+    } else if(strequ(tok[0], "step")) {
+        return compile_step(src, tok, tok_cnt);
+    }
+    return 1;
+}
+
+/* Only plans the frames, render_steps renders all the steps at once */
+static int compile_step(struct scene_src *src, char **tok, int tok_cnt)
+{
+    struct scene_step *st = src->steps + src->step_cnt;
+    struct colschemes cs;
+    struct progopts opts;
+    datpack *data_arr;
+    int pck_cnt;
+
+    /* The step arguments follow the duration, tok[1] stands for argv[0] */
+    if(parse_arg(&cs, tok_cnt-1, (const char **)tok+1, &opts) != success)
+        return 1;
+    if(opts.scene || opts.poke) /* scenes can't be nested */
+        return 1;
+    cs.pid = src->pid;
+    data_arr = plan_colorscheme(&cs, &pck_cnt, &src->batch);
+    if(!data_arr)
+        return 1;
+
+    st->type = step_play;
+    st->duration = strtoul(tok[1], NULL, 10);
+    src->step_data[src->step_cnt] = data_arr;
+    src->step_pck_cnt[src->step_cnt] = pck_cnt;
+    src->step_cnt++;
+    return 0;
+}
+
+static int render_steps(struct scene_src *src)
+{
+    struct scene_step *st;
+    struct frame_seq seq;
+    unsigned int i;
+    int errcode;
+
+    errcode = render_batch_run(&src->batch);
+    for(i = 0; !errcode && i < src->step_cnt; i++) {
+        st = src->steps + i;
+        if(!src->step_data[i])
+            continue;
+        frame_seq_init(&seq, src->step_data[i], src->step_pck_cnt[i],
+                                                             src->pid);
+        st->first_frame = src->frame_cnt;
+        errcode = append_frames(src, &seq);
+        st->frame_cnt = src->frame_cnt - st->first_frame;
+    }
+    return errcode;
+}
+
+/* The groups of Quadcast S are put together, see frame_seq_flat_count */
+static int append_frames(struct scene_src *src,
+                                          const struct frame_seq *seq)
+{
+    unsigned int cnt = frame_seq_flat_count(seq);
+    byte_t *tmp;
+    tmp = realloc(src->frames, (src->frame_cnt+cnt) * src->frame_size);
+    if(!tmp)
+        return 1;
+    frame_seq_flatten(seq, tmp + src->frame_cnt*src->frame_size, cnt);
+    src->frames = tmp;
+    src->frame_cnt += cnt;
+    return 0;
+}
+
+static int build_image(struct scene *sc, const struct scene_src *src)
+{
+    struct scene_header *hdr;
+    size_t offset;
+
+    offset = frames_offset(src->step_cnt);
+    sc->image_size = offset + (size_t)src->frame_cnt*src->frame_size;
+    sc->image = calloc(sc->image_size, 1);
+    if(!sc->image)
+        return 1;
+    sc->mapped = 0;
+    hdr = sc->image;
+    memcpy(hdr->magic, SCENE_MAGIC, sizeof(hdr->magic));
+    hdr->version = SCENE_VERSION;
+    hdr->pid = src->pid;
+    hdr->loop = src->loop;
+    hdr->step_cnt = src->step_cnt;
+    hdr->frame_size = src->frame_size;
+    hdr->frame_cnt = src->frame_cnt;
+    memcpy(hdr+1, src->steps, src->step_cnt * sizeof(*src->steps));
+    memcpy((byte_t *)sc->image + offset, src->frames,
+                                 (size_t)src->frame_cnt * src->frame_size);
+    set_pointers(sc);
+    if(!is_valid(sc)) {
+        scene_free(sc);
+        return 1;
+    }
+    return 0;
+}
+
+static int load_image(struct scene *sc, int fd, const char *path,
+                                                         unsigned short pid)
+{
+    struct stat st;
+    if(fstat(fd, &st) || (size_t)st.st_size < sizeof(struct scene_header)) {
+        fprintf(stderr, SCENE_FORMAT_ERR_MSG, path, SCENE_VERSION);
+        return 1;
+    }
+    sc->image_size = st.st_size;
+    sc->image = mmap(NULL, sc->image_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(sc->image == MAP_FAILED) {
+        fprintf(stderr, SCENE_OPEN_ERR_MSG, path);
+        return 1;
+    }
+    sc->mapped = 1;
+    set_pointers(sc);
+    if(!is_valid(sc)) {
+        fprintf(stderr, SCENE_FORMAT_ERR_MSG, path, SCENE_VERSION);
+        scene_free(sc);
+        return 1;
+    }
+    if(sc->hdr->pid != pid) {
+        fprintf(stderr, SCENE_PID_ERR_MSG, path, sc->hdr->pid, pid);
+        scene_free(sc);
+        return 1;
+    }
+    return 0;
+}
+
+static size_t frames_offset(unsigned int step_cnt)
+{
+    return ALIGN_UP(sizeof(struct scene_header) +
+                    step_cnt*sizeof(struct scene_step), FRAMES_ALIGN);
+}
+
+static void set_pointers(struct scene *sc)
+{
+    sc->hdr = sc->image;
+    sc->steps = (const struct scene_step *)(sc->hdr+1);
+    sc->frames = NULL;
+    if(sc->image_size >= frames_offset(sc->hdr->step_cnt))
+        sc->frames = (const byte_t *)sc->image +
+                                           frames_offset(sc->hdr->step_cnt);
+}
+
+static int is_valid(const struct scene *sc)
+{
+    const struct scene_header *hdr = sc->hdr;
+    unsigned int i, play_cnt = 0;
+
+    if(memcmp(hdr->magic, SCENE_MAGIC, sizeof(hdr->magic)) ||
+       hdr->version != SCENE_VERSION || !sc->frames || !hdr->step_cnt ||
+       hdr->step_cnt > SCENE_MAX_STEPS)
+        return 0;
+    if(hdr->frame_size != FRAME_SIZE(hdr->pid)) /* the frames are read so */
+        return 0;
+    if(sc->image_size < frames_offset(hdr->step_cnt) +
+                                 (size_t)hdr->frame_cnt*hdr->frame_size)
+        return 0;
+    for(i = 0; i < hdr->step_cnt; i++) {
+        const struct scene_step *st = sc->steps + i;
+        const struct scene_step *next = sc->steps + (i+1) % hdr->step_cnt;
+        if(st->type == step_fade) {
+            if(next->type != step_play)
+                return 0;
+        } else if(st->type == step_play) {
+            if(!st->frame_cnt || st->first_frame > hdr->frame_cnt ||
+                           st->frame_cnt > hdr->frame_cnt - st->first_frame)
+                return 0;
+            if(!st->duration && i+1 < hdr->step_cnt) /* never left */
+                return 0;
+            play_cnt++;
+        } else {
+            return 0;
+        }
+    }
+    return play_cnt > 0;
+}
+
+static int is_color_byte(const struct scene *sc, unsigned int i)
+{
+    if(sc->hdr->frame_size == QS2S_FRAME_SIZE)
+        return i % DATA_PACKET_SIZE >= 4; /* skip the packet codes */
+    return i % BYTE_STEP != 0; /* skip RGB_CODE */
+}
@@ -0,0 +1,105 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File scene.h
+ * Scenes: timelines of colorschemes described in a text file.
+ * A scene is compiled into a flat binary image (header, step table,
+ * frames) that can be written to a file and mmap'ed back later, so
+ * playing a compiled scene takes no parsing at all. A saved colorscheme
+ * is a scene of one endless step.
+ *
+ * Text format, one instruction per line ('#' starts a comment):
+ *     loop N                  play the scene N times (0 - endlessly)
+ *     step MS [ARGS]...       show the colorscheme given by the usual
+ *                             command-line ARGS for MS milliseconds
+ *                             (0 - until the program is stopped, the
+ *                             last step only)
+ *     fade MS                 blend the last shown frame into the first
+ *                             frame of the next step in MS milliseconds
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#ifndef SCENE_SENTRY
+#define SCENE_SENTRY
+
+#include <stdint.h> /* for fixed-size fields of the binary image */
+#include "devio.h" /* for datpack & byte_t types, QS2S_SOLID_PKT_CNT */
+
+/* Constants */
+#define SCENE_MAGIC "QSCN"
+#define SCENE_VERSION 1
+#define SCENE_MAX_STEPS 256
+#define SCENE_MAX_ARGS 64
+#define SCENE_LINE_LEN 1024
+
+/* Messages */
+#define SCENE_OPEN_ERR_MSG _("Couldn't open the scene file %s\n")
+#define SCENE_SYNTAX_ERR_MSG _("%s:%d: syntax error\n")
+#define SCENE_STEPS_ERR_MSG _("%s:%d: too many steps\n")
+#define SCENE_ENDLESS_ERR_MSG _("%s:%d: the step before never ends, only " \
+                                "the last one may last 0 ms\n")
+#define SCENE_NOPLAY_ERR_MSG _("%s: no step to play or to fade into\n")
+#define SCENE_FORMAT_ERR_MSG _("%s: not a compiled scene of version %d\n")
+#define SCENE_PID_ERR_MSG _("%s: the scene was compiled for the device " \
+                            "%04x, not %04x\n")
+#define SCENE_WRITE_ERR_MSG _("Couldn't write the compiled scene to %s\n")
+
+/* Types */
+enum scene_step_type { step_play, step_fade };
+
+struct scene_header { /* the binary image starts with it */
+    char magic[4];
+    uint16_t version;
+    uint16_t pid;          /* the device the frames were assembled for */
+    uint32_t loop;         /* 0 - endless */
+    uint32_t step_cnt;
+    uint32_t frame_size;   /* bytes per frame */
+    uint32_t frame_cnt;    /* frames of all steps */
+};
+
+struct scene_step { /* the step table follows the header */
+    uint32_t type;         /* enum scene_step_type */
+    uint32_t duration;     /* milliseconds */
+    uint32_t first_frame;  /* index in the frame area, play steps only */
+    uint32_t frame_cnt;    /* frames to loop through, play steps only */
+};
+
+struct scene {
+    const struct scene_header *hdr;
+    const struct scene_step *steps;
+    const byte_t *frames;  /* the frame area follows the step table */
+    void *image;
+    size_t image_size;
+    int mapped;            /* image is mmap'ed, not malloc'ed */
+};
+
+/* Functions */
+int scene_load(struct scene *sc, const char *path, unsigned short pid);
+int scene_from_frames(struct scene *sc, const struct frame_seq *seq,
+                                                    unsigned short pid);
+int scene_save(const struct scene *sc, const char *path);
+void scene_free(struct scene *sc);
+const byte_t *scene_frame(const struct scene *sc, const struct scene_step *st,
+                                                         unsigned int frame);
+void scene_blend(const struct scene *sc, const byte_t *from, const byte_t *to,
+                 unsigned int part, unsigned int whole, byte_t *out);
+
+#endif
@@ -0,0 +1,310 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File service.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include <stdio.h> /* for fprintf */
+#include <stdlib.h> /* for getenv, strtol & strtoul */
+#include <string.h> /* for strlen, strcmp, memchr, memmove & strerror */
+#include <stddef.h> /* for offsetof */
+#include <errno.h>
+#include <unistd.h> /* for getpid, read, write & unlink */
+#include <sys/socket.h>
+#include <sys/stat.h> /* for umask */
+#include <sys/un.h>
+
+#include "dimmer.h" /* for DIMMER_FULL */
+#include "service.h"
+
+/* Constants */
+#define LISTEN_FDS_START 3 /* the first fd systemd passes */
+#define CTL_BACKLOG 8
+
+static int ctl_address(struct sockaddr_un *addr, const char *path,
+                                                         socklen_t *len);
+static void ctl_take_client(struct ctl *ctl);
+static void ctl_drop_client(struct ctl *ctl, int i, int close_fd);
+static int ctl_read_line(struct ctl *ctl, struct ctl_client *c);
+static int ctl_parse_command(struct ctl *ctl, char *line);
+static int ctl_parse_dim(struct ctl *ctl, const char *arg);
+
+/* Functions */
+/* Uses the socket passed by systemd or listens on path if it isn't NULL.
+ * Returns 0 (ctl->fd is -1 without a socket) or ctlerr */
+int ctl_listen(struct ctl *ctl, const char *path)
+{
+    struct sockaddr_un addr;
+    const char *pid = getenv("LISTEN_PID"), *fds = getenv("LISTEN_FDS");
+    socklen_t len;
+    mode_t mask;
+    ctl->fd = -1;
+    ctl->path = NULL;
+    ctl->dim = DIMMER_FULL;
+    ctl->dim_ramp = 0;
+    ctl->dim_cnt = 0;
+    ctl->pending_cnt = 0;
+    if(pid && fds && strtol(pid, NULL, 10) == getpid() &&
+                                                  strtol(fds, NULL, 10) > 0) {
+        unsetenv("LISTEN_PID"); /* not for the children */
+        unsetenv("LISTEN_FDS");
+        ctl->fd = LISTEN_FDS_START;
+        return 0;
+    }
+    if(!path)
+        return 0;
+    if(ctl_address(&addr, path, &len)) {
+        fprintf(stderr, CTL_LISTEN_ERR_MSG, path, strerror(ENAMETOOLONG));
+        return ctlerr;
+    }
+    ctl->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(ctl->fd < 0) {
+        fprintf(stderr, CTL_LISTEN_ERR_MSG, path, strerror(errno));
+        return ctlerr;
+    }
+    unlink(path); /* a socket left by an instance that was killed */
+    mask = umask(077); /* only the owner (and root) may poke */
+    if(bind(ctl->fd, (struct sockaddr *)&addr, len) ||
+                                             listen(ctl->fd, CTL_BACKLOG)) {
+        umask(mask);
+        fprintf(stderr, CTL_LISTEN_ERR_MSG, path, strerror(errno));
+        close(ctl->fd);
+        ctl->fd = -1;
+        return ctlerr;
+    }
+    umask(mask);
+    ctl->path = path;
+    return 0;
+}
+
+/* Waits up to timeout_ms for a command, returns it or cmd_none */
+int ctl_wait(struct ctl *ctl, int timeout_ms)
+{
+    int conn, cmd;
+    cmd = ctl_accept(ctl, timeout_ms, &conn);
+    if(cmd == cmd_stream) { /* there is nothing to show the frames on */
+        close(conn);
+        cmd = cmd_none;
+    }
+    return cmd;
+}
+
+/* Same as ctl_wait, but the connection of cmd_stream is left open in
+ * conn; the data after the command line is still unread. Only poll
+ * waits, so a timeout of 0 never blocks: a client that is slow to send
+ * its line stays pending, and what it has sent is kept */
+int ctl_accept(struct ctl *ctl, int timeout_ms, int *conn)
+{
+    struct pollfd pfds[CTL_MAX_POLLFDS];
+    int i, cnt, cmd;
+    cnt = ctl_pollfds(ctl, pfds, CTL_MAX_POLLFDS);
+    if(poll(pfds, cnt, timeout_ms) <= 0) /* EINTR lets the caller stop */
+        return cmd_none;
+    if(pfds[0].revents)
+        ctl_take_client(ctl);
+    for(i = 0; i < ctl->pending_cnt; i++) {
+        cmd = ctl_read_line(ctl, ctl->pending + i);
+        if(cmd < 0) /* the line goes on */
+            continue;
+        *conn = ctl->pending[i].fd;
+        ctl_drop_client(ctl, i, cmd != cmd_stream);
+        if(cmd != cmd_none) /* the others wait for the next call */
+            return cmd;
+        i--;
+    }
+    return cmd_none;
+}
+
+/* Puts the socket and the pending clients to pfds (max of them at most,
+ * CTL_MAX_POLLFDS is enough), the socket goes first. Returns the count */
+int ctl_pollfds(const struct ctl *ctl, struct pollfd *pfds, int max)
+{
+    int i, cnt = 0;
+    for(i = -1; i < ctl->pending_cnt && cnt < max; i++, cnt++) {
+        pfds[cnt].fd = i < 0 ? ctl->fd : ctl->pending[i].fd;
+        pfds[cnt].events = POLLIN;
+        pfds[cnt].revents = 0;
+    }
+    return cnt;
+}
+
+void ctl_close(struct ctl *ctl)
+{
+    while(ctl->pending_cnt)
+        ctl_drop_client(ctl, 0, 1);
+    if(ctl->fd < 0)
+        return;
+    close(ctl->fd);
+    if(ctl->path)
+        unlink(ctl->path);
+    ctl->fd = -1;
+}
+
+/* Tells the resident instance to look for the microphone.
+ * Returns 0 or ctlerr */
+int ctl_poke(const char *path)
+{
+    return ctl_send(path, "poke\n");
+}
+
+/* Sends a command line to the instance listening on path */
+int ctl_send(const char *path, const char *line)
+{
+    size_t line_len = strlen(line);
+    struct sockaddr_un addr;
+    socklen_t len;
+    int fd, ok;
+    if(!path)
+        path = CTL_SOCKET_DEFAULT;
+    if(ctl_address(&addr, path, &len)) {
+        fprintf(stderr, CTL_CONNECT_ERR_MSG, path, strerror(ENAMETOOLONG));
+        return ctlerr;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    ok = fd >= 0 && !connect(fd, (struct sockaddr *)&addr, len) &&
+                write(fd, line, line_len) == (ssize_t)line_len;
+    if(!ok)
+        fprintf(stderr, CTL_CONNECT_ERR_MSG, path, strerror(errno));
+    if(fd >= 0)
+        close(fd);
+    return ok ? 0 : ctlerr;
+}
+
+/* The sd_notify protocol: a datagram to NOTIFY_SOCKET, '@' stands for
+ * the abstract namespace. Does nothing outside of a Type=notify service */
+void service_notify(const char *state)
+{
+    const char *path = getenv("NOTIFY_SOCKET");
+    struct sockaddr_un addr;
+    socklen_t len;
+    int fd;
+    if(!path || (*path != '/' && *path != '@'))
+        return;
+    if(ctl_address(&addr, path, &len))
+        return;
+    if(*path == '@') { /* the name of such a socket has no ending '\0' */
+        addr.sun_path[0] = '\0';
+        len--;
+    }
+    fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if(fd < 0)
+        return;
+    sendto(fd, state, strlen(state), 0, (struct sockaddr *)&addr, len);
+    close(fd);
+}
+
+static int ctl_address(struct sockaddr_un *addr, const char *path,
+                                                          socklen_t *len)
+{
+    size_t plen = strlen(path);
+    if(plen >= sizeof(addr->sun_path))
+        return 1;
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    memcpy(addr->sun_path, path, plen);
+    *len = offsetof(struct sockaddr_un, sun_path) + plen + 1;
+    return 0;
+}
+
+/* The socket has a client to accept, it waits for its line. The oldest
+ * pending client makes room for it */
+static void ctl_take_client(struct ctl *ctl)
+{
+    struct ctl_client *c;
+    int fd;
+    fd = accept(ctl->fd, NULL, NULL);
+    if(fd < 0)
+        return;
+    if(ctl->pending_cnt == CTL_MAX_PENDING)
+        ctl_drop_client(ctl, 0, 1);
+    c = ctl->pending + ctl->pending_cnt++;
+    c->fd = fd;
+    c->len = 0;
+}
+
+static void ctl_drop_client(struct ctl *ctl, int i, int close_fd)
+{
+    if(close_fd)
+        close(ctl->pending[i].fd);
+    ctl->pending_cnt--;
+    memmove(ctl->pending + i, ctl->pending + i + 1,
+            (ctl->pending_cnt - i)*sizeof(*ctl->pending));
+}
+
+/* Reads what the client has sent of its line, but nothing after it, as
+ * a stream may follow. Returns the command once the line is over (the
+ * client may close the connection instead of '\n'), -1 until then */
+static int ctl_read_line(struct ctl *ctl, struct ctl_client *c)
+{
+    char *end = c->line + c->len, *nl;
+    ssize_t n;
+    n = recv(c->fd, end, sizeof(c->line)-1 - c->len,
+                                                MSG_PEEK | MSG_DONTWAIT);
+    if(n < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ?
+                                                             -1 : cmd_none;
+    if(n == 0) {
+        *end = '\0';
+        return c->len ? ctl_parse_command(ctl, c->line) : cmd_none;
+    }
+    nl = memchr(end, '\n', n);
+    if(nl)
+        n = nl - end + 1;
+    if(read(c->fd, end, n) != n)
+        return cmd_none;
+    c->len += n;
+    c->line[c->len] = '\0';
+    if(nl)
+        return ctl_parse_command(ctl, c->line);
+    return c->len < sizeof(c->line)-1 ? -1 : cmd_none; /* too long */
+}
+
+static int ctl_parse_command(struct ctl *ctl, char *line)
+{
+    line[strcspn(line, "\r\n")] = '\0';
+    if(strcmp(line, "poke") == 0)
+        return cmd_poke;
+    if(strcmp(line, "stream") == 0)
+        return cmd_stream;
+    if(strncmp(line, "dim ", 4) == 0)
+        return ctl_parse_dim(ctl, line+4);
+    return cmd_none;
+}
+
+/* PERCENT [MS] */
+static int ctl_parse_dim(struct ctl *ctl, const char *arg)
+{
+    char *end;
+    long level;
+    unsigned long ramp = 0;
+    level = strtol(arg, &end, 10);
+    if(end == arg || level < 0 || level > DIMMER_FULL)
+        return cmd_none;
+    if(*end == ' ')
+        ramp = strtoul(end+1, &end, 10);
+    if(*end)
+        return cmd_none;
+    ctl->dim = (int)level;
+    ctl->dim_ramp = ramp;
+    ctl->dim_cnt++;
+    return cmd_dim;
+}
@@ -0,0 +1,97 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File service.h
+ * Running as a resident service. The program can listen on a control
+ * socket (a UNIX stream socket, given by --socket or passed by systemd
+ * with socket activation) and then waits for the microphone instead of
+ * exiting when there is none, so a plugged in microphone gets its colors
+ * from a process that is already running. A udev rule pokes the socket
+ * with quadcastrgb --poke when the microphone appears.
+ *
+ * Commands are lines of text, one per connection:
+ *     poke    a microphone might have been plugged in, look for it
+ *     stream  the connection stays open and carries frames to show
+ *             instead of the colors of the program (see framestream.h)
+ *     dim PERCENT [MS]
+ *             dim the colors to PERCENT of their brightness, in MS
+ *             millisec (see dimmer.h); the level stays for the
+ *             microphones plugged in later
+ * Unknown commands are ignored. The line is collected as it comes, a byte
+ * or the whole of it at a time, and nothing ever waits for it: the frame
+ * loop asks for the commands before each frame. Up to CTL_MAX_PENDING
+ * clients may be in the middle of their lines, the oldest of them is
+ * dropped to make room for a new one.
+ *
+ * The readiness and the state are reported to systemd through
+ * NOTIFY_SOCKET when it is set (Type=notify services).
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#ifndef SERVICE_SENTRY
+#define SERVICE_SENTRY
+
+#include <poll.h> /* for struct pollfd */
+
+#include "locale_macros.h"
+
+/* Constants */
+#define CTL_SOCKET_DEFAULT "/run/quadcastrgb.sock"
+#define CTL_CMD_LEN 64
+#define CTL_MAX_PENDING 8
+#define CTL_MAX_POLLFDS (1 + CTL_MAX_PENDING) /* see ctl_pollfds */
+
+/* Messages */
+#define CTL_LISTEN_ERR_MSG _("Couldn't listen on the control socket %s: %s\n")
+#define CTL_CONNECT_ERR_MSG _("Couldn't poke the control socket %s: %s\n")
+
+/* Types */
+enum service_exitcodes { ctlerr = 8 }; /* continues the ones of main */
+
+enum ctl_commands { cmd_none, cmd_poke, cmd_stream, cmd_dim };
+
+struct ctl_client { /* connected, its command line isn't over yet */
+    int fd;
+    char line[CTL_CMD_LEN];
+    size_t len;
+};
+
+struct ctl {
+    int fd;           /* -1 - there is no control socket */
+    const char *path; /* to remove at exit, NULL if systemd made it */
+    int dim;          /* percent, given by the last dim command */
+    unsigned long dim_ramp; /* millisec */
+    unsigned int dim_cnt;   /* dim commands so far */
+    struct ctl_client pending[CTL_MAX_PENDING]; /* the oldest first */
+    int pending_cnt;
+};
+
+/* Functions */
+int ctl_listen(struct ctl *ctl, const char *path);
+int ctl_wait(struct ctl *ctl, int timeout_ms);
+int ctl_accept(struct ctl *ctl, int timeout_ms, int *conn);
+int ctl_pollfds(const struct ctl *ctl, struct pollfd *pfds, int max);
+void ctl_close(struct ctl *ctl);
+int ctl_poke(const char *path);
+int ctl_send(const char *path, const char *line);
+void service_notify(const char *state);
+
+#endif
@@ -0,0 +1,194 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File timeline.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include <string.h> /* for memcpy */
+
+#include "colorpipe.h"
+#include "prng.h"
+#include "timeline.h"
+
+#define FRAC_ONE 4096 /* fixed-point 1.0 of the ramp position */
+
+static const struct segment *advance(struct tl_cursor *cur);
+static void enter_segment(struct tl_cursor *cur);
+static int segment_color(const struct segment *seg, unsigned int pos);
+static int gradient_channel(int start, int end, unsigned int pos,
+                                                   unsigned int length);
+static unsigned int ramp_fraction(const struct segment *seg,
+                                                   unsigned int pos);
+
+/* Functions */
+void timeline_init(struct timeline *tl)
+{
+    tl->seg_cnt = 0;
+}
+
+int timeline_add(struct timeline *tl, int type, int start, int end,
+                                                         int length)
+{
+    struct segment *seg;
+    if(tl->seg_cnt == TL_MAX_SEGS)
+        return 1;
+    seg = tl->segs + tl->seg_cnt;
+    seg->type = type;
+    seg->start = start;
+    seg->end = end;
+    seg->length = (length > 0) ? length : 0;
+    seg->rand_col = 0;
+    tl->seg_cnt++;
+    return 0;
+}
+
+unsigned long timeline_length(const struct timeline *tl)
+{
+    unsigned long len = 0;
+    unsigned int i;
+    for(i = 0; i < tl->seg_cnt; i++)
+        len += tl->segs[i].length;
+    return len;
+}
+
+/* Draws the colors of the random segments met in the first cnt frames,
+ * returns how many were drawn. Segments of 0 frames get one too, so the
+ * colors depend only on the segments and the state of rng */
+int timeline_draw(struct timeline *tl, unsigned long cnt, struct prng *rng)
+{
+    unsigned long before = 0;
+    unsigned int i;
+    int drawn = 0;
+    for(i = 0; i < tl->seg_cnt && before < cnt; i++) {
+        if(tl->segs[i].type == seg_random) {
+            tl->segs[i].rand_col = prng_color(rng);
+            drawn++;
+        }
+        before += tl->segs[i].length;
+    }
+    return drawn;
+}
+
+void tl_cursor_init(struct tl_cursor *cur, const struct timeline *tl)
+{
+    cur->tl = tl;
+    cur->seg = cur->pos = 0;
+    if(timeline_length(tl)) /* an empty timeline has nothing to enter */
+        enter_segment(cur);
+}
+
+/* Puts an initialized cursor before the given frame of the timeline */
+void tl_cursor_seek(struct tl_cursor *cur, unsigned long frame)
+{
+    const struct segment *seg;
+    for(seg = cur->tl->segs; frame >= seg->length; seg++)
+        frame -= seg->length;
+    cur->seg = seg - cur->tl->segs;
+    cur->pos = frame;
+}
+
+int tl_cursor_next(struct tl_cursor *cur)
+{
+    const struct segment *seg;
+    seg = advance(cur);
+    return segment_color(seg, cur->pos-1);
+}
+
+void tl_cursor_next_lin(struct tl_cursor *cur, unsigned short *lin)
+{
+    const struct segment *seg;
+    unsigned short st[3], end[3];
+    unsigned int frac;
+    int i;
+    seg = advance(cur);
+    if(seg->type == seg_random) {
+        colorpipe_decode(seg->rand_col, lin);
+        return;
+    }
+    colorpipe_decode(seg->start, st);
+    if(seg->type == seg_hold) {
+        memcpy(lin, st, sizeof(st));
+        return;
+    }
+    colorpipe_decode(seg->end, end);
+    frac = ramp_fraction(seg, cur->pos-1);
+    for(i = 0; i < 3; i++)
+        lin[i] = st[i] + ((int)end[i] - st[i]) * (int)frac / FRAC_ONE;
+}
+
+/* Returns the segment of the frame to be given, cur->pos follows it */
+static const struct segment *advance(struct tl_cursor *cur)
+{
+    const struct segment *seg;
+    seg = cur->tl->segs + cur->seg;
+    if(cur->pos >= seg->length) { /* the next segment is entered lazily */
+        cur->pos = 0;
+        cur->seg = (cur->seg+1) % cur->tl->seg_cnt;
+        enter_segment(cur);
+        seg = cur->tl->segs + cur->seg;
+    }
+    cur->pos++;
+    return seg;
+}
+
+static void enter_segment(struct tl_cursor *cur)
+{
+    while(!cur->tl->segs[cur->seg].length)
+        cur->seg = (cur->seg+1) % cur->tl->seg_cnt;
+}
+
+static int segment_color(const struct segment *seg, unsigned int pos)
+{
+    int shift, color = 0;
+    switch(seg->type) {
+    case seg_hold:
+        return seg->start;
+    case seg_random:
+        return seg->rand_col;
+    }
+    for(shift = 16; shift >= 0; shift -= 8) {
+        int st, end, ch;
+        st = (seg->start >> shift) & 0xff;
+        end = (seg->end >> shift) & 0xff;
+        ch = gradient_channel(st, end, pos, seg->length);
+        color += (ch & 0xff) << shift;
+    }
+    return color;
+}
+
+static int gradient_channel(int start, int end, unsigned int pos,
+                                                    unsigned int length)
+{
+    if(pos == 0) /* the only frame of 1-frame gradients too */
+        return start;
+    /* The float arithmetic is the one the modes have always used */
+    return (int)(start + ((float)(pos)/(length - 1))*(end - start));
+}
+
+/* How far pos is on a ramp, 0 to FRAC_ONE */
+static unsigned int ramp_fraction(const struct segment *seg,
+                                                    unsigned int pos)
+{
+    if(seg->length < 2)
+        return 0;
+    return pos*FRAC_ONE / (seg->length-1);
+}
@@ -0,0 +1,81 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File timeline.h
+ * Keyframe timelines: a list of segments (hold, linear ramp, random
+ * color) and a cursor that yields the color of the next frame.
+ * Evaluation takes the same time for every frame and the cursor wraps
+ * around at the end. The modes render a pass of it into the packets
+ * (see struct render_batch), which the sender, scenes and --save take
+ * as they are. Besides 8-bit sRGB colors the cursor can
+ * give 16-bit linear light, with gradients computed in linear light.
+ * Random colors are drawn in advance by timeline_draw, in the order
+ * of the segments and from the caller's generator; drawing again gives
+ * the next colors of a random animation that never repeats. A cursor
+ * can seek to any frame, so parts of a timeline can be evaluated apart
+ * (and in parallel) with the same result.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#ifndef TIMELINE_SENTRY
+#define TIMELINE_SENTRY
+
+/* Constants */
+#define TL_MAX_SEGS 256 /* enough for the shortest random blink pairs */
+
+/* Types */
+enum seg_type {
+    seg_hold,   /* the start color */
+    seg_linear, /* a gradient from the start to the end color */
+    seg_random  /* a random color picked when the segment begins */
+};
+
+struct segment {
+    int type;
+    int start, end;      /* hexcolors */
+    unsigned int length; /* frames, segments of 0 frames are skipped */
+    int rand_col;        /* the color of a random one, see timeline_draw */
+};
+
+struct timeline {
+    struct segment segs[TL_MAX_SEGS];
+    unsigned int seg_cnt;
+};
+
+struct tl_cursor {
+    const struct timeline *tl;
+    unsigned int seg, pos;
+};
+
+struct prng; /* see prng.h */
+
+/* Functions */
+void timeline_init(struct timeline *tl);
+int timeline_add(struct timeline *tl, int type, int start, int end,
+                                                        int length);
+unsigned long timeline_length(const struct timeline *tl);
+int timeline_draw(struct timeline *tl, unsigned long cnt, struct prng *rng);
+void tl_cursor_init(struct tl_cursor *cur, const struct timeline *tl);
+void tl_cursor_seek(struct tl_cursor *cur, unsigned long frame);
+int tl_cursor_next(struct tl_cursor *cur);
+void tl_cursor_next_lin(struct tl_cursor *cur, unsigned short *lin);
+
+#endif
@@ -0,0 +1,240 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File usbfind.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include <stdio.h> /* for fopen, snprintf & rename */
+#include <stdlib.h> /* for getenv */
+#include <string.h> /* for strcmp, strcspn & strchr */
+#include <sys/stat.h> /* for mkdir */
+#ifdef SYSFS_SCAN
+#include <dirent.h> /* for opendir */
+#endif
+
+#include "devio.h" /* for QUADCAST_2S_PID */
+#include "usbfind.h"
+
+/* Constants */
+#define PID_TABLE_SIZE 32 /* a power of 2, well above the count of ids */
+#define CACHE_DIR "quadcastrgb"
+#define CACHE_FILE "device"
+#define CACHE_PATH_LEN 4096
+#define SYSFS_DEVICES "/sys/bus/usb/devices"
+
+/* Product IDs */
+static const unsigned short product_ids_kingston[] = {
+    0x171f,
+    0
+};
+static const unsigned short product_ids_hp[] = {
+    0x0f8b,
+    0x028c,
+    0x048c,
+    0x068c,
+    0x098c,          /* Duocast */
+    0x09af,          /* Quadcast 2 */
+    QUADCAST_2S_PID, /* Quadcast 2S */
+    0
+};
+
+/* Open addressing with linear probing over VID << 16 | PID, 0 - free.
+ * The table is filled on the first lookup */
+static unsigned long pid_table[PID_TABLE_SIZE];
+static int pid_table_ready = 0;
+
+static void pid_table_fill();
+static void pid_table_add(unsigned long key);
+static unsigned int pid_hash(unsigned long key);
+static int cache_path(char *buf, int make_dirs);
+#ifdef SYSFS_SCAN
+static int sysfs_read_id(const char *dev, const char *attr,
+                                                     unsigned short *id);
+#endif
+
+/* Functions */
+int mic_is_compatible(unsigned short vid, unsigned short pid)
+{
+    unsigned long key = (unsigned long)vid << 16 | pid;
+    unsigned int i;
+    if(!pid_table_ready)
+        pid_table_fill();
+    for(i = pid_hash(key); pid_table[i]; i = (i+1) % PID_TABLE_SIZE) {
+        if(pid_table[i] == key)
+            return 1;
+    }
+    return 0;
+}
+
+/* Writes the path of dev in the sysfs notation, no I/O is done */
+void usbpath_of(libusb_device *dev, char *path)
+{
+    uint8_t ports[7];
+    int cnt, i, len;
+    len = sprintf(path, "%d", libusb_get_bus_number(dev));
+    cnt = libusb_get_port_numbers(dev, ports, sizeof(ports));
+    for(i = 0; i < cnt; i++)
+        len += sprintf(path+len, "%c%d", i ? '.' : '-', ports[i]);
+    if(cnt <= 0)
+        *path = '\0'; /* a root hub or an error, never a microphone */
+}
+
+libusb_device *usbpath_find(libusb_device **devs, ssize_t cnt,
+                                                         const char *path)
+{
+    char cur[USBPATH_LEN];
+    libusb_device **dev;
+    for(dev = devs; dev < devs+cnt; dev++) {
+        usbpath_of(*dev, cur);
+        if(strcmp(cur, path) == 0)
+            return *dev;
+    }
+    return NULL;
+}
+
+/* Returns 0 and the cached path or 1 if there is none */
+int usbcache_load(char *path)
+{
+    char file[CACHE_PATH_LEN];
+    FILE *f;
+    int ok;
+    if(cache_path(file, 0))
+        return 1;
+    f = fopen(file, "r");
+    if(!f)
+        return 1;
+    ok = fgets(path, USBPATH_LEN, f) != NULL;
+    fclose(f);
+    if(!ok)
+        return 1;
+    path[strcspn(path, "\n")] = '\0';
+    return !*path;
+}
+
+/* Failures are ignored: without the cache the search is just slower */
+void usbcache_save(const char *path)
+{
+    char file[CACHE_PATH_LEN], tmp[CACHE_PATH_LEN+4];
+    FILE *f;
+    if(cache_path(file, 1))
+        return;
+    sprintf(tmp, "%s.new", file); /* replaced at once, never half-written */
+    f = fopen(tmp, "w");
+    if(!f)
+        return;
+    fprintf(f, "%s\n", path);
+    if(fclose(f) == 0)
+        rename(tmp, file);
+    else
+        remove(tmp);
+}
+
+#ifdef SYSFS_SCAN
+/* Returns 0 and the path of the first compatible device or 1. Only the
+ * id attributes sysfs keeps in memory are read, no device is opened */
+int sysfs_find_mic(char *path)
+{
+    struct dirent *ent;
+    unsigned short vid, pid;
+    DIR *dir;
+    dir = opendir(SYSFS_DEVICES);
+    if(!dir)
+        return 1;
+    while((ent = readdir(dir))) {
+        /* interfaces have a colon in the name, root hubs have no dash */
+        if(strchr(ent->d_name, ':') || !strchr(ent->d_name, '-') ||
+                                      strlen(ent->d_name) >= USBPATH_LEN)
+            continue;
+        if(sysfs_read_id(ent->d_name, "idVendor", &vid) ||
+                                 sysfs_read_id(ent->d_name, "idProduct", &pid))
+            continue;
+        if(mic_is_compatible(vid, pid)) {
+            strcpy(path, ent->d_name);
+            closedir(dir);
+            return 0;
+        }
+    }
+    closedir(dir);
+    return 1;
+}
+
+static int sysfs_read_id(const char *dev, const char *attr,
+                                                     unsigned short *id)
+{
+    char file[CACHE_PATH_LEN];
+    FILE *f;
+    int ok;
+    sprintf(file, SYSFS_DEVICES "/%s/%s", dev, attr);
+    f = fopen(file, "r");
+    if(!f)
+        return 1;
+    ok = fscanf(f, "%hx", id) == 1;
+    fclose(f);
+    return !ok;
+}
+#endif
+
+static void pid_table_fill()
+{
+    const unsigned short *pid;
+    for(pid = product_ids_kingston; *pid; pid++)
+        pid_table_add((unsigned long)DEV_VID_KINGSTON << 16 | *pid);
+    for(pid = product_ids_hp; *pid; pid++)
+        pid_table_add((unsigned long)DEV_VID_HP << 16 | *pid);
+    pid_table_ready = 1;
+}
+
+static void pid_table_add(unsigned long key)
+{
+    unsigned int i;
+    for(i = pid_hash(key); pid_table[i]; i = (i+1) % PID_TABLE_SIZE)
+        ;
+    pid_table[i] = key;
+}
+
+static unsigned int pid_hash(unsigned long key)
+{
+    key ^= key >> 16;
+    key *= 0x45d9f3bUL;
+    key ^= key >> 16;
+    return key & (PID_TABLE_SIZE - 1);
+}
+
+/* Returns 0 and the name of the cache file in buf or 1 */
+static int cache_path(char *buf, int make_dirs)
+{
+    const char *base = getenv("XDG_CACHE_HOME"), *sub = "";
+    if(!base || !*base) {
+        base = getenv("HOME");
+        sub = "/.cache";
+    }
+    if(!base || !*base || strlen(base) + 32 >= CACHE_PATH_LEN)
+        return 1;
+    if(make_dirs) {
+        sprintf(buf, "%s%s", base, sub);
+        mkdir(buf, 0700);
+        sprintf(buf, "%s%s/" CACHE_DIR, base, sub);
+        mkdir(buf, 0755);
+    }
+    sprintf(buf, "%s%s/" CACHE_DIR "/" CACHE_FILE, base, sub);
+    return 0;
+}
@@ -0,0 +1,64 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File usbfind.h
+ * Finding the microphone among the USB devices without reading the
+ * descriptor of each of them. The bus path of the microphone opened last
+ * is kept in a cache file and tried first; on Linux, sysfs can also tell
+ * the path of a compatible device, so the unrelated ones are never
+ * touched. Either way the device found is checked against the VID & PID
+ * table before it is used, and a full scan is the last resort.
+ *
+ * A path is the bus number and the port numbers the way sysfs names the
+ * devices, e.g. 1-4.2 is port 2 of the hub at port 4 of bus 1. The cache
+ * is $XDG_CACHE_HOME/quadcastrgb/device (~/.cache by default), a single
+ * line with the path.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#ifndef USBFIND_SENTRY
+#define USBFIND_SENTRY
+
+#ifdef USBFS
+#include "usbfs.h" /* the libusb calls without libusb */
+#else
+#include <libusb-1.0/libusb.h>
+#endif
+
+/* Constants */
+#define USBPATH_LEN 32 /* enough for a bus and 7 ports, the USB maximum */
+
+/* Vendor IDs */
+#define DEV_VID_KINGSTON      0x0951
+#define DEV_VID_HP            0x03f0
+
+/* Functions */
+int mic_is_compatible(unsigned short vid, unsigned short pid);
+void usbpath_of(libusb_device *dev, char *path);
+libusb_device *usbpath_find(libusb_device **devs, ssize_t cnt,
+                                                        const char *path);
+int usbcache_load(char *path);
+void usbcache_save(const char *path);
+#ifdef SYSFS_SCAN
+int sysfs_find_mic(char *path);
+#endif
+
+#endif
@@ -0,0 +1,760 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File usbfs.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include <stdio.h> /* for snprintf & fopen */
+#include <stdlib.h> /* for malloc */
+#include <string.h> /* for strchr, strcmp & memset */
+#include <errno.h>
+#include <fcntl.h> /* for open */
+#include <unistd.h> /* for close */
+#include <poll.h>
+#include <time.h> /* for clock_gettime */
+#include <dirent.h> /* for opendir */
+#include <sys/ioctl.h>
+#include <sys/eventfd.h>
+#include <linux/usbdevice_fs.h>
+
+#include "usbfs.h"
+
+/* Constants */
+#define USBFS_NAME_LEN 32 /* of a sysfs device name */
+#define USBFS_FILE_LEN 96
+#define USBFS_LIST_STEP 16
+#define USBFS_DESC_SIZE 18
+#define USBFS_SETUP_SIZE 8 /* of a control request, before the data */
+#define USBFS_CTRL_MAX 4096 /* the data of a control transfer */
+#define USBFS_DRIVER_OWN "usbfs" /* the driver of the other programs */
+#define USBFS_MAX_POLLFDS 8 /* devices with asynchronous transfers */
+
+/* Types */
+enum xfer_state { xfer_idle, xfer_submitted, xfer_reaped };
+
+struct usbfs_transfer { /* what libusb_alloc_transfer gives is the first */
+    struct libusb_transfer pub;
+    struct usbdevfs_urb urb;
+    enum xfer_state state;
+    int cancelled;
+    struct usbfs_transfer *next; /* of the ones not idle */
+};
+
+struct libusb_context {
+    struct usbfs_transfer *xfers; /* submitted or reaped */
+    int event_fd; /* readable while a reaped transfer waits, -1 - none */
+};
+
+struct libusb_device {
+    uint8_t bus, addr;
+    uint8_t ports[USBFS_MAX_PORTS];
+    int port_cnt;
+    struct libusb_device_descriptor desc;
+};
+
+struct libusb_device_handle {
+    int fd;
+    int auto_detach;
+    unsigned int detached; /* bit N - the driver of interface N was */
+};
+
+static libusb_device *sysfs_device(const char *name);
+static int sysfs_read(const char *name, const char *attr, unsigned char *buf,
+                                                                 int size);
+static int sysfs_read_num(const char *name, const char *attr, int *num);
+static void parse_descriptor(const unsigned char *raw,
+                             struct libusb_device_descriptor *desc);
+static int detach_driver(libusb_device_handle *handle, int iface);
+static int do_urb(libusb_device_handle *handle, unsigned char type,
+                  unsigned char endpoint, unsigned char *buf, int length,
+                  unsigned int timeout);
+static long long now_ms(void);
+static void park_urb(struct usbdevfs_urb *urb);
+static void reap_urbs(int fd);
+static void run_callbacks(void);
+static enum libusb_transfer_status transfer_status(int status);
+static int sys_ioctl(int fd, unsigned long request, void *arg);
+static int urb_status(int status);
+static int errno_code(int err);
+
+/* Global variables */
+static libusb_context the_ctx = { NULL, -1 };
+
+struct usbfs_sys usbfs_sys = {
+    sys_ioctl, poll, USBFS_SYSFS_DIR, USBFS_DEV_DIR
+};
+
+/* Functions */
+/* The context only lets the callers keep the calls of libusb */
+int libusb_init(libusb_context **ctx)
+{
+    if(ctx)
+        *ctx = &the_ctx;
+    return 0;
+}
+
+void libusb_exit(libusb_context *ctx)
+{
+    if(the_ctx.event_fd >= 0)
+        close(the_ctx.event_fd);
+    the_ctx.event_fd = -1;
+}
+
+/* The devices sysfs knows, the root hubs and interfaces are left out */
+ssize_t libusb_get_device_list(libusb_context *ctx, libusb_device ***list)
+{
+    struct dirent *ent;
+    libusb_device **devs = NULL, **grown, *dev;
+    ssize_t cnt = 0, size = 0;
+    DIR *dir;
+    dir = opendir(usbfs_sys.sysfs_dir);
+    if(!dir)
+        return LIBUSB_ERROR_IO;
+    while((ent = readdir(dir))) {
+        if(strchr(ent->d_name, ':') || !strchr(ent->d_name, '-') ||
+                                      strlen(ent->d_name) >= USBFS_NAME_LEN)
+            continue;
+        dev = sysfs_device(ent->d_name);
+        if(!dev)
+            continue;
+        if(cnt + 1 >= size) { /* and the NULL at the end */
+            size += USBFS_LIST_STEP;
+            grown = realloc(devs, sizeof(*devs) * size);
+            if(!grown) {
+                free(dev);
+                break;
+            }
+            devs = grown;
+        }
+        devs[cnt++] = dev;
+    }
+    closedir(dir);
+    if(!devs)
+        devs = malloc(sizeof(*devs));
+    if(!devs)
+        return LIBUSB_ERROR_NO_MEM;
+    devs[cnt] = NULL;
+    *list = devs;
+    return cnt;
+}
+
+/* A handle doesn't refer to its device, so the devices always go */
+void libusb_free_device_list(libusb_device **list, int unref_devices)
+{
+    libusb_device **dev;
+    if(!list)
+        return;
+    for(dev = list; *dev; dev++)
+        free(*dev);
+    free(list);
+}
+
+int libusb_get_device_descriptor(libusb_device *dev,
+                                 struct libusb_device_descriptor *desc)
+{
+    *desc = dev->desc;
+    return 0;
+}
+
+uint8_t libusb_get_bus_number(libusb_device *dev)
+{
+    return dev->bus;
+}
+
+int libusb_get_port_numbers(libusb_device *dev, uint8_t *ports, int len)
+{
+    if(dev->port_cnt > len)
+        return LIBUSB_ERROR_OVERFLOW;
+    memcpy(ports, dev->ports, dev->port_cnt);
+    return dev->port_cnt;
+}
+
+int libusb_open(libusb_device *dev, libusb_device_handle **handle)
+{
+    char file[USBFS_FILE_LEN];
+    libusb_device_handle *h;
+    h = malloc(sizeof(*h));
+    if(!h)
+        return LIBUSB_ERROR_NO_MEM;
+    snprintf(file, sizeof(file), "%s/%03d/%03d", usbfs_sys.dev_dir,
+                                                   dev->bus, dev->addr);
+    h->fd = open(file, O_RDWR | O_CLOEXEC);
+    if(h->fd < 0) {
+        int err = errno;
+        free(h);
+        return err == ENOENT ? LIBUSB_ERROR_NO_DEVICE : errno_code(err);
+    }
+    h->auto_detach = 0;
+    h->detached = 0;
+    *handle = h;
+    return 0;
+}
+
+/* The kernel discards the URBs left, their transfers go idle without
+ * the callbacks */
+void libusb_close(libusb_device_handle *handle)
+{
+    struct usbfs_transfer **p, *t;
+    if(!handle)
+        return;
+    for(p = &the_ctx.xfers; (t = *p);) {
+        if(t->pub.dev_handle != handle) {
+            p = &t->next;
+            continue;
+        }
+        t->state = xfer_idle;
+        *p = t->next;
+    }
+    close(handle->fd);
+    free(handle);
+}
+
+int libusb_set_auto_detach_kernel_driver(libusb_device_handle *handle,
+                                                               int enable)
+{
+    handle->auto_detach = enable;
+    return 0;
+}
+
+/* A kernel driver is detached if it's allowed, the one of another program
+ * using usbfs never is */
+int libusb_claim_interface(libusb_device_handle *handle, int iface)
+{
+    unsigned int num = iface;
+    if(!usbfs_sys.ioctl(handle->fd, USBDEVFS_CLAIMINTERFACE, &num))
+        return 0;
+    if(errno != EBUSY || !handle->auto_detach)
+        return errno_code(errno);
+    if(detach_driver(handle, iface))
+        return LIBUSB_ERROR_BUSY;
+    if(usbfs_sys.ioctl(handle->fd, USBDEVFS_CLAIMINTERFACE, &num))
+        return errno_code(errno);
+    return 0;
+}
+
+/* Gives the interface back to the kernel driver if it was detached */
+int libusb_release_interface(libusb_device_handle *handle, int iface)
+{
+    struct usbdevfs_ioctl cmd;
+    unsigned int num = iface;
+    if(usbfs_sys.ioctl(handle->fd, USBDEVFS_RELEASEINTERFACE, &num))
+        return errno_code(errno);
+    if(iface < 32 && handle->detached & 1u << iface) {
+        memset(&cmd, 0, sizeof(cmd));
+        cmd.ifno = iface;
+        cmd.ioctl_code = USBDEVFS_CONNECT;
+        usbfs_sys.ioctl(handle->fd, USBDEVFS_IOCTL, &cmd);
+        handle->detached &= ~(1u << iface);
+    }
+    return 0;
+}
+
+/* Returns the bytes sent or an error code. The setup and the data go in
+ * one buffer, the only copy of a transfer */
+int libusb_control_transfer(libusb_device_handle *handle,
+                            uint8_t request_type, uint8_t request,
+                            uint16_t value, uint16_t index,
+                            unsigned char *data, uint16_t length,
+                            unsigned int timeout)
+{
+    unsigned char buf[USBFS_SETUP_SIZE + USBFS_CTRL_MAX];
+    int res;
+    if(length > USBFS_CTRL_MAX)
+        return LIBUSB_ERROR_INVALID_PARAM;
+    buf[0] = request_type;
+    buf[1] = request;
+    buf[2] = value & 0xff;
+    buf[3] = value >> 8;
+    buf[4] = index & 0xff;
+    buf[5] = index >> 8;
+    buf[6] = length & 0xff;
+    buf[7] = length >> 8;
+    if(!(request_type & LIBUSB_ENDPOINT_IN))
+        memcpy(buf + USBFS_SETUP_SIZE, data, length);
+    res = do_urb(handle, USBDEVFS_URB_TYPE_CONTROL, 0, buf,
+                                    USBFS_SETUP_SIZE + length, timeout);
+    if(res >= 0 && request_type & LIBUSB_ENDPOINT_IN)
+        memcpy(data, buf + USBFS_SETUP_SIZE, res);
+    return res;
+}
+
+int libusb_interrupt_transfer(libusb_device_handle *handle,
+                              unsigned char endpoint, unsigned char *data,
+                              int length, int *transferred,
+                              unsigned int timeout)
+{
+    int res;
+    res = do_urb(handle, USBDEVFS_URB_TYPE_INTERRUPT, endpoint, data, length,
+                                                                  timeout);
+    *transferred = res < 0 ? 0 : res;
+    return res < 0 ? res : 0;
+}
+
+struct libusb_transfer *libusb_alloc_transfer(int iso_packets)
+{
+    struct usbfs_transfer *t;
+    if(iso_packets)
+        return NULL;
+    t = calloc(1, sizeof(*t));
+    return t ? &t->pub : NULL;
+}
+
+void libusb_free_transfer(struct libusb_transfer *xfer)
+{
+    free(xfer); /* the first field of its usbfs_transfer */
+}
+
+/* The buffer of a control transfer starts with the setup, as in libusb */
+int libusb_submit_transfer(struct libusb_transfer *xfer)
+{
+    struct usbfs_transfer *t = (struct usbfs_transfer *)xfer;
+    if(t->state != xfer_idle)
+        return LIBUSB_ERROR_BUSY;
+    if(xfer->timeout)
+        return LIBUSB_ERROR_NOT_SUPPORTED;
+    memset(&t->urb, 0, sizeof(t->urb));
+    switch(xfer->type) {
+    case LIBUSB_TRANSFER_TYPE_CONTROL:
+        t->urb.type = USBDEVFS_URB_TYPE_CONTROL;
+        break;
+    case LIBUSB_TRANSFER_TYPE_INTERRUPT:
+        t->urb.type = USBDEVFS_URB_TYPE_INTERRUPT;
+        t->urb.endpoint = xfer->endpoint;
+        break;
+    default:
+        return LIBUSB_ERROR_NOT_SUPPORTED;
+    }
+    t->urb.buffer = xfer->buffer;
+    t->urb.buffer_length = xfer->length;
+    t->urb.usercontext = t;
+    if(usbfs_sys.ioctl(xfer->dev_handle->fd, USBDEVFS_SUBMITURB, &t->urb))
+        return errno_code(errno);
+    t->state = xfer_submitted;
+    t->cancelled = 0;
+    t->next = the_ctx.xfers;
+    the_ctx.xfers = t;
+    return 0;
+}
+
+/* The callback gets LIBUSB_TRANSFER_CANCELLED with the events */
+int libusb_cancel_transfer(struct libusb_transfer *xfer)
+{
+    struct usbfs_transfer *t = (struct usbfs_transfer *)xfer;
+    if(t->state != xfer_submitted || t->cancelled)
+        return LIBUSB_ERROR_NOT_FOUND;
+    if(usbfs_sys.ioctl(xfer->dev_handle->fd, USBDEVFS_DISCARDURB, &t->urb))
+        return errno == EINVAL ? LIBUSB_ERROR_NOT_FOUND : errno_code(errno);
+    t->cancelled = 1;
+    return 0;
+}
+
+/* Waits up to tv for the URBs unless some are reaped already, then runs
+ * the callbacks of the reaped ones */
+int libusb_handle_events_timeout_completed(libusb_context *ctx,
+                                           struct timeval *tv,
+                                           int *completed)
+{
+    struct pollfd pfds[USBFS_MAX_POLLFDS];
+    struct usbfs_transfer *t;
+    uint64_t cnt;
+    int i, fds = 0, wait, res;
+    if(completed && *completed)
+        return 0;
+    wait = tv->tv_sec*1000 + tv->tv_usec/1000;
+    for(t = the_ctx.xfers; t; t = t->next) {
+        if(t->state == xfer_reaped)
+            wait = 0;
+        for(i = 0; i < fds && pfds[i].fd != t->pub.dev_handle->fd; i++)
+            ;
+        if(i == fds && fds < USBFS_MAX_POLLFDS) {
+            pfds[fds].fd = t->pub.dev_handle->fd;
+            pfds[fds].events = POLLOUT;
+            pfds[fds++].revents = 0;
+        }
+    }
+    res = usbfs_sys.poll(pfds, fds, wait);
+    if(res < 0)
+        return errno == EINTR ? LIBUSB_ERROR_INTERRUPTED : LIBUSB_ERROR_IO;
+    for(i = 0; i < fds; i++) {
+        if(pfds[i].revents)
+            reap_urbs(pfds[i].fd);
+    }
+    if(the_ctx.event_fd >= 0 &&
+                       read(the_ctx.event_fd, &cnt, sizeof(cnt)) < 0 &&
+                       errno != EAGAIN)
+        perror("eventfd");
+    run_callbacks();
+    return 0;
+}
+
+/* The event fd and the fds of the devices with URBs, NULL-terminated */
+const struct libusb_pollfd **libusb_get_pollfds(libusb_context *ctx)
+{
+    const struct libusb_pollfd **list;
+    struct libusb_pollfd *fds;
+    struct usbfs_transfer *t;
+    int i, cnt = 0, max = 0;
+    if(the_ctx.event_fd < 0)
+        the_ctx.event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    for(t = the_ctx.xfers; t; t = t->next)
+        max++;
+    list = malloc((max + 2)*sizeof(*list) + (max + 1)*sizeof(*fds));
+    if(!list)
+        return NULL;
+    fds = (struct libusb_pollfd *)(list + max + 2);
+    if(the_ctx.event_fd >= 0) {
+        fds[cnt].fd = the_ctx.event_fd;
+        fds[cnt++].events = POLLIN;
+    }
+    for(t = the_ctx.xfers; t; t = t->next) {
+        for(i = 0; i < cnt && fds[i].fd != t->pub.dev_handle->fd; i++)
+            ;
+        if(i == cnt) {
+            fds[cnt].fd = t->pub.dev_handle->fd;
+            fds[cnt++].events = POLLOUT;
+        }
+    }
+    for(i = 0; i < cnt; i++)
+        list[i] = fds + i;
+    list[cnt] = NULL;
+    return list;
+}
+
+void libusb_free_pollfds(const struct libusb_pollfd **pollfds)
+{
+    free(pollfds);
+}
+
+int libusb_clear_halt(libusb_device_handle *handle, unsigned char endpoint)
+{
+    unsigned int ep = endpoint;
+    return usbfs_sys.ioctl(handle->fd, USBDEVFS_CLEAR_HALT, &ep) ?
+                                              errno_code(errno) : 0;
+}
+
+const char *libusb_strerror(int errcode)
+{
+    switch(errcode) {
+    case LIBUSB_SUCCESS:
+        return "Success";
+    case LIBUSB_ERROR_IO:
+        return "Input/Output Error";
+    case LIBUSB_ERROR_INVALID_PARAM:
+        return "Invalid parameter";
+    case LIBUSB_ERROR_ACCESS:
+        return "Access denied (insufficient permissions)";
+    case LIBUSB_ERROR_NO_DEVICE:
+        return "No such device (it may have been disconnected)";
+    case LIBUSB_ERROR_NOT_FOUND:
+        return "Entity not found";
+    case LIBUSB_ERROR_BUSY:
+        return "Resource busy";
+    case LIBUSB_ERROR_TIMEOUT:
+        return "Operation timed out";
+    case LIBUSB_ERROR_OVERFLOW:
+        return "Overflow";
+    case LIBUSB_ERROR_PIPE:
+        return "Pipe error";
+    case LIBUSB_ERROR_INTERRUPTED:
+        return "System call interrupted (perhaps due to signal)";
+    case LIBUSB_ERROR_NO_MEM:
+        return "Insufficient memory";
+    case LIBUSB_ERROR_NOT_SUPPORTED:
+        return "Operation not supported or unimplemented on this platform";
+    }
+    return "Other error";
+}
+
+/* The name is the path of the device, e.g. 1-4.2, the rest comes from
+ * the attributes kept in memory, the device isn't opened */
+static libusb_device *sysfs_device(const char *name)
+{
+    unsigned char raw[USBFS_DESC_SIZE];
+    libusb_device *dev;
+    const char *p;
+    int bus, addr;
+    if(sysfs_read_num(name, "busnum", &bus) ||
+                                     sysfs_read_num(name, "devnum", &addr))
+        return NULL;
+    if(sysfs_read(name, "descriptors", raw, sizeof(raw)) != sizeof(raw))
+        return NULL;
+    dev = malloc(sizeof(*dev));
+    if(!dev)
+        return NULL;
+    dev->bus = bus;
+    dev->addr = addr;
+    dev->port_cnt = 0;
+    for(p = strchr(name, '-'); p && dev->port_cnt < USBFS_MAX_PORTS;
+                                                      p = strchr(p, '.'))
+        dev->ports[dev->port_cnt++] = strtol(++p, NULL, 10);
+    parse_descriptor(raw, &dev->desc);
+    return dev;
+}
+
+/* Returns the bytes read or -1 */
+static int sysfs_read(const char *name, const char *attr, unsigned char *buf,
+                                                                 int size)
+{
+    char file[USBFS_FILE_LEN];
+    FILE *f;
+    int cnt;
+    snprintf(file, sizeof(file), "%s/%s/%s", usbfs_sys.sysfs_dir, name,
+                                                               attr);
+    f = fopen(file, "r");
+    if(!f)
+        return -1;
+    cnt = fread(buf, 1, size, f);
+    fclose(f);
+    return cnt;
+}
+
+static int sysfs_read_num(const char *name, const char *attr, int *num)
+{
+    unsigned char buf[16];
+    int cnt;
+    cnt = sysfs_read(name, attr, buf, sizeof(buf)-1);
+    if(cnt <= 0)
+        return 1;
+    buf[cnt] = '\0';
+    *num = strtol((char *)buf, NULL, 10);
+    return 0;
+}
+
+/* The descriptor is little-endian on the wire */
+static void parse_descriptor(const unsigned char *raw,
+                             struct libusb_device_descriptor *desc)
+{
+    desc->bLength = raw[0];
+    desc->bDescriptorType = raw[1];
+    desc->bcdUSB = raw[2] | raw[3] << 8;
+    desc->bDeviceClass = raw[4];
+    desc->bDeviceSubClass = raw[5];
+    desc->bDeviceProtocol = raw[6];
+    desc->bMaxPacketSize0 = raw[7];
+    desc->idVendor = raw[8] | raw[9] << 8;
+    desc->idProduct = raw[10] | raw[11] << 8;
+    desc->bcdDevice = raw[12] | raw[13] << 8;
+    desc->iManufacturer = raw[14];
+    desc->iProduct = raw[15];
+    desc->iSerialNumber = raw[16];
+    desc->bNumConfigurations = raw[17];
+}
+
+static int detach_driver(libusb_device_handle *handle, int iface)
+{
+    struct usbdevfs_getdriver drv;
+    struct usbdevfs_ioctl cmd;
+    memset(&drv, 0, sizeof(drv));
+    drv.interface = iface;
+    if(usbfs_sys.ioctl(handle->fd, USBDEVFS_GETDRIVER, &drv) ||
+                                 strcmp(drv.driver, USBFS_DRIVER_OWN) == 0)
+        return 1;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.ifno = iface;
+    cmd.ioctl_code = USBDEVFS_DISCONNECT;
+    if(usbfs_sys.ioctl(handle->fd, USBDEVFS_IOCTL, &cmd))
+        return 1;
+    if(iface < 32)
+        handle->detached |= 1u << iface;
+    return 0;
+}
+
+/* Submits an URB and waits for it, the device fd becomes writable when
+ * there is an URB to reap. An URB that doesn't finish in time is
+ * discarded; an asynchronous one reaped meanwhile is parked for the
+ * events. Returns the bytes transferred or an error code */
+static int do_urb(libusb_device_handle *handle, unsigned char type,
+                  unsigned char endpoint, unsigned char *buf, int length,
+                  unsigned int timeout)
+{
+    struct usbdevfs_urb urb, *reaped;
+    struct pollfd pfd;
+    long long end;
+    int res, wait, discarded = 0;
+    memset(&urb, 0, sizeof(urb));
+    urb.type = type;
+    urb.endpoint = endpoint;
+    urb.buffer = buf;
+    urb.buffer_length = length;
+    if(usbfs_sys.ioctl(handle->fd, USBDEVFS_SUBMITURB, &urb))
+        return errno_code(errno);
+    end = now_ms() + timeout;
+    pfd.fd = handle->fd;
+    pfd.events = POLLOUT;
+    for(;;) {
+        wait = -1;
+        if(timeout && !discarded) {
+            wait = end - now_ms();
+            if(wait < 0)
+                wait = 0;
+        }
+        do {
+            res = usbfs_sys.poll(&pfd, 1, wait);
+        } while(res < 0 && errno == EINTR);
+        if(res == 0 && !discarded) {
+            usbfs_sys.ioctl(handle->fd, USBDEVFS_DISCARDURB, &urb);
+            discarded = 1;
+        }
+        do { /* a discarded URB is reaped as well, with -ENOENT */
+            res = usbfs_sys.ioctl(handle->fd, USBDEVFS_REAPURB, &reaped);
+        } while(res && errno == EINTR);
+        if(res)
+            return errno_code(errno);
+        if(reaped == &urb)
+            break;
+        park_urb(reaped);
+    }
+    if(urb.status == -ENOENT || urb.status == -ECONNRESET)
+        return LIBUSB_ERROR_TIMEOUT;
+    if(urb.status)
+        return urb_status(urb.status);
+    return urb.actual_length; /* the setup of a control one isn't counted */
+}
+
+static long long now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec*1000 + ts.tv_nsec/1000000;
+}
+
+/* The callback of the transfer runs with the next events, the event fd
+ * wakes the ones sleeping on the pollfds till then */
+static void park_urb(struct usbdevfs_urb *urb)
+{
+    struct usbfs_transfer *t = urb->usercontext;
+    uint64_t one = 1;
+    if(!t)
+        return;
+    t->state = xfer_reaped;
+    if(the_ctx.event_fd >= 0 &&
+                       write(the_ctx.event_fd, &one, sizeof(one)) < 0)
+        perror("eventfd");
+}
+
+/* Takes every URB the fd has without waiting. A device gone takes the
+ * transfers on it along */
+static void reap_urbs(int fd)
+{
+    struct usbdevfs_urb *reaped;
+    struct usbfs_transfer *t;
+    while(!usbfs_sys.ioctl(fd, USBDEVFS_REAPURBNDELAY, &reaped))
+        park_urb(reaped);
+    if(errno == EAGAIN || errno == EINTR)
+        return;
+    for(t = the_ctx.xfers; t; t = t->next) {
+        if(t->state == xfer_submitted && t->pub.dev_handle->fd == fd) {
+            t->urb.status = -ENODEV;
+            t->urb.actual_length = 0;
+            t->state = xfer_reaped;
+        }
+    }
+}
+
+/* The reaped transfers go idle first, so a callback may submit again */
+static void run_callbacks(void)
+{
+    struct usbfs_transfer **p, *t, *done = NULL;
+    for(p = &the_ctx.xfers; (t = *p);) {
+        if(t->state != xfer_reaped) {
+            p = &t->next;
+            continue;
+        }
+        *p = t->next;
+        t->next = done;
+        done = t;
+    }
+    while((t = done)) {
+        done = t->next;
+        t->state = xfer_idle;
+        t->pub.status = transfer_status(t->urb.status);
+        t->pub.actual_length = t->urb.actual_length;
+        t->pub.callback(&t->pub);
+    }
+}
+
+static enum libusb_transfer_status transfer_status(int status)
+{
+    switch(-status) {
+    case 0:
+        return LIBUSB_TRANSFER_COMPLETED;
+    case ENOENT:
+    case ECONNRESET:
+        return LIBUSB_TRANSFER_CANCELLED;
+    case EPIPE:
+        return LIBUSB_TRANSFER_STALL;
+    case EOVERFLOW:
+        return LIBUSB_TRANSFER_OVERFLOW;
+    case ETIMEDOUT:
+        return LIBUSB_TRANSFER_TIMED_OUT;
+    case ENODEV:
+    case ESHUTDOWN:
+        return LIBUSB_TRANSFER_NO_DEVICE;
+    }
+    return LIBUSB_TRANSFER_ERROR;
+}
+
+static int sys_ioctl(int fd, unsigned long request, void *arg)
+{
+    return ioctl(fd, request, arg);
+}
+
+static int urb_status(int status)
+{
+    switch(-status) {
+    case EPIPE:
+        return LIBUSB_ERROR_PIPE;
+    case EOVERFLOW:
+        return LIBUSB_ERROR_OVERFLOW;
+    case ETIMEDOUT:
+        return LIBUSB_ERROR_TIMEOUT;
+    case ENODEV:
+    case ESHUTDOWN:
+        return LIBUSB_ERROR_NO_DEVICE;
+    }
+    return LIBUSB_ERROR_IO;
+}
+
+static int errno_code(int err)
+{
+    switch(err) {
+    case EACCES:
+    case EPERM:
+        return LIBUSB_ERROR_ACCESS;
+    case ENODEV:
+        return LIBUSB_ERROR_NO_DEVICE;
+    case ENOENT:
+        return LIBUSB_ERROR_NOT_FOUND;
+    case EBUSY:
+        return LIBUSB_ERROR_BUSY;
+    case ENOMEM:
+        return LIBUSB_ERROR_NO_MEM;
+    case EINVAL:
+        return LIBUSB_ERROR_INVALID_PARAM;
+    case EINTR:
+        return LIBUSB_ERROR_INTERRUPTED;
+    case ENOSYS:
+    case ENOTTY:
+        return LIBUSB_ERROR_NOT_SUPPORTED;
+    }
+    return LIBUSB_ERROR_IO;
+}
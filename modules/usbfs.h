@@ -0,0 +1,191 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File usbfs.h
+ * The libusb calls the program makes, done right over the usbfs of Linux
+ * for a build without libusb (make BACKEND=usbfs). The devices are found
+ * in sysfs and opened at /dev/bus/usb/BUS/DEV; transfers are URBs
+ * submitted and reaped with the usbfs ioctls, the buffer of an interrupt
+ * transfer goes to the kernel as it is. There is a single context, so
+ * the context arguments are ignored.
+ *
+ * An asynchronous transfer is an URB of its own as well: it's reaped when
+ * the events are handled and its callback runs there. A synchronous
+ * transfer may reap it first, then it waits for the events, which the
+ * event file descriptor (see libusb_get_pollfds) wakes. The timeout of an
+ * asynchronous transfer isn't supported.
+ *
+ * Only what devio.c, usbfind.c and mutewatch.c use is here, with the
+ * names, types and error codes of libusb, so the rest of the program
+ * works with either. The system calls go through usbfs_sys, the tests
+ * put a fake device there.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#ifndef USBFS_SENTRY
+#define USBFS_SENTRY
+
+#include <stdint.h> /* for the fields of the descriptor */
+#include <sys/types.h> /* for ssize_t */
+#include <sys/time.h> /* for struct timeval */
+#include <poll.h>
+
+/* Constants */
+#define LIBUSB_ENDPOINT_IN 0x80
+#define USBFS_MAX_PORTS 7 /* the USB maximum of the tiers */
+#define USBFS_SYSFS_DIR "/sys/bus/usb/devices"
+#define USBFS_DEV_DIR "/dev/bus/usb"
+#define LIBUSB_CALL
+#define LIBUSB_TRANSFER_TYPE_CONTROL 0
+#define LIBUSB_TRANSFER_TYPE_INTERRUPT 3
+
+enum libusb_error {
+    LIBUSB_SUCCESS = 0,
+    LIBUSB_ERROR_IO = -1,
+    LIBUSB_ERROR_INVALID_PARAM = -2,
+    LIBUSB_ERROR_ACCESS = -3,
+    LIBUSB_ERROR_NO_DEVICE = -4,
+    LIBUSB_ERROR_NOT_FOUND = -5,
+    LIBUSB_ERROR_BUSY = -6,
+    LIBUSB_ERROR_TIMEOUT = -7,
+    LIBUSB_ERROR_OVERFLOW = -8,
+    LIBUSB_ERROR_PIPE = -9,
+    LIBUSB_ERROR_INTERRUPTED = -10,
+    LIBUSB_ERROR_NO_MEM = -11,
+    LIBUSB_ERROR_NOT_SUPPORTED = -12,
+    LIBUSB_ERROR_OTHER = -99
+};
+
+enum libusb_transfer_status {
+    LIBUSB_TRANSFER_COMPLETED,
+    LIBUSB_TRANSFER_ERROR,
+    LIBUSB_TRANSFER_TIMED_OUT,
+    LIBUSB_TRANSFER_CANCELLED,
+    LIBUSB_TRANSFER_STALL,
+    LIBUSB_TRANSFER_NO_DEVICE,
+    LIBUSB_TRANSFER_OVERFLOW
+};
+
+/* Types */
+typedef struct libusb_context libusb_context;
+typedef struct libusb_device libusb_device;
+typedef struct libusb_device_handle libusb_device_handle;
+
+struct libusb_device_descriptor { /* the standard one, 18 bytes */
+    uint8_t bLength;
+    uint8_t bDescriptorType;
+    uint16_t bcdUSB;
+    uint8_t bDeviceClass;
+    uint8_t bDeviceSubClass;
+    uint8_t bDeviceProtocol;
+    uint8_t bMaxPacketSize0;
+    uint16_t idVendor;
+    uint16_t idProduct;
+    uint16_t bcdDevice;
+    uint8_t iManufacturer;
+    uint8_t iProduct;
+    uint8_t iSerialNumber;
+    uint8_t bNumConfigurations;
+};
+
+struct libusb_transfer;
+typedef void (LIBUSB_CALL *libusb_transfer_cb_fn)(struct libusb_transfer *);
+
+struct libusb_transfer {
+    libusb_device_handle *dev_handle;
+    uint8_t flags;
+    unsigned char endpoint;
+    unsigned char type;
+    unsigned int timeout; /* must be 0 */
+    enum libusb_transfer_status status;
+    int length;
+    int actual_length;
+    libusb_transfer_cb_fn callback;
+    void *user_data;
+    unsigned char *buffer;
+    int num_iso_packets;
+};
+
+struct libusb_pollfd {
+    int fd;
+    short events;
+};
+
+struct usbfs_sys {
+    int (*ioctl)(int fd, unsigned long request, void *arg);
+    int (*poll)(struct pollfd *pfds, nfds_t cnt, int timeout);
+    const char *sysfs_dir, *dev_dir;
+};
+
+extern struct usbfs_sys usbfs_sys;
+
+/* Functions */
+int libusb_init(libusb_context **ctx);
+void libusb_exit(libusb_context *ctx);
+ssize_t libusb_get_device_list(libusb_context *ctx, libusb_device ***list);
+void libusb_free_device_list(libusb_device **list, int unref_devices);
+int libusb_get_device_descriptor(libusb_device *dev,
+                                 struct libusb_device_descriptor *desc);
+uint8_t libusb_get_bus_number(libusb_device *dev);
+int libusb_get_port_numbers(libusb_device *dev, uint8_t *ports, int len);
+int libusb_open(libusb_device *dev, libusb_device_handle **handle);
+void libusb_close(libusb_device_handle *handle);
+int libusb_set_auto_detach_kernel_driver(libusb_device_handle *handle,
+                                                              int enable);
+int libusb_claim_interface(libusb_device_handle *handle, int iface);
+int libusb_release_interface(libusb_device_handle *handle, int iface);
+int libusb_control_transfer(libusb_device_handle *handle,
+                            uint8_t request_type, uint8_t request,
+                            uint16_t value, uint16_t index,
+                            unsigned char *data, uint16_t length,
+                            unsigned int timeout);
+int libusb_interrupt_transfer(libusb_device_handle *handle,
+                              unsigned char endpoint, unsigned char *data,
+                              int length, int *transferred,
+                              unsigned int timeout);
+int libusb_clear_halt(libusb_device_handle *handle, unsigned char endpoint);
+const char *libusb_strerror(int errcode);
+struct libusb_transfer *libusb_alloc_transfer(int iso_packets);
+void libusb_free_transfer(struct libusb_transfer *xfer);
+int libusb_submit_transfer(struct libusb_transfer *xfer);
+int libusb_cancel_transfer(struct libusb_transfer *xfer);
+int libusb_handle_events_timeout_completed(libusb_context *ctx,
+                                           struct timeval *tv,
+                                           int *completed);
+const struct libusb_pollfd **libusb_get_pollfds(libusb_context *ctx);
+void libusb_free_pollfds(const struct libusb_pollfd **pollfds);
+
+static inline void libusb_fill_interrupt_transfer(
+    struct libusb_transfer *xfer, libusb_device_handle *handle,
+    unsigned char endpoint, unsigned char *buf, int length,
+    libusb_transfer_cb_fn callback, void *user_data, unsigned int timeout)
+{
+    xfer->dev_handle = handle;
+    xfer->endpoint = endpoint;
+    xfer->type = LIBUSB_TRANSFER_TYPE_INTERRUPT;
+    xfer->timeout = timeout;
+    xfer->buffer = buf;
+    xfer->length = length;
+    xfer->callback = callback;
+    xfer->user_data = user_data;
+}
+
+#endif
@@ -0,0 +1,145 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File workpool.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include <pthread.h>
+#include <unistd.h> /* for sysconf */
+
+#include "workpool.h"
+
+/* Types */
+struct run { /* tasks first..last-1 that are left to a thread */
+    pthread_mutex_t lock;
+    int first, last;
+};
+
+struct pool {
+    struct run runs[WORKPOOL_MAX_THREADS];
+    int run_cnt;
+    work_fn fn;
+    char *tasks;
+    size_t task_size;
+};
+
+struct worker {
+    struct pool *pool;
+    int id; /* the run of its own */
+};
+
+static void *worker_main(void *arg);
+static int take_task(struct pool *p, int id);
+static int pop_first(struct run *r);
+static int pop_last(struct run *r);
+
+/* Functions */
+/* The number of threads worth starting: the CPUs online, within limits */
+int workpool_threads()
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if(cpus < 1)
+        return 1;
+    return cpus > WORKPOOL_MAX_THREADS ? WORKPOOL_MAX_THREADS : (int)cpus;
+}
+
+/* Calls fn for each of cnt tasks, threads - 0 to take workpool_threads.
+ * Returns when all the tasks are done */
+void workpool_run(work_fn fn, void *tasks, size_t task_size, int cnt,
+                                                               int threads)
+{
+    pthread_t tids[WORKPOOL_MAX_THREADS];
+    int started[WORKPOOL_MAX_THREADS];
+    struct worker workers[WORKPOOL_MAX_THREADS];
+    struct pool p;
+    int i;
+    if(threads <= 0 || threads > WORKPOOL_MAX_THREADS)
+        threads = workpool_threads();
+    if(threads > cnt)
+        threads = cnt;
+    if(threads <= 1) { /* no need for any threads */
+        for(i = 0; i < cnt; i++)
+            fn((char *)tasks + i*task_size);
+        return;
+    }
+    p.run_cnt = threads;
+    p.fn = fn;
+    p.tasks = tasks;
+    p.task_size = task_size;
+    for(i = 0; i < threads; i++) {
+        pthread_mutex_init(&p.runs[i].lock, NULL);
+        p.runs[i].first = (long)cnt*i/threads;
+        p.runs[i].last = (long)cnt*(i+1)/threads;
+        workers[i].pool = &p;
+        workers[i].id = i;
+    }
+    for(i = 1; i < threads; i++) /* the calling thread is worker 0 */
+        started[i] = !pthread_create(tids+i, NULL, worker_main, workers+i);
+    worker_main(workers);
+    for(i = 1; i < threads; i++) {
+        if(started[i])
+            pthread_join(tids[i], NULL);
+    }
+    for(i = 0; i < threads; i++)
+        pthread_mutex_destroy(&p.runs[i].lock);
+}
+
+static void *worker_main(void *arg)
+{
+    struct worker *w = arg;
+    struct pool *p = w->pool;
+    int task;
+    while((task = take_task(p, w->id)) >= 0)
+        p->fn(p->tasks + task*p->task_size);
+    return NULL;
+}
+
+/* Returns a task left in the own run or stolen from another one, -1 if
+ * every run is empty */
+static int take_task(struct pool *p, int id)
+{
+    int i, task;
+    task = pop_first(p->runs + id);
+    for(i = 1; task < 0 && i < p->run_cnt; i++)
+        task = pop_last(p->runs + (id+i) % p->run_cnt);
+    return task;
+}
+
+static int pop_first(struct run *r)
+{
+    int task = -1;
+    pthread_mutex_lock(&r->lock);
+    if(r->first < r->last)
+        task = r->first++;
+    pthread_mutex_unlock(&r->lock);
+    return task;
+}
+
+static int pop_last(struct run *r)
+{
+    int task = -1;
+    pthread_mutex_lock(&r->lock);
+    if(r->first < r->last)
+        task = --r->last;
+    pthread_mutex_unlock(&r->lock);
+    return task;
+}
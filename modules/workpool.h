@@ -0,0 +1,50 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File workpool.h
+ * A small work-stealing pool for independent tasks of the same size.
+ * The tasks are split into contiguous runs, one per thread; a thread
+ * takes tasks from the front of its own run and, when it is empty,
+ * steals from the back of the others. The threads live for a single
+ * workpool_run call, so nothing keeps running across a fork() or in a
+ * program that embeds the library, and if a thread can't be started its
+ * run is stolen by the rest. Tasks must only write to memory of their
+ * own, then the result doesn't depend on which thread runs what.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#ifndef WORKPOOL_SENTRY
+#define WORKPOOL_SENTRY
+
+#include <stddef.h> /* for size_t */
+
+/* Constants */
+#define WORKPOOL_MAX_THREADS 8
+
+/* Types */
+typedef void (*work_fn)(void *task);
+
+/* Functions */
+int workpool_threads();
+void workpool_run(work_fn fn, void *tasks, size_t task_size, int cnt,
+                                                              int threads);
+
+#endif
@@ -0,0 +1,183 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File capture_test.c
+ * --analyze of captures: a capture recorded by the send loop (with the
+ * governor holding frames) is analyzed into the JSON checked in next to
+ * it, a written one counts its dropped and duplicated frames whether the
+ * reporter thread writes it or not, one longer than the ring keeps all
+ * of its records, and one of a single frame is refused.
+ *
+ * The capture is in the byte order of the machine that recorded it, a
+ * little-endian one, so it's only compared on such machines.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include <stdint.h>
+
+#include "../modules/capture.h"
+#include "../modules/devio.h" /* for FRAME_PERIOD */
+#include "../modules/reporter.h"
+#include "testutil.h"
+
+#define RECORDED "tests/data/capture.qcap"
+#define RECORDED_JSON "tests/data/capture.json"
+#define QS_PID 0x171f
+#define JSON_LEN 1024
+
+/* Runs capture_analyze(path) with stdout going to json, returns what
+ * capture_analyze does */
+static int analyze(const char *path, char *json)
+{
+    char out[sizeof(TMP_TEMPLATE)];
+    int fd, saved, errcode;
+    ssize_t len;
+    strcpy(out, TMP_TEMPLATE);
+    fd = mkstemp(out);
+    if(fd < 0)
+        return -1;
+    fflush(stdout);
+    saved = dup(1);
+    dup2(fd, 1);
+    errcode = capture_analyze(path);
+    fflush(stdout);
+    dup2(saved, 1);
+    close(saved);
+    len = pread(fd, json, JSON_LEN-1, 0);
+    json[len > 0 ? len : 0] = '\0';
+    close(fd);
+    unlink(out);
+    return errcode;
+}
+
+static int read_file(const char *path, char *buf)
+{
+    FILE *f = fopen(path, "r");
+    size_t len;
+    if(!f)
+        return 1;
+    len = fread(buf, 1, JSON_LEN-1, f);
+    buf[len] = '\0';
+    fclose(f);
+    return 0;
+}
+
+static void test_recorded(void)
+{
+    const uint16_t one = 1;
+    char json[JSON_LEN], want[JSON_LEN];
+    if(*(const unsigned char *)&one != 1) {
+        puts("capture: big-endian, the recorded capture is skipped");
+        return;
+    }
+    CHECK(analyze(RECORDED, json) == 0);
+    CHECK(read_file(RECORDED_JSON, want) == 0);
+    CHECK(!strcmp(json, want));
+}
+
+/* Frames 0, 1, then 3 (2 is dropped) and 3 again (duplicated) a frame
+ * period apart: the duplicate is the drift */
+static void test_written(int drained)
+{
+    struct capture cap;
+    char path[sizeof(TMP_TEMPLATE)], json[JSON_LEN], drift[64];
+    unsigned long long period = FRAME_PERIOD(QS_PID) * 1000ULL;
+    int fd;
+    strcpy(path, TMP_TEMPLATE);
+    fd = mkstemp(path);
+    if(fd < 0) {
+        CHECK(!"a temporary file is made");
+        return;
+    }
+    close(fd);
+    if(drained)
+        reporter_start(0);
+    CHECK(capture_open(&cap, path, QS_PID, 10) == 0);
+    capture_start(&cap);
+    CHECK(cap.drained == drained);
+    capture_add(&cap, 1000*period, 0, 1);
+    capture_add(&cap, 1001*period, 1, 1);
+    capture_add(&cap, 1003*period, 3, 1);
+    capture_add(&cap, 1004*period, 3, 1);
+    capture_close(&cap);
+    reporter_stop();
+    CHECK(analyze(path, json) == 0);
+    CHECK(strstr(json, "\"frames\": 4,") != NULL);
+    sprintf(drift, "\"drift_us\": %lu,", (unsigned long)FRAME_PERIOD(QS_PID));
+    CHECK(strstr(json, drift) != NULL);
+    CHECK(strstr(json, "\"dropped\": 1,") != NULL);
+    CHECK(strstr(json, "\"duplicated\": 1\n") != NULL);
+    unlink(path);
+}
+
+/* Without the reporter a full ring is written by capture_add */
+static void test_wrapped(void)
+{
+    struct capture cap;
+    char path[sizeof(TMP_TEMPLATE)], json[JSON_LEN], frames[64];
+    unsigned long long period = FRAME_PERIOD(QS_PID) * 1000ULL;
+    unsigned long i, cnt = 2*CAPTURE_RING + 3;
+    if(tmp_write(path, "", 0)) {
+        CHECK(!"a temporary file is made");
+        return;
+    }
+    CHECK(capture_open(&cap, path, QS_PID, 10) == 0);
+    for(i = 0; i < cnt; i++)
+        capture_add(&cap, (1000 + i)*period, i, 1);
+    capture_close(&cap);
+    CHECK(analyze(path, json) == 0);
+    sprintf(frames, "\"frames\": %lu,", cnt);
+    CHECK(strstr(json, frames) != NULL);
+    CHECK(strstr(json, "\"dropped\": 0,") != NULL);
+    CHECK(strstr(json, "\"drift_us\": 0,") != NULL);
+    unlink(path);
+}
+
+static void test_short(void)
+{
+    char path[sizeof(TMP_TEMPLATE)], json[JSON_LEN];
+    struct {
+        struct capture_header hdr;
+        struct capture_rec rec;
+    } one;
+    memset(&one, 0, sizeof(one));
+    memcpy(one.hdr.magic, CAPTURE_MAGIC, sizeof(one.hdr.magic));
+    one.hdr.version = CAPTURE_VERSION;
+    one.hdr.period = FRAME_PERIOD(QS_PID);
+    if(tmp_write(path, &one, sizeof(one))) {
+        CHECK(!"the capture is written");
+        return;
+    }
+    CHECK(analyze(path, json) == captureerr);
+    CHECK(json[0] == '\0');
+    unlink(path);
+}
+
+int main(void)
+{
+    test_begin();
+    test_recorded();
+    test_written(0);
+    test_written(1);
+    test_wrapped();
+    test_short();
+    return test_end("capture");
+}
@@ -0,0 +1,94 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File colorpipe_bench.c
+ * The cost of the color pipeline: the same colorscheme is built over and
+ * over as it is sent without -g, with -g and with --dither, and the time
+ * a build and a frame take is printed for each. Run by make bench.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include "../modules/argparser.h"
+#include "../modules/rgbmodes.h"
+#include "testutil.h"
+
+#define QS_PID 0x171f
+#define BUILDS 20000
+#define MODE "cycle"
+
+static const char *const variants[][2] = {
+    { "old path", NULL },
+    { "-g", "-g" },
+    { "--dither", "--dither" }
+};
+
+/* Returns the nanosec a build takes, frames gets the frames of one */
+static double time_builds(const char *opt, int *frames)
+{
+    const char *args[] = { "", MODE, NULL };
+    struct colschemes cs;
+    struct progopts opts;
+    struct frame_seq seq;
+    datpack *data_arr;
+    unsigned long long start;
+    int i, pck_cnt, argc = 2;
+    if(opt) {
+        args[1] = opt;
+        args[2] = MODE;
+        argc = 3;
+    }
+    if(parse_arg(&cs, argc, args, &opts) != success)
+        return -1;
+    cs.pid = QS_PID;
+    start = bench_ns();
+    for(i = 0; i < BUILDS; i++) {
+        data_arr = parse_colorscheme(&cs, &pck_cnt);
+        if(!data_arr)
+            return -1;
+        free(data_arr);
+    }
+    start = bench_ns() - start;
+    data_arr = parse_colorscheme(&cs, &pck_cnt);
+    if(!data_arr)
+        return -1;
+    frame_seq_init(&seq, data_arr, pck_cnt, QS_PID);
+    *frames = seq.period;
+    free(data_arr);
+    return (double)start / BUILDS;
+}
+
+int main(void)
+{
+    unsigned int i;
+    double ns;
+    int frames = 0;
+    printf("colorpipe: %s, %d builds\n", MODE, BUILDS);
+    for(i = 0; i < sizeof(variants)/sizeof(*variants); i++) {
+        ns = time_builds(variants[i][1], &frames);
+        if(ns < 0) {
+            printf("colorpipe: %s can't be built\n", variants[i][0]);
+            return 1;
+        }
+        printf("  %-10s %8.1f us a build of %d frames, %6.1f ns a frame\n",
+               variants[i][0], ns/1000, frames, ns/frames);
+    }
+    return 0;
+}
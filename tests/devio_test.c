@@ -0,0 +1,207 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File devio_test.c
+ * The transfer errors of devio.c on the fake device of fakeusb.h: short
+ * transfers, a busy interface and the wrong responses of a 2S are tried
+ * again and given up on with an error code, a busy or gone microphone
+ * isn't opened, and a lost one is opened again or given up on when the
+ * program is stopped meanwhile.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include <signal.h>
+
+#include "fakeusb.h"
+#include "../modules/devio.h"
+
+#define QS2S_PID QUADCAST_2S_PID
+#define RETRIES 3 /* XFER_RETRIES of devio.c */
+#define REOPENS 30 /* REOPEN_TRIES of devio.c */
+#define FRAMES 4
+
+static const enum fake_fault qs_faults[] = {
+    fake_short, fake_busy, fake_clean
+};
+static const enum fake_fault qs2s_faults[] = {
+    fake_short, fake_busy, fake_mismatch, fake_clean
+};
+
+static libusb_device_handle *open_fake(void)
+{
+    libusb_device_handle *handle;
+    unsigned short pid;
+    if(open_mic_ctx(NULL, &handle, &pid, 0)) {
+        CHECK(!"the fake device is opened");
+        return NULL;
+    }
+    return handle;
+}
+
+/* The last packet the device got ends the frame */
+static int got_frame(unsigned short pid, const byte_t *frame)
+{
+    if(!fake.logged)
+        return 0;
+    if(pid == QS2S_PID)
+        return !memcmp(fake.log[fake.logged-1],
+                       frame + QS2S_FRAME_SIZE - DATA_PACKET_SIZE,
+                       DATA_PACKET_SIZE);
+    return !memcmp(fake.log[fake.logged-1], frame, QS_FRAME_SIZE);
+}
+
+/* The frame gets through as many faults as the retries are, one more
+ * and display_frame gives up */
+static void test_faults(unsigned short pid, const enum fake_fault *faults)
+{
+    libusb_device_handle *handle;
+    struct frame_output out;
+    byte_t frame[QS2S_FRAME_SIZE];
+    int i;
+    handle = open_fake();
+    if(!handle)
+        return;
+    frame_output_init(&out, pid);
+    out.paced = 1;
+    for(i = 0; faults[i] != fake_clean; i++) {
+        memset(frame, 2*i + 1, sizeof(frame)); /* the 2S sends changes */
+        fake.logged = 0;
+        fake.fault = faults[i];
+        fake.faults = RETRIES;
+        CHECK(display_frame(handle, &out, frame) == 0);
+        CHECK(fake.faults == 0);
+        CHECK(got_frame(pid, frame));
+        memset(frame, 2*i + 2, sizeof(frame));
+        fake.faults = RETRIES + 1;
+        CHECK(display_frame(handle, &out, frame) == transfererr);
+        CHECK(fake.faults == 0);
+    }
+    fake.fault = fake_clean;
+    close_mic(handle);
+}
+
+static void test_open(void)
+{
+    libusb_device_handle *handle;
+    unsigned short pid;
+    fake.claim_busy = 1;
+    CHECK(open_mic_ctx(NULL, &handle, &pid, 0) == devopenerr);
+    fake.claim_busy = 0;
+    fake.gone = 1;
+    CHECK(open_mic_ctx(NULL, &handle, &pid, 0) == devopenerr);
+    fake.gone = 0;
+    if(open_mic_ctx(NULL, &handle, &pid, 0) == 0) {
+        CHECK(pid == FAKE_PID);
+        close_mic(handle);
+    } else {
+        CHECK(!"the fake device is opened");
+    }
+}
+
+/* The microphone is lost at the first frame and found again, the rest of
+ * the frames go to the new handle */
+static void test_recover(const struct progopts *opts)
+{
+    libusb_device_handle *handle;
+    struct frame_output out;
+    struct frame_seq seq;
+    byte_t frames[FRAMES][QS_FRAME_SIZE];
+    unsigned long long frame = 0;
+    handle = open_fake();
+    if(!handle)
+        return;
+    memset(frames, 0, sizeof(frames));
+    frames[0][0] = 1;
+    frames[1][0] = 2;
+    frames[2][0] = 3;
+    frames[3][0] = 4;
+    frame_seq_whole(&seq, *frames, FRAMES, FAKE_PID);
+    frame_output_init(&out, FAKE_PID);
+    out.paced = 1;
+    fake.logged = 0;
+    fake.gone = 1;
+    fake.replug = 1;
+    CHECK(send_frames(&handle, &out, &seq, NULL, &frame, FRAMES, 0, -1,
+                                                               opts) == 0);
+    CHECK(handle && !fake.gone && out.reopens == 0);
+    CHECK(frame == FRAMES);
+    CHECK(fake.logged == 2*(FRAMES-1)); /* the lost one isn't sent again */
+    CHECK(got_frame(FAKE_PID, frames[FRAMES-1]));
+    fake.replug = 0;
+    close_mic(handle);
+}
+
+/* The microphone doesn't come back, the reopening goes on until the
+ * program is stopped. It's the last one, the program stays stopped */
+static void test_lost(const struct progopts *opts)
+{
+    libusb_device_handle *handle;
+    struct frame_output out;
+    struct frame_seq seq;
+    struct sigaction sa;
+    byte_t frames[FRAMES][QS_FRAME_SIZE];
+    unsigned long long frame = 0;
+    handle = open_fake();
+    if(!handle)
+        return;
+    memset(frames, 0, sizeof(frames));
+    frame_seq_whole(&seq, *frames, FRAMES, FAKE_PID);
+    frame_output_init(&out, FAKE_PID);
+    out.paced = 1;
+    fake.gone = 1;
+    sigaction(SIGINT, NULL, &sa); /* the one send_frames stops with */
+    sigaction(SIGALRM, &sa, NULL);
+    alarm(1);
+    CHECK(send_frames(&handle, &out, &seq, NULL, &frame, FRAMES, 0, -1,
+                                                      opts) == transfererr);
+    CHECK(is_stopped());
+    CHECK(!handle);
+    CHECK(out.reopens > 0 && out.reopens < REOPENS);
+    fake.gone = 0;
+}
+
+int main(void)
+{
+    char root[sizeof(TMP_TEMPLATE)];
+    struct progopts opts;
+    test_begin();
+    memset(&opts, 0, sizeof(opts));
+    opts.foreground = 1;
+    opts.governor = -1;
+    libusb_init(NULL);
+    if(fake_setup_pid(root, QS2S_PID) == 0)
+        test_faults(QS2S_PID, qs2s_faults);
+    else
+        CHECK(!"the fake 2S is made");
+    fake_teardown(root);
+    if(fake_setup(root) == 0) {
+        setenv("XDG_CACHE_HOME", root, 1); /* for the reopening */
+        test_faults(FAKE_PID, qs_faults);
+        test_open();
+        test_recover(&opts);
+        test_lost(&opts);
+    } else {
+        CHECK(!"the fake device is made");
+    }
+    libusb_exit(NULL);
+    fake_teardown(root);
+    return test_end("devio");
+}
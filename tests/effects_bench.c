@@ -0,0 +1,83 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File effects_bench.c
+ * The cost of the effects: each of them is stepped over the 108 LEDs of
+ * a 2S frame after frame, and the time a frame takes is printed next to
+ * the bound, a hundredth of the frame period of the 2S. Fails if an
+ * effect goes over it. Run by make bench.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include "../modules/argparser.h"
+#include "../modules/effects.h"
+#include "../modules/devio.h" /* for FRAME_PERIOD */
+#include "testutil.h"
+
+#define FRAMES 20000
+#define BOUND_NS (FRAME_PERIOD(QUADCAST_2S_PID)*1000.0/100)
+
+static const char *const effects[] = { "breathe", "noise", "fire", NULL };
+
+static volatile int sink; /* the colors aren't thrown away */
+
+/* Returns the nanosec a frame of the effect takes */
+static double time_frames(const char *name)
+{
+    const char *args[] = { "", name };
+    struct colschemes cs;
+    struct progopts opts;
+    struct effect fx;
+    unsigned long long start;
+    unsigned long frame;
+    int led, acc = 0;
+    if(parse_arg(&cs, 2, args, &opts) != success)
+        return -1;
+    effect_init(&fx, &cs.upper, 42, 0, FRAME_PERIOD(QUADCAST_2S_PID));
+    start = bench_ns();
+    for(frame = 0; frame < FRAMES; frame++) {
+        for(led = 0; led < QS2S_LED_CNT; led++)
+            acc ^= effect_color(&fx, frame, led);
+    }
+    start = bench_ns() - start;
+    sink = acc;
+    return (double)start / FRAMES;
+}
+
+int main(void)
+{
+    const char *const *name;
+    double ns;
+    int over = 0;
+    printf("effects: %d LEDs, %d frames, bound %.1f us a frame\n",
+           QS2S_LED_CNT, FRAMES, BOUND_NS/1000);
+    for(name = effects; *name; name++) {
+        ns = time_frames(*name);
+        if(ns < 0) {
+            printf("effects: %s can't be set\n", *name);
+            return 1;
+        }
+        printf("  %-10s %8.2f us a frame%s\n", *name, ns/1000,
+               ns > BOUND_NS ? ", over the bound" : "");
+        over |= ns > BOUND_NS;
+    }
+    return over;
+}
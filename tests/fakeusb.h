@@ -0,0 +1,399 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File fakeusb.h
+ * A fake device for the usbfs backend, put in usbfs_sys by fake_setup:
+ * its sysfs tree and device node are files in a temporary directory,
+ * its URBs complete, stall, fail or hang as fake.mode says, and the URBs
+ * of its IN endpoint wait for fake_report. The packets sent to it are kept
+ * in fake.log, the other IN endpoints answer each of them as a Quadcast 2S
+ * does. The next fake.faults transfers suffer fake.fault, and the claims
+ * fail while the interfaces are busy or the device is gone.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#ifndef FAKEUSB_SENTRY
+#define FAKEUSB_SENTRY
+
+#include <errno.h>
+#include <sys/stat.h> /* for mkdir */
+#include <sys/ioctl.h>
+#include <linux/usbdevice_fs.h>
+
+#include "../modules/usbfs.h"
+#include "testutil.h"
+
+#define FAKE_MAX_URBS 8
+#define FAKE_VID 0x03f0
+#define FAKE_PID 0x0f8b
+#define OUT_EP 0x06
+#define IN_EP 0x82
+#define SETUP_SIZE 8
+#define FAKE_PACKET_SIZE 64
+#define FAKE_LOG_MAX 4096 /* packets */
+#define FAKE_RSP_CODE 0xff /* the 2S answers, then the command it got */
+#define FAKE_RSP_CMD 14
+#define FAKE_PATH_LEN (sizeof(TMP_TEMPLATE) + 8)
+
+enum fake_mode { fake_ok, fake_hang, fake_stall, fake_nodev };
+enum fake_fault {
+    fake_clean,
+    fake_short,     /* half of the packet is sent */
+    fake_busy,      /* the submission fails */
+    fake_mismatch   /* the 2S answers with a wrong code */
+};
+
+struct urb_queue {
+    struct usbdevfs_urb *urbs[FAKE_MAX_URBS];
+    int cnt;
+};
+
+static struct fake_device {
+    int fd; /* the one of the handle, known from the claim */
+    enum fake_mode mode; /* of the OUT and control URBs */
+    int gone;
+    int replug; /* the claims of a gone one find it back */
+    int claim_busy; /* another program has the interfaces */
+    enum fake_fault fault;
+    int faults; /* transfers left to spoil */
+    int stuck; /* the discarded URBs don't end */
+    int discards;
+    struct urb_queue pending, done;
+    unsigned short pid; /* in the descriptor, set by fake_setup_pid */
+    unsigned char log[FAKE_LOG_MAX][FAKE_PACKET_SIZE]; /* the OUT data */
+    int logged;
+} fake;
+
+static inline void push(struct urb_queue *q, struct usbdevfs_urb *urb)
+{
+    if(q->cnt < FAKE_MAX_URBS)
+        q->urbs[q->cnt++] = urb;
+}
+
+static inline struct usbdevfs_urb *take(struct urb_queue *q, int i)
+{
+    struct usbdevfs_urb *urb = q->urbs[i];
+    memmove(q->urbs + i, q->urbs + i + 1, (--q->cnt - i)*sizeof(urb));
+    return urb;
+}
+
+static inline void finish(struct usbdevfs_urb *urb, int status, int len)
+{
+    urb->status = status;
+    urb->actual_length = len;
+    push(&fake.done, urb);
+}
+
+static inline int fail(int err)
+{
+    errno = err;
+    return -1;
+}
+
+/* The data a packet sent carries, the last ones are lost if too many */
+static inline void fake_log(const unsigned char *data, int len)
+{
+    if(fake.logged >= FAKE_LOG_MAX)
+        return;
+    if(len > FAKE_PACKET_SIZE)
+        len = FAKE_PACKET_SIZE;
+    memset(fake.log[fake.logged], 0, FAKE_PACKET_SIZE);
+    memcpy(fake.log[fake.logged], data, len);
+    fake.logged++;
+}
+
+/* Whether the transfer is spoiled with the fault */
+static inline int spoiled(enum fake_fault fault)
+{
+    if(fake.fault != fault || fake.faults <= 0)
+        return 0;
+    fake.faults--;
+    return 1;
+}
+
+/* The OUT data of the URB reach the device, or half of them */
+static inline void fake_sent(struct usbdevfs_urb *urb,
+                             const unsigned char *data, int len)
+{
+    if(spoiled(fake_short)) {
+        finish(urb, 0, len/2);
+        return;
+    }
+    fake_log(data, len);
+    finish(urb, 0, len);
+}
+
+/* The response to the last packet sent */
+static inline void fake_respond(struct usbdevfs_urb *urb)
+{
+    unsigned char *rsp = urb->buffer;
+    memset(rsp, 0, urb->buffer_length);
+    rsp[0] = spoiled(fake_mismatch) ? 0 : FAKE_RSP_CODE;
+    if(fake.logged && urb->buffer_length > FAKE_RSP_CMD)
+        rsp[FAKE_RSP_CMD] = fake.log[fake.logged-1][0];
+    finish(urb, 0, urb->buffer_length);
+}
+
+static inline int fake_submit(struct usbdevfs_urb *urb)
+{
+    const unsigned char *setup = urb->buffer;
+    int len;
+    if(fake.mode == fake_nodev)
+        return fail(ENODEV);
+    if(urb->type == USBDEVFS_URB_TYPE_INTERRUPT &&
+                                         urb->endpoint & LIBUSB_ENDPOINT_IN) {
+        if(urb->endpoint == IN_EP)
+            push(&fake.pending, urb); /* until fake_report */
+        else
+            fake_respond(urb);
+        return 0;
+    }
+    if(spoiled(fake_busy))
+        return fail(EBUSY);
+    if(fake.mode == fake_hang) {
+        push(&fake.pending, urb);
+        return 0;
+    }
+    if(fake.mode == fake_stall) {
+        finish(urb, -EPIPE, 0);
+        return 0;
+    }
+    if(urb->type != USBDEVFS_URB_TYPE_CONTROL) {
+        fake_sent(urb, urb->buffer, urb->buffer_length);
+        return 0;
+    }
+    len = setup[6] | setup[7] << 8;
+    if(setup[0] & LIBUSB_ENDPOINT_IN) {
+        memset((unsigned char *)urb->buffer + SETUP_SIZE, 0xa5, len);
+        finish(urb, 0, len);
+    } else {
+        fake_sent(urb, setup + SETUP_SIZE, len);
+    }
+    return 0;
+}
+
+static inline int fake_ioctl(int fd, unsigned long request, void *arg)
+{
+    int i;
+    if(request == USBDEVFS_CLAIMINTERFACE) {
+        if(fake.claim_busy)
+            return fail(EBUSY);
+        if(fake.gone && !fake.replug)
+            return fail(ENODEV);
+        fake.gone = 0;
+        fake.fd = fd;
+        return 0;
+    }
+    if(fd != fake.fd)
+        return fail(EBADF);
+    if(fake.gone)
+        return fail(ENODEV);
+    switch(request) {
+    case USBDEVFS_RELEASEINTERFACE:
+        return 0;
+    case USBDEVFS_SUBMITURB:
+        return fake_submit(arg);
+    case USBDEVFS_DISCARDURB:
+        for(i = 0; i < fake.pending.cnt; i++) {
+            if(fake.pending.urbs[i] == arg) {
+                fake.discards++;
+                if(!fake.stuck)
+                    finish(take(&fake.pending, i), -ENOENT, 0);
+                return 0;
+            }
+        }
+        return fail(EINVAL);
+    case USBDEVFS_REAPURB:
+        if(fake.done.cnt)
+            break;
+        CHECK(!"a blocking reap has an URB to take"); /* never ends */
+        return fail(EIO);
+    case USBDEVFS_REAPURBNDELAY:
+        if(fake.done.cnt)
+            break;
+        return fail(EAGAIN);
+    default:
+        return fail(ENOTTY);
+    }
+    *(struct usbdevfs_urb **)arg = take(&fake.done, 0);
+    return 0;
+}
+
+/* The device is ready with an URB done, the rest is asked without
+ * waiting */
+static inline int fake_poll(struct pollfd *pfds, nfds_t cnt, int timeout)
+{
+    nfds_t i;
+    int ready = 0;
+    for(i = 0; i < cnt; i++) {
+        pfds[i].revents = 0;
+        if(pfds[i].fd != fake.fd)
+            poll(pfds + i, 1, 0);
+        else if(fake.gone)
+            pfds[i].revents = POLLOUT | POLLERR | POLLHUP;
+        else if(fake.done.cnt)
+            pfds[i].revents = POLLOUT;
+        ready += pfds[i].revents != 0;
+    }
+    return ready;
+}
+
+/* The URB waiting on the interrupt endpoint ends with status */
+static inline void fake_complete(int status, const unsigned char *data,
+                                                           int len)
+{
+    struct usbdevfs_urb *urb;
+    int i;
+    for(i = 0; i < fake.pending.cnt; i++) {
+        urb = fake.pending.urbs[i];
+        if(urb->endpoint == IN_EP) {
+            memcpy(urb->buffer, data, len);
+            finish(take(&fake.pending, i), status, len);
+            return;
+        }
+    }
+    CHECK(!"a transfer waits on the interrupt endpoint");
+}
+
+/* The microphone sends a report on its interrupt endpoint */
+static inline void fake_report(const unsigned char *data, int len)
+{
+    fake_complete(0, data, len);
+}
+
+static inline void fake_reset(void)
+{
+    fake.mode = fake_ok;
+    fake.gone = 0;
+    fake.replug = 0;
+    fake.claim_busy = 0;
+    fake.fault = fake_clean;
+    fake.faults = 0;
+    fake.stuck = 0;
+    fake.discards = 0;
+    fake.pending.cnt = fake.done.cnt = 0;
+    fake.logged = 0;
+}
+
+static inline int write_file(const char *dir, const char *name,
+                             const void *data, size_t size)
+{
+    char path[128];
+    FILE *f;
+    int ok;
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    f = fopen(path, "w");
+    if(!f)
+        return 1;
+    ok = fwrite(data, 1, size, f) == size;
+    fclose(f);
+    return !ok;
+}
+
+/* A device at 1-4 with bus 1 and address 7, its root hub and interface
+ * are there as well */
+static inline int make_tree(const char *root)
+{
+    unsigned char desc[18] = {
+        18, 1, 0x00, 0x02, 0, 0, 0, 64,
+        FAKE_VID & 0xff, FAKE_VID >> 8, 0, 0, 0x00, 0x01, 1, 2, 3, 1
+    };
+    char dir[96];
+    desc[10] = fake.pid & 0xff;
+    desc[11] = fake.pid >> 8;
+    snprintf(dir, sizeof(dir), "%s/sys", root);
+    mkdir(dir, 0700);
+    snprintf(dir, sizeof(dir), "%s/sys/usb1", root);
+    mkdir(dir, 0700);
+    snprintf(dir, sizeof(dir), "%s/sys/1-4:1.0", root);
+    mkdir(dir, 0700);
+    snprintf(dir, sizeof(dir), "%s/dev", root);
+    mkdir(dir, 0700);
+    snprintf(dir, sizeof(dir), "%s/dev/001", root);
+    mkdir(dir, 0700);
+    if(write_file(dir, "007", "", 0))
+        return 1;
+    snprintf(dir, sizeof(dir), "%s/sys/1-4", root);
+    mkdir(dir, 0700);
+    return write_file(dir, "busnum", "1\n", 2) ||
+           write_file(dir, "devnum", "7\n", 2) ||
+           write_file(dir, "descriptors", desc, sizeof(desc));
+}
+
+static inline void fake_teardown(const char *root)
+{
+    static const char *const paths[] = {
+        "sys/1-4/busnum", "sys/1-4/devnum", "sys/1-4/descriptors",
+        "sys/1-4", "sys/1-4:1.0", "sys/usb1", "sys", "dev/001/007",
+        "dev/001", "dev", "quadcastrgb/device", "quadcastrgb", NULL
+    };
+    const char *const *p;
+    char path[128];
+    for(p = paths; *p; p++) {
+        snprintf(path, sizeof(path), "%s/%s", root, *p);
+        remove(path);
+    }
+    remove(root);
+}
+
+
+/* The device of the model pid found in the directory root (at least
+ * sizeof(TMP_TEMPLATE) bytes), removed by fake_teardown. Returns 0 or 1 */
+static inline int fake_setup_pid(char *root, unsigned short pid)
+{
+    static char sys[FAKE_PATH_LEN], dev[FAKE_PATH_LEN];
+    strcpy(root, TMP_TEMPLATE);
+    if(!mkdtemp(root))
+        return 1;
+    snprintf(sys, sizeof(sys), "%s/sys", root);
+    snprintf(dev, sizeof(dev), "%s/dev", root);
+    usbfs_sys.sysfs_dir = sys;
+    usbfs_sys.dev_dir = dev;
+    usbfs_sys.ioctl = fake_ioctl;
+    usbfs_sys.poll = fake_poll;
+    fake.fd = -1;
+    fake.pid = pid;
+    fake_reset();
+    return make_tree(root);
+}
+
+static inline int fake_setup(char *root)
+{
+    return fake_setup_pid(root, FAKE_PID);
+}
+
+/* The first device there, claimed; NULL - it can't be opened */
+static inline libusb_device_handle *fake_open(void)
+{
+    libusb_device **list;
+    libusb_device_handle *handle = NULL;
+    if(libusb_get_device_list(NULL, &list) < 1)
+        return NULL;
+    if(libusb_open(list[0], &handle) == 0 &&
+                                     libusb_claim_interface(handle, 0)) {
+        libusb_close(handle);
+        handle = NULL;
+    }
+    libusb_free_device_list(list, 1);
+    return handle;
+}
+
+#endif
@@ -0,0 +1,181 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File mutewatch_test.c
+ * Following the mute button on the fake device of fakeusb.h: the reports
+ * are read, the frames switch between the live and the muted colors,
+ * failing transfers stop the watch, and a transfer that won't end when
+ * it's cancelled no longer touches the watch it was left by.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include "fakeusb.h"
+#include "../modules/devio.h"
+#include "../modules/scene.h"
+#include "../modules/mutewatch.h"
+
+#define QS_PID 0x171f
+
+static const char muted_text[] = "step 500 cycle\n"; /* several frames */
+static const byte_t live[QS_FRAME_SIZE];
+
+static void report(int muted)
+{
+    const unsigned char data[2] = { MUTE_REPORT_CODE, muted };
+    fake_report(data, sizeof(data));
+}
+
+static void test_report_state(void)
+{
+    const byte_t muted[] = { MUTE_REPORT_CODE, 0x01, 0, 0, 0, 0, 0, 0 };
+    const byte_t unmuted[] = { MUTE_REPORT_CODE, 0x00 };
+    const byte_t other[] = { 0x02, 0x01 };
+    CHECK(mute_report_state(muted, sizeof(muted)) == 1);
+    CHECK(mute_report_state(unmuted, sizeof(unmuted)) == 0);
+    CHECK(mute_report_state(other, sizeof(other)) == -1);
+    CHECK(mute_report_state(muted, 1) == -1); /* cut short */
+    CHECK(mute_report_state(muted, 0) == -1);
+}
+
+static void test_unwatched(const char *path)
+{
+    struct mute_watch mw;
+    CHECK(mute_watch_open(&mw, NULL, QS_PID) == 0);
+    CHECK(mute_watch_frame(&mw, NULL, live) == live);
+    CHECK(!mute_watch_muted(&mw));
+    mute_watch_close(&mw);
+    CHECK(mute_watch_open(&mw, path, QUADCAST_2S_PID) == 0);
+    CHECK(mute_watch_frame(&mw, NULL, live) == live);
+    mute_watch_close(&mw);
+    CHECK(mute_watch_open(&mw, "/nonexistent/muted.txt", QS_PID) ==
+                                                               muteerr);
+}
+
+static void test_switch(libusb_device_handle *handle, const char *path)
+{
+    struct mute_watch mw;
+    if(mute_watch_open(&mw, path, QS_PID)) {
+        CHECK(!"the muted colorscheme loads");
+        return;
+    }
+    CHECK(mute_watch_frame(&mw, handle, live) == live);
+    CHECK(mw.pending && fake.pending.cnt == 1);
+    report(1);
+    CHECK(mute_watch_frame(&mw, handle, live) ==
+                                   scene_frame(mw.sc, mw.step, 0));
+    CHECK(mute_watch_muted(&mw));
+    CHECK(mute_watch_frame(&mw, handle, live) ==
+                                   scene_frame(mw.sc, mw.step, 1));
+    report(0);
+    CHECK(mute_watch_frame(&mw, handle, live) == live);
+    CHECK(!mute_watch_muted(&mw));
+    report(1); /* a new press starts from the first frame */
+    CHECK(mute_watch_frame(&mw, handle, live) ==
+                                   scene_frame(mw.sc, mw.step, 0));
+    fake_report((const unsigned char *)"\x02\x00", 2); /* not the state */
+    CHECK(mute_watch_frame(&mw, handle, live) ==
+                                   scene_frame(mw.sc, mw.step, 1));
+    CHECK(mw.pending);
+    mute_watch_close(&mw);
+    CHECK(fake.pending.cnt == 0 && fake.done.cnt == 0);
+    fake_reset();
+}
+
+/* A stalled endpoint would fail again at once, forever */
+static void test_stall(libusb_device_handle *handle, const char *path)
+{
+    struct mute_watch mw;
+    int i;
+    if(mute_watch_open(&mw, path, QS_PID)) {
+        CHECK(!"the muted colorscheme loads");
+        return;
+    }
+    mute_watch_frame(&mw, handle, live);
+    report(1);
+    CHECK(mute_watch_frame(&mw, handle, live) != live);
+    for(i = 1; i < MUTE_MAX_FAILS; i++) {
+        fake_complete(-EPIPE, NULL, 0);
+        mute_watch_frame(&mw, handle, live);
+        CHECK(mw.pending);
+    }
+    fake_complete(-EPIPE, NULL, 0);
+    CHECK(mute_watch_frame(&mw, handle, live) == live);
+    CHECK(!mw.pending && fake.pending.cnt == 0);
+    CHECK(mute_watch_start(&mw, handle) == 0 && mw.pending);
+    for(i = 2; i < 2*MUTE_MAX_FAILS; i++) {
+        if(i == MUTE_MAX_FAILS)
+            report(1); /* a success starts the count over */
+        else
+            fake_complete(-EPIPE, NULL, 0);
+        mute_watch_frame(&mw, handle, live);
+        CHECK(mw.pending);
+    }
+    mute_watch_close(&mw);
+    fake_reset();
+}
+
+static void test_left(libusb_device_handle *handle, const char *path)
+{
+    struct mute_watch mw, copy;
+    struct timeval tv = { 0, 0 };
+    if(mute_watch_open(&mw, path, QS_PID)) {
+        CHECK(!"the muted colorscheme loads");
+        return;
+    }
+    mute_watch_frame(&mw, handle, live);
+    fake.stuck = 1;
+    mute_watch_close(&mw);
+    CHECK(fake.discards == 1 && fake.pending.cnt == 1);
+    CHECK(!mw.xfer && !mw.pending);
+    memset(&mw, 0x5a, sizeof(mw)); /* as if it had gone out of scope */
+    copy = mw;
+    fake_complete(-ENOENT, NULL, 0); /* the cancel ends at last */
+    libusb_handle_events_timeout_completed(NULL, &tv, NULL);
+    CHECK(!memcmp(&mw, &copy, sizeof(mw)));
+    CHECK(fake.done.cnt == 0);
+    fake_reset();
+}
+
+int main(void)
+{
+    libusb_device_handle *handle;
+    char root[sizeof(TMP_TEMPLATE)], path[sizeof(TMP_TEMPLATE)];
+    test_begin();
+    test_report_state();
+    libusb_init(NULL);
+    if(tmp_write(path, muted_text, strlen(muted_text))) {
+        CHECK(!"the muted colorscheme is written");
+        return test_end("mutewatch");
+    }
+    test_unwatched(path);
+    if(fake_setup(root) == 0 && (handle = fake_open())) {
+        test_switch(handle, path);
+        test_stall(handle, path);
+        test_left(handle, path);
+        libusb_close(handle);
+    } else {
+        CHECK(!"the fake device is opened");
+    }
+    libusb_exit(NULL);
+    fake_teardown(root);
+    unlink(path);
+    return test_end("mutewatch");
+}
@@ -0,0 +1,123 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File reporter_test.c
+ * The reports of the send loop reach the service manager (a datagram
+ * socket of NOTIFY_SOCKET here) formatted, in order and all of them once
+ * the reporter stops, whether they were posted to its thread or came
+ * before it was started.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "testutil.h"
+#include "../modules/reporter.h"
+
+#define MSG_LEN (STATUS_REPORT_LEN + sizeof("STATUS="))
+
+static int notify_socket(char *dir, char *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+    strcpy(dir, TMP_TEMPLATE);
+    if(!mkdtemp(dir))
+        return -1;
+    sprintf(path, "%s/notify", dir);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if(fd < 0)
+        return -1;
+    if(bind(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+        close(fd);
+        return -1;
+    }
+    setenv("NOTIFY_SOCKET", path, 1);
+    return fd;
+}
+
+static void post(const char *fmt, unsigned long a, unsigned long b)
+{
+    struct report r;
+    report_init(&r, fmt);
+    r.num[0] = a;
+    r.num[1] = b;
+    reporter_post(&r);
+}
+
+/* The next message, "" if there is none */
+static const char *received(int fd, char *buf)
+{
+    ssize_t len = recv(fd, buf, MSG_LEN-1, MSG_DONTWAIT);
+    buf[len > 0 ? len : 0] = '\0';
+    return buf;
+}
+
+static void test_direct(int fd)
+{
+    char buf[MSG_LEN];
+    post("before %lu.%lu", 1, 5);
+    CHECK(!strcmp(received(fd, buf), "STATUS=before 1.5"));
+    CHECK(!strcmp(received(fd, buf), ""));
+}
+
+static void test_thread(int fd)
+{
+    char buf[MSG_LEN], want[MSG_LEN];
+    struct report r;
+    int i;
+    reporter_start(0);
+    for(i = 0; i < REPORT_RING/2; i++)
+        post("report %lu of %lu", i, REPORT_RING/2);
+    report_init(&r, "%s: %lu\n"); /* a warning isn't sent */
+    r.str = "retry";
+    r.warn = 1;
+    reporter_post(&r);
+    reporter_stop();
+    for(i = 0; i < REPORT_RING/2; i++) {
+        sprintf(want, "STATUS=report %d of %d", i, REPORT_RING/2);
+        CHECK(!strcmp(received(fd, buf), want));
+    }
+    CHECK(!strcmp(received(fd, buf), ""));
+    post("after %lu%lu", 4, 2); /* written at once again */
+    CHECK(!strcmp(received(fd, buf), "STATUS=after 42"));
+}
+
+int main(void)
+{
+    char dir[sizeof(TMP_TEMPLATE)], path[sizeof(TMP_TEMPLATE) + 8];
+    int fd;
+    test_begin();
+    fd = notify_socket(dir, path);
+    if(fd < 0) {
+        CHECK(!"the notify socket is bound");
+        return test_end("reporter");
+    }
+    test_direct(fd);
+    test_thread(fd);
+    close(fd);
+    unlink(path);
+    rmdir(dir);
+    return test_end("reporter");
+}
@@ -0,0 +1,342 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File scene_test.c
+ * The scene compiler and the validation of compiled images: a compiled
+ * scene survives saving and loading, the images that are cut short or
+ * spoiled are refused, and so are the bad instructions of a text. A scene
+ * played on the fake device shows its steps for as long as they say and
+ * fades from one into the other.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include <stddef.h> /* for offsetof */
+
+#include "fakeusb.h"
+#include "../modules/devio.h"
+#include "../modules/scene.h"
+
+#define QS_PID 0x171f
+#define QS2S_PID QUADCAST_2S_PID
+#define MAX_SHOWN 512 /* frames */
+
+static const char good_text[] =
+    "# a comment\n"
+    "loop 2\n"
+    "step 300 solid ff0000\n"
+    "fade 100\n"
+    "step 500 -s 90 cycle\n"
+    "\n"
+    "step 0 -u blink ff0000 -l wave\n";
+
+static const char *const bad_texts[] = {
+    "step\n",                               /* no duration */
+    "step abc solid\n",                     /* duration isn't a number */
+    "step 100 nosuchmode\n",
+    "step 100 -b 200 solid\n",              /* the usual arguments */
+    "step 100 --scene x.txt\n",             /* scenes can't be nested */
+    "fade 100\nfade 100\nstep 100 solid\n", /* a fade into a fade */
+    "fade 100\n",                           /* nothing to play */
+    "loop\nstep 100 solid\n",
+    "loop 2 3\nstep 100 solid\n",
+    "jump 100\n",
+    "step 0 solid\nstep 100 cycle\n",       /* never gets to the second */
+    "step 0 solid\nfade 100\n",
+    "",                                     /* no step at all */
+    NULL
+};
+
+static const char played_text[] =
+    "loop 1\n"
+    "step 300 solid ff0000\n"
+    "fade 300\n"
+    "step 300 solid 0000ff\n";
+
+static byte_t shown[MAX_SHOWN][QS2S_FRAME_SIZE];
+
+static int load_text(struct scene *sc, const char *text, unsigned short pid)
+{
+    char path[sizeof(TMP_TEMPLATE)];
+    int errcode;
+    if(tmp_write(path, text, strlen(text)))
+        return -1;
+    errcode = scene_load(sc, path, pid);
+    unlink(path);
+    return errcode;
+}
+
+static int load_image(struct scene *sc, const void *image, size_t size,
+                                                      unsigned short pid)
+{
+    char path[sizeof(TMP_TEMPLATE)];
+    int errcode;
+    if(tmp_write(path, image, size))
+        return -1;
+    errcode = scene_load(sc, path, pid);
+    unlink(path);
+    return errcode;
+}
+
+static void test_round_trip(unsigned short pid)
+{
+    struct scene sc, loaded;
+    char path[sizeof(TMP_TEMPLATE)];
+    const char *text = pid == QS2S_PID ?
+        "loop 3\nstep 200 solid 00ff00\nfade 100\nstep 50 -r 0:9 ff\n"
+        "step 0 breathe\n" : good_text;
+    CHECK(load_text(&sc, text, pid) == 0);
+    if(test_failures)
+        return;
+    CHECK(sc.hdr->pid == pid);
+    CHECK(sc.hdr->step_cnt == 4);
+    CHECK(sc.hdr->loop == (pid == QS2S_PID ? 3 : 2));
+    CHECK(sc.steps[1].type == step_fade && sc.steps[1].duration == 100);
+    CHECK(sc.steps[3].type == step_play && sc.steps[3].duration == 0);
+    CHECK(sc.hdr->frame_size == FRAME_SIZE(pid));
+    CHECK(tmp_write(path, "", 0) == 0);
+    CHECK(scene_save(&sc, path) == 0);
+    CHECK(scene_load(&loaded, path, pid) == 0);
+    if(!test_failures) {
+        CHECK(loaded.mapped);
+        CHECK(loaded.image_size == sc.image_size);
+        CHECK(!memcmp(loaded.image, sc.image, sc.image_size));
+        CHECK(scene_frame(&loaded, loaded.steps + 3, 7) - loaded.frames ==
+              scene_frame(&sc, sc.steps + 3, 7) - sc.frames);
+        scene_free(&loaded);
+        /* the model is a part of the image */
+        CHECK(scene_load(&loaded, path,
+                         pid == QS2S_PID ? QS_PID : QS2S_PID) != 0);
+    }
+    unlink(path);
+    scene_free(&sc);
+}
+
+/* Every image that is shorter than the whole is refused */
+static void test_truncated(const struct scene *sc)
+{
+    struct scene loaded;
+    size_t size;
+    int refused = 1;
+    for(size = 0; size < sc->image_size; size += size < 256 ? 1 : 61) {
+        if(load_image(&loaded, sc->image, size, QS_PID) == 0) {
+            printf("a cut image of %lu bytes was loaded\n",
+                                                   (unsigned long)size);
+            scene_free(&loaded);
+            refused = 0;
+        }
+    }
+    CHECK(refused);
+}
+
+static int load_spoiled_as(const struct scene *sc, size_t offset,
+                           const void *bytes, size_t cnt, unsigned short pid)
+{
+    struct scene loaded;
+    unsigned char *image;
+    int errcode;
+    image = malloc(sc->image_size);
+    if(!image)
+        return -1;
+    memcpy(image, sc->image, sc->image_size);
+    memcpy(image + offset, bytes, cnt);
+    errcode = load_image(&loaded, image, sc->image_size, pid);
+    if(!errcode)
+        scene_free(&loaded);
+    free(image);
+    return errcode;
+}
+
+static int load_spoiled(const struct scene *sc, size_t offset,
+                        const void *bytes, size_t cnt)
+{
+    return load_spoiled_as(sc, offset, bytes, cnt, QS_PID);
+}
+
+static void test_corrupt(const struct scene *sc)
+{
+    const size_t steps = sizeof(struct scene_header);
+    const size_t step_size = sizeof(struct scene_step);
+    uint16_t u16;
+    uint32_t u32;
+    CHECK(load_spoiled(sc, 0, "QSCX", 4) != 0);
+    u16 = SCENE_VERSION + 1;
+    CHECK(load_spoiled(sc, offsetof(struct scene_header, version),
+                                                      &u16, sizeof(u16)));
+    u32 = 0;
+    CHECK(load_spoiled(sc, offsetof(struct scene_header, step_cnt),
+                                                      &u32, sizeof(u32)));
+    u32 = SCENE_MAX_STEPS + 1;
+    CHECK(load_spoiled(sc, offsetof(struct scene_header, step_cnt),
+                                                      &u32, sizeof(u32)));
+    u32 = 9;
+    CHECK(load_spoiled(sc, offsetof(struct scene_header, frame_size),
+                                                      &u32, sizeof(u32)));
+    u32 = QS2S_FRAME_SIZE; /* the frames of Quadcast S are smaller */
+    CHECK(load_spoiled(sc, offsetof(struct scene_header, frame_size),
+                                                      &u32, sizeof(u32)));
+    u16 = QS2S_PID; /* 2S frames would be read past the end */
+    CHECK(load_spoiled_as(sc, offsetof(struct scene_header, pid),
+                                            &u16, sizeof(u16), QS2S_PID));
+    u32 = sc->hdr->frame_cnt + 1;
+    CHECK(load_spoiled(sc, offsetof(struct scene_header, frame_cnt),
+                                                      &u32, sizeof(u32)));
+    u32 = 7; /* no such step type */
+    CHECK(load_spoiled(sc, steps + offsetof(struct scene_step, type),
+                                                      &u32, sizeof(u32)));
+    u32 = sc->hdr->frame_cnt; /* the frames of step 0 are past the end */
+    CHECK(load_spoiled(sc, steps + offsetof(struct scene_step, first_frame),
+                                                      &u32, sizeof(u32)));
+    u32 = 0;
+    CHECK(load_spoiled(sc, steps + offsetof(struct scene_step, frame_cnt),
+                                                      &u32, sizeof(u32)));
+    u32 = step_fade; /* step 2 would fade into a fade */
+    CHECK(load_spoiled(sc, steps + 2*step_size +
+                  offsetof(struct scene_step, type), &u32, sizeof(u32)));
+    u32 = 0; /* an endless step before the last one */
+    CHECK(load_spoiled(sc, steps + offsetof(struct scene_step, duration),
+                                                      &u32, sizeof(u32)));
+    /* the unchanged image is fine */
+    CHECK(load_spoiled(sc, 0, SCENE_MAGIC, 4) == 0);
+}
+
+/* Puts together the frames that reached the device from the packets it
+ * got: a Quadcast S gets the color command after each header, a 2S the
+ * changed packets with their numbers after a header that counts them.
+ * Returns the number of frames */
+static int device_frames(unsigned short pid)
+{
+    byte_t frame[QS2S_FRAME_SIZE];
+    const unsigned char *pck;
+    int i, cnt = 0, left = 0;
+    memset(frame, 0, sizeof(frame));
+    for(i = 0; i < fake.logged && cnt < MAX_SHOWN; i++) {
+        pck = fake.log[i];
+        if(pid != QS2S_PID) {
+            if(pck[0] == RGB_CODE)
+                memcpy(shown[cnt++], pck, QS_FRAME_SIZE);
+        } else if(pck[1] == QS2S_PACKET_CNT_CODE) {
+            left = pck[2];
+        } else if(left && pck[2] < QS2S_SOLID_PKT_CNT) {
+            memcpy(frame + pck[2]*DATA_PACKET_SIZE, pck, DATA_PACKET_SIZE);
+            if(!--left)
+                memcpy(shown[cnt++], frame, QS2S_FRAME_SIZE);
+        }
+    }
+    return cnt;
+}
+
+/* Each byte of the frame is the one of prev or moves on towards the one
+ * of to */
+static int moves_towards(const byte_t *prev, const byte_t *frame,
+                         const byte_t *to, size_t size)
+{
+    size_t i;
+    for(i = 0; i < size; i++) {
+        if(prev[i] < to[i] ? frame[i] < prev[i] || frame[i] > to[i] :
+                             frame[i] > prev[i] || frame[i] < to[i])
+            return 0;
+    }
+    return 1;
+}
+
+/* The red step is held for its 300 ms, a Quadcast S is sent its frame
+ * every 55 ms and a 2S only once; then the fade goes to blue */
+static void test_played(unsigned short pid)
+{
+    struct scene sc;
+    struct progopts opts;
+    libusb_device_handle *handle;
+    char root[sizeof(TMP_TEMPLATE)];
+    const byte_t *red, *blue;
+    size_t size = FRAME_SIZE(pid);
+    int i, cnt, reds, fades;
+    CHECK(load_text(&sc, played_text, pid) == 0);
+    if(test_failures)
+        return;
+    if(fake_setup_pid(root, pid) || !(handle = fake_open())) {
+        CHECK(!"the fake device is opened");
+        fake_teardown(root);
+        scene_free(&sc);
+        return;
+    }
+    memset(&opts, 0, sizeof(opts));
+    opts.foreground = 1;
+    opts.governor = -1;
+    CHECK(send_scene(&handle, &sc, &opts, NULL) == 0);
+    red = scene_frame(&sc, sc.steps, 0);
+    blue = scene_frame(&sc, sc.steps + 2, 0);
+    cnt = device_frames(pid);
+    for(reds = 0; reds < cnt && !memcmp(shown[reds], red, size); reds++)
+        ;
+    for(fades = 0; reds + fades < cnt &&
+                   memcmp(shown[reds + fades], blue, size); fades++) {
+        if(!moves_towards(fades ? shown[reds + fades - 1] : red,
+                          shown[reds + fades], blue, size))
+            break;
+    }
+    if(pid == QS2S_PID) {
+        CHECK(reds == 1);
+        CHECK(cnt == reds + fades + 1); /* blue is sent once as well */
+    } else {
+        CHECK(reds >= 2 && reds <= 7); /* 300 ms, the fade begins red */
+        CHECK(cnt > reds + fades && cnt - reds - fades <= 6);
+    }
+    CHECK(fades >= 2);
+    for(i = reds + fades; i < cnt; i++)
+        CHECK(!memcmp(shown[i], blue, size));
+    libusb_close(handle);
+    fake_teardown(root);
+    scene_free(&sc);
+}
+
+static void test_bad_texts(void)
+{
+    struct scene sc;
+    int i;
+    for(i = 0; bad_texts[i]; i++) {
+        if(load_text(&sc, bad_texts[i], QS_PID) == 0) {
+            printf("a bad scene was compiled: %s", bad_texts[i]);
+            scene_free(&sc);
+            test_failures++;
+        }
+    }
+}
+
+int main(void)
+{
+    struct scene sc;
+    test_begin();
+    test_round_trip(QS_PID);
+    test_round_trip(QS2S_PID);
+    if(load_text(&sc, good_text, QS_PID) == 0) {
+        test_truncated(&sc);
+        test_corrupt(&sc);
+        scene_free(&sc);
+    } else {
+        CHECK(!"the good scene compiles");
+    }
+    test_bad_texts();
+    libusb_init(NULL);
+    test_played(QS_PID);
+    test_played(QS2S_PID);
+    libusb_exit(NULL);
+    return test_end("scene");
+}
@@ -0,0 +1,125 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File seed_test.c
+ * The random colors depend on --seed alone: the generator gives the
+ * PCG32 reference numbers, and the frames of random blink saved with a
+ * seed (what --save writes) are the ones checked in, byte for byte.
+ *
+ * The saved frames are in the byte order of the machine that wrote them,
+ * a little-endian one, so they're only compared on such machines.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include <stdint.h>
+
+#include "../modules/argparser.h"
+#include "../modules/rgbmodes.h"
+#include "../modules/scene.h"
+#include "../modules/prng.h"
+#include "testutil.h"
+
+#define SAVED "tests/data/blink-seed42.scene"
+#define QS_PID 0x171f
+#define SAVED_MAX 65536
+
+/* pcg32_srandom(42, 54) of the reference implementation */
+static const uint32_t pcg32_ref[] = {
+    0xa15c02b7, 0x7b47f409, 0xba1d3330, 0x83d2f293, 0xbfa4784b, 0xcbed606e
+};
+
+static void test_reference(void)
+{
+    struct prng rng;
+    unsigned int i;
+    prng_seed(&rng, 42, 54);
+    for(i = 0; i < sizeof(pcg32_ref)/sizeof(*pcg32_ref); i++)
+        CHECK(prng_next(&rng) == pcg32_ref[i]);
+}
+
+/* Saves the frames of the colorscheme of args the way --save does,
+ * returns the size of the file read back to buf or 0 */
+static size_t save(const char *seed, char *buf)
+{
+    const char *args[] = { "", "--seed", seed, "blink" };
+    char path[sizeof(TMP_TEMPLATE)];
+    struct colschemes cs;
+    struct progopts opts;
+    struct frame_seq seq;
+    struct scene sc;
+    datpack *data_arr;
+    FILE *f;
+    size_t len = 0;
+    int pck_cnt, fd;
+    if(parse_arg(&cs, sizeof(args)/sizeof(*args), args, &opts) != success)
+        return 0;
+    cs.pid = QS_PID;
+    data_arr = parse_colorscheme(&cs, &pck_cnt);
+    if(!data_arr)
+        return 0;
+    frame_seq_init(&seq, data_arr, pck_cnt, QS_PID);
+    strcpy(path, TMP_TEMPLATE);
+    fd = mkstemp(path);
+    if(fd >= 0 && !scene_from_frames(&sc, &seq, QS_PID)) {
+        if(!scene_save(&sc, path) && (f = fopen(path, "rb"))) {
+            len = fread(buf, 1, SAVED_MAX, f);
+            fclose(f);
+        }
+        scene_free(&sc);
+    }
+    if(fd >= 0) {
+        close(fd);
+        unlink(path);
+    }
+    free(data_arr);
+    return len;
+}
+
+static void test_saved(void)
+{
+    static char got[SAVED_MAX], want[SAVED_MAX], other[SAVED_MAX];
+    const uint16_t one = 1;
+    size_t len, want_len = 0;
+    FILE *f;
+    len = save("42", got);
+    CHECK(len > 0);
+    CHECK(save("42", other) == len && !memcmp(got, other, len));
+    CHECK(save("43", other) != len || memcmp(got, other, len));
+    if(*(const unsigned char *)&one != 1) {
+        puts("seed: big-endian, the saved frames aren't compared");
+        return;
+    }
+    f = fopen(SAVED, "rb");
+    if(f) {
+        want_len = fread(want, 1, SAVED_MAX, f);
+        fclose(f);
+    }
+    CHECK(want_len > 0);
+    CHECK(len == want_len && !memcmp(got, want, len));
+}
+
+int main(void)
+{
+    test_begin();
+    test_reference();
+    test_saved();
+    return test_end("seed");
+}
@@ -0,0 +1,161 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File service_test.c
+ * The commands of the control socket are taken without waiting for the
+ * clients: a client that has connected but sent nothing doesn't hold
+ * ctl_accept up, a line sent in pieces is put together across the
+ * calls, the data of a stream after its line stays unread, and the
+ * oldest pending client is dropped when there are too many of them.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include <time.h> /* for clock_gettime */
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "testutil.h"
+#include "../modules/service.h"
+
+#define MAX_ACCEPT_MS 50 /* far less than the frame period of Quadcast S */
+
+static int client(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+        close(fd);
+        fd = -1;
+    }
+    CHECK(fd >= 0);
+    return fd;
+}
+
+static void say(int fd, const char *text)
+{
+    CHECK(write(fd, text, strlen(text)) == (ssize_t)strlen(text));
+}
+
+static long long now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec*1000 + ts.tv_nsec/1000000;
+}
+
+/* What the frame loop does before a frame, it must not wait */
+static int accept_now(struct ctl *ctl, int *conn)
+{
+    long long start = now_ms();
+    int cmd;
+    cmd = ctl_accept(ctl, 0, conn);
+    CHECK(now_ms() - start < MAX_ACCEPT_MS);
+    return cmd;
+}
+
+static void test_idle_and_split(struct ctl *ctl, const char *path)
+{
+    struct pollfd pfds[CTL_MAX_POLLFDS];
+    int idle, fd, conn;
+    idle = client(path);
+    CHECK(accept_now(ctl, &conn) == cmd_none);
+    CHECK(accept_now(ctl, &conn) == cmd_none);
+    CHECK(ctl->pending_cnt == 1);
+    fd = client(path);
+    say(fd, "di");
+    CHECK(accept_now(ctl, &conn) == cmd_none);
+    CHECK(ctl->pending_cnt == 2);
+    say(fd, "m 40 ");
+    CHECK(accept_now(ctl, &conn) == cmd_none);
+    say(fd, "100\n");
+    CHECK(accept_now(ctl, &conn) == cmd_dim);
+    CHECK(ctl->dim == 40 && ctl->dim_ramp == 100 && ctl->dim_cnt == 1);
+    CHECK(ctl->pending_cnt == 1 && ctl->pending[0].fd >= 0);
+    CHECK(ctl_pollfds(ctl, pfds, CTL_MAX_POLLFDS) == 2);
+    CHECK(pfds[0].fd == ctl->fd && pfds[1].fd == ctl->pending[0].fd);
+    close(fd);
+    say(idle, "poke"); /* the end of the connection ends the line */
+    close(idle);
+    CHECK(accept_now(ctl, &conn) == cmd_none); /* "poke" is read */
+    CHECK(accept_now(ctl, &conn) == cmd_poke); /* then the end */
+    CHECK(ctl->pending_cnt == 0);
+}
+
+static void test_stream(struct ctl *ctl, const char *path)
+{
+    char data[8];
+    int fd, conn = -1;
+    fd = client(path);
+    say(fd, "stream\nFRAME");
+    CHECK(accept_now(ctl, &conn) == cmd_stream);
+    CHECK(conn >= 0 && ctl->pending_cnt == 0);
+    if(conn >= 0) {
+        CHECK(read(conn, data, sizeof(data)) == 5 &&
+                                            !memcmp(data, "FRAME", 5));
+        close(conn);
+    }
+    close(fd);
+}
+
+static void test_too_many(struct ctl *ctl, const char *path)
+{
+    int fds[CTL_MAX_PENDING + 1], i, conn;
+    char byte;
+    for(i = 0; i < CTL_MAX_PENDING + 1; i++) {
+        fds[i] = client(path);
+        accept_now(ctl, &conn);
+    }
+    CHECK(ctl->pending_cnt == CTL_MAX_PENDING);
+    CHECK(read(fds[0], &byte, 1) == 0); /* the oldest one was dropped */
+    say(fds[CTL_MAX_PENDING], "poke\n");
+    CHECK(accept_now(ctl, &conn) == cmd_poke);
+    for(i = 0; i < CTL_MAX_PENDING + 1; i++)
+        close(fds[i]);
+    ctl_close(ctl);
+    CHECK(ctl->pending_cnt == 0 && ctl->fd == -1);
+}
+
+int main(void)
+{
+    struct ctl ctl;
+    char dir[sizeof(TMP_TEMPLATE)], path[sizeof(TMP_TEMPLATE) + 8];
+    test_begin();
+    strcpy(dir, TMP_TEMPLATE);
+    if(!mkdtemp(dir)) {
+        CHECK(!"a temporary directory is made");
+        return test_end("service");
+    }
+    sprintf(path, "%s/ctl", dir);
+    unsetenv("LISTEN_PID");
+    if(ctl_listen(&ctl, path) == 0 && ctl.fd >= 0) {
+        test_idle_and_split(&ctl, path);
+        test_stream(&ctl, path);
+        test_too_many(&ctl, path);
+    } else {
+        CHECK(!"the control socket listens");
+    }
+    remove(dir);
+    return test_end("service");
+}
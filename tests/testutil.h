@@ -0,0 +1,87 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File testutil.h
+ * A few helpers shared by the tests. Each test is a program of its own
+ * that needs no microphone: it prints the checks that failed and exits
+ * with 1 if there were any. The messages the modules print to stderr on
+ * purpose are dropped, see test_begin.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#ifndef TESTUTIL_SENTRY
+#define TESTUTIL_SENTRY
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CHECK(COND) check_that((COND), #COND, __FILE__, __LINE__)
+#define TMP_TEMPLATE "/tmp/quadcastrgb-test-XXXXXX"
+
+static int test_failures = 0;
+
+static inline void check_that(int ok, const char *what, const char *file,
+                                                            int line)
+{
+    if(ok)
+        return;
+    printf("%s:%d: failed: %s\n", file, line, what);
+    test_failures++;
+}
+
+static inline void test_begin(void)
+{
+    if(!getenv("TEST_VERBOSE")) /* the error paths are tested as well */
+        freopen("/dev/null", "w", stderr);
+}
+
+static inline int test_end(const char *name)
+{
+    printf("%s: %s\n", name, test_failures ? "FAIL" : "ok");
+    return test_failures != 0;
+}
+
+/* Writes size bytes of data to a new temporary file, path gets its name
+ * (at least sizeof(TMP_TEMPLATE) bytes). Returns 0 or 1 */
+static inline int tmp_write(char *path, const void *data, size_t size)
+{
+    int fd, ok;
+    strcpy(path, TMP_TEMPLATE);
+    fd = mkstemp(path);
+    if(fd < 0)
+        return 1;
+    ok = write(fd, data, size) == (ssize_t)size;
+    close(fd);
+    return !ok;
+}
+
+/* The clock of the benchmarks, nanosec */
+static inline unsigned long long bench_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+#endif
@@ -0,0 +1,196 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File usbfs_test.c
+ * The usbfs backend against the fake device of fakeusb.h: the device
+ * is found in a sysfs tree of files, the URBs of the synchronous
+ * transfers complete, stall, fail or never finish and get discarded, and
+ * an asynchronous transfer gets its callback whether the events or a
+ * synchronous transfer reap it, or it's cancelled or the device is gone.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA.
+ */
+#include "fakeusb.h"
+
+#define TIMEOUT 1000
+
+static struct callback_log {
+    int calls;
+    enum libusb_transfer_status status;
+    int actual_length;
+} cb_log;
+
+static void LIBUSB_CALL log_callback(struct libusb_transfer *xfer)
+{
+    cb_log.calls++;
+    cb_log.status = xfer->status;
+    cb_log.actual_length = xfer->actual_length;
+}
+
+static void handle_events(void)
+{
+    struct timeval tv = { 0, 0 };
+    CHECK(libusb_handle_events_timeout_completed(NULL, &tv, NULL) == 0);
+}
+
+static libusb_device_handle *test_open(void)
+{
+    struct libusb_device_descriptor desc;
+    libusb_device **list;
+    libusb_device_handle *handle = NULL;
+    uint8_t ports[USBFS_MAX_PORTS];
+    ssize_t cnt;
+    cnt = libusb_get_device_list(NULL, &list);
+    CHECK(cnt == 1);
+    if(cnt != 1) {
+        if(cnt >= 0)
+            libusb_free_device_list(list, 1);
+        return NULL;
+    }
+    libusb_get_device_descriptor(list[0], &desc);
+    CHECK(desc.idVendor == FAKE_VID && desc.idProduct == FAKE_PID);
+    CHECK(libusb_get_bus_number(list[0]) == 1);
+    CHECK(libusb_get_port_numbers(list[0], ports, sizeof(ports)) == 1 &&
+                                                          ports[0] == 4);
+    CHECK(libusb_open(list[0], &handle) == 0);
+    libusb_free_device_list(list, 1);
+    if(handle)
+        CHECK(libusb_claim_interface(handle, 0) == 0);
+    return handle;
+}
+
+static void test_sync(libusb_device_handle *handle)
+{
+    unsigned char buf[8] = { 0 }, data[8] = { 0 };
+    int n = -1;
+    CHECK(libusb_interrupt_transfer(handle, OUT_EP, buf, sizeof(buf), &n,
+                                    TIMEOUT) == 0 && n == sizeof(buf));
+    fake.mode = fake_hang;
+    CHECK(libusb_interrupt_transfer(handle, OUT_EP, buf, sizeof(buf), &n,
+                                    TIMEOUT) == LIBUSB_ERROR_TIMEOUT);
+    CHECK(n == 0 && fake.discards == 1 && fake.pending.cnt == 0);
+    fake.mode = fake_stall;
+    CHECK(libusb_interrupt_transfer(handle, OUT_EP, buf, sizeof(buf), &n,
+                                    TIMEOUT) == LIBUSB_ERROR_PIPE);
+    fake.mode = fake_nodev;
+    CHECK(libusb_interrupt_transfer(handle, OUT_EP, buf, sizeof(buf), &n,
+                                    TIMEOUT) == LIBUSB_ERROR_NO_DEVICE);
+    fake.mode = fake_ok;
+    CHECK(libusb_control_transfer(handle, 0xa1, 0x01, 0x0300, 0, data,
+                                  4, TIMEOUT) == 4);
+    CHECK(data[0] == 0xa5 && data[3] == 0xa5 && data[4] == 0);
+    CHECK(libusb_control_transfer(handle, 0x21, 0x09, 0x0300, 0, data,
+                                  sizeof(data), TIMEOUT) == sizeof(data));
+    CHECK(fake.done.cnt == 0);
+    fake_reset();
+}
+
+/* The event fd is readable once a synchronous transfer has reaped the
+ * URB of an asynchronous one */
+static int event_fd_ready(void)
+{
+    const struct libusb_pollfd **fds;
+    struct pollfd pfd;
+    int i, ready = 0;
+    fds = libusb_get_pollfds(NULL);
+    if(!fds)
+        return 0;
+    for(i = 0; fds[i]; i++) {
+        if(fds[i]->events != POLLIN)
+            continue;
+        pfd.fd = fds[i]->fd;
+        pfd.events = POLLIN;
+        ready = poll(&pfd, 1, 0) == 1;
+    }
+    libusb_free_pollfds(fds);
+    return ready;
+}
+
+static void test_async(libusb_device_handle *handle)
+{
+    static const unsigned char report[2] = { 0x01, 0x01 };
+    unsigned char buf[8] = { 0 }, out[8] = { 0 };
+    struct libusb_transfer *xfer;
+    int n;
+    xfer = libusb_alloc_transfer(0);
+    CHECK(xfer != NULL);
+    if(!xfer)
+        return;
+    CHECK(libusb_get_pollfds(NULL) != NULL); /* the event fd is made */
+    libusb_fill_interrupt_transfer(xfer, handle, IN_EP, buf, sizeof(buf),
+                                   log_callback, NULL, TIMEOUT);
+    CHECK(libusb_submit_transfer(xfer) == LIBUSB_ERROR_NOT_SUPPORTED);
+    xfer->timeout = 0;
+    CHECK(libusb_submit_transfer(xfer) == 0);
+    CHECK(libusb_submit_transfer(xfer) == LIBUSB_ERROR_BUSY);
+    handle_events();
+    CHECK(cb_log.calls == 0);
+    fake_report(report, sizeof(report));
+    handle_events();
+    CHECK(cb_log.calls == 1 && cb_log.status == LIBUSB_TRANSFER_COMPLETED);
+    CHECK(cb_log.actual_length == 2 && buf[1] == 0x01);
+
+    CHECK(libusb_submit_transfer(xfer) == 0);
+    fake_report(report, sizeof(report));
+    CHECK(libusb_interrupt_transfer(handle, OUT_EP, out, sizeof(out), &n,
+                                    TIMEOUT) == 0 && n == sizeof(out));
+    CHECK(cb_log.calls == 1 && event_fd_ready());
+    handle_events();
+    CHECK(cb_log.calls == 2 && cb_log.status == LIBUSB_TRANSFER_COMPLETED);
+    CHECK(!event_fd_ready());
+
+    CHECK(libusb_submit_transfer(xfer) == 0);
+    CHECK(libusb_cancel_transfer(xfer) == 0);
+    CHECK(libusb_cancel_transfer(xfer) == LIBUSB_ERROR_NOT_FOUND);
+    handle_events();
+    CHECK(cb_log.calls == 3 && cb_log.status == LIBUSB_TRANSFER_CANCELLED);
+    CHECK(libusb_cancel_transfer(xfer) == LIBUSB_ERROR_NOT_FOUND);
+
+    CHECK(libusb_submit_transfer(xfer) == 0);
+    fake.gone = 1;
+    handle_events();
+    CHECK(cb_log.calls == 4 && cb_log.status == LIBUSB_TRANSFER_NO_DEVICE);
+    fake_reset();
+
+    CHECK(libusb_submit_transfer(xfer) == 0);
+    libusb_release_interface(handle, 0);
+    libusb_close(handle); /* the transfer goes with the handle */
+    handle_events();
+    CHECK(cb_log.calls == 4);
+    libusb_free_transfer(xfer);
+}
+
+int main(void)
+{
+    libusb_device_handle *handle;
+    char root[sizeof(TMP_TEMPLATE)];
+    test_begin();
+    libusb_init(NULL);
+    if(fake_setup(root) == 0 && (handle = test_open())) {
+        test_sync(handle);
+        test_async(handle);
+    } else {
+        CHECK(!"the fake device is opened");
+    }
+    libusb_exit(NULL);
+    fake_teardown(root);
+    return test_end("usbfs");
+}